@@ -0,0 +1,96 @@
+// Packet and reply buffer placement: regular pages vs huge pages, and local
+// vs remote NUMA node when the machine has more than one.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <tb_memory.hpp>
+#include <tb_numa.hpp>
+
+namespace tb = tigerbeetle;
+
+namespace {
+constexpr std::size_t BUFFERS = 128; // 128 MiB of message buffers
+constexpr std::size_t ROUNDS = 4;
+constexpr std::size_t PROBES = 1 << 22;
+
+struct Result {
+  double copy_gbps;
+  double probe_ns;
+};
+
+Result run(std::pmr::memory_resource &upstream) {
+  std::pmr::unsynchronized_pool_resource pool(tb::message_pool_options(),
+                                              &upstream);
+  std::vector<tb::ReplyBuffer> buffers;
+  buffers.reserve(BUFFERS);
+  for (std::size_t i = 0; i < BUFFERS; ++i) {
+    buffers.emplace_back(tb::MAX_MESSAGE_SIZE, uint8_t{0}, &pool);
+  }
+  std::vector<uint8_t> source(tb::MAX_MESSAGE_SIZE, uint8_t{1});
+
+  // Streaming: reply-sized copies, as done by completions.
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t round = 0; round < ROUNDS; ++round) {
+    for (auto &buffer : buffers) {
+      std::memcpy(buffer.data(), source.data(), source.size());
+    }
+  }
+  auto seconds = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - start)
+                     .count();
+  const double bytes = double(ROUNDS) * BUFFERS * tb::MAX_MESSAGE_SIZE;
+
+  // Random probes across the working set, dominated by TLB misses.
+  std::mt19937_64 rng(42);
+  std::uniform_int_distribution<std::size_t> pick_buffer(0, BUFFERS - 1);
+  std::uniform_int_distribution<std::size_t> pick_offset(
+      0, tb::MAX_MESSAGE_SIZE - 1);
+  std::vector<std::pair<uint32_t, uint32_t>> probes(PROBES);
+  for (auto &probe : probes) {
+    probe = {static_cast<uint32_t>(pick_buffer(rng)),
+             static_cast<uint32_t>(pick_offset(rng))};
+  }
+  uint64_t sum = 0;
+  start = std::chrono::steady_clock::now();
+  for (const auto &[buffer, offset] : probes) {
+    sum += buffers[buffer][offset];
+  }
+  auto probe_seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+  if (sum == 0) {
+    std::printf("unexpected checksum\n");
+  }
+  return {bytes / seconds / 1e9, probe_seconds * 1e9 / PROBES};
+}
+
+void report(const char *name, const Result &result) {
+  std::printf("%-28s copy %7.2f GB/s   random probe %6.2f ns\n", name,
+              result.copy_gbps, result.probe_ns);
+}
+} // namespace
+
+int main() {
+  const int node = tb::current_numa_node();
+  tb::NodeAffinity pin(node);
+  std::printf("buffers: %zu x %zu bytes, node %d (%s)\n", BUFFERS,
+              tb::MAX_MESSAGE_SIZE, node, pin.pinned() ? "pinned" : "unpinned");
+
+  report("new/delete", run(*std::pmr::new_delete_resource()));
+
+  tb::HugePageResource huge({.node = node});
+  report("huge pages, local node", run(huge));
+  std::printf("  hugetlb mappings %zu, fallback (THP) mappings %zu\n",
+              huge.hugetlb_mappings(), huge.fallback_mappings());
+
+  for (int remote = 0; remote < 8; ++remote) {
+    if (remote != node && !tb::numa_node_cpus(remote).empty()) {
+      tb::HugePageResource far({.node = remote});
+      report("huge pages, remote node", run(far));
+      break;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,181 @@
+// Echo round trips per second: thread-per-core (one client, request pool and
+// rings per pinned core) against the same number of threads sharing a
+// single client. Requests are small so that per-request overhead dominates.
+// Both clocks start once the clients are up and the threads are running,
+// and stop at the last reply: start-up and teardown are not timed.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <latch>
+#include <tb_percore.hpp>
+#include <thread>
+#include <vector>
+
+namespace tb = tigerbeetle;
+
+namespace {
+constexpr uint64_t REQUESTS = 200000; // Per thread
+constexpr std::size_t WINDOW = 64;    // In flight per thread
+constexpr std::size_t IDS = 16;       // Per request
+
+double per_core(std::size_t cores) {
+  using Executor = tb::CoreExecutor<uint64_t>;
+  // Written by its own core only.
+  struct alignas(tb::CACHE_LINE_SIZE) Quota {
+    uint64_t left = 0;
+    uint64_t replies = 0;
+  };
+  std::vector<Quota> quotas(cores);
+  std::atomic<std::size_t> finished{0}; // Cores with every reply in
+  std::vector<tb::tb_uint128_t> ids(IDS);
+
+  // A request that is not sent never replies and the run would not end.
+  auto send = [&ids](Executor::Core &core) {
+    auto *request = core.acquire();
+    if (request == nullptr) {
+      std::fprintf(stderr, "Request pool exhausted\n");
+      std::exit(EXIT_FAILURE);
+    }
+    request->assign(tb::TB_OPERATION_LOOKUP_ACCOUNTS, ids);
+    if (!core.submit(*request)) {
+      std::fprintf(stderr, "Submit refused: %d\n", request->packet.status);
+      std::exit(EXIT_FAILURE);
+    }
+  };
+
+  tb::CoreOptions options;
+  const auto cpus = std::max(1u, std::thread::hardware_concurrency());
+  for (std::size_t i = 0; i < cores; ++i) {
+    options.cpus.push_back(static_cast<int>(i % cpus));
+  }
+  // A request goes back to the pool after its on_reply: one spare lets
+  // on_reply send the next one.
+  options.max_in_flight = WINDOW + 1;
+
+  Executor executor(
+      tb::echo_client, "3000",
+      [&](Executor::Core &core, uint64_t &count) {
+        quotas[core.index()].left = count - WINDOW;
+        for (std::size_t i = 0; i < WINDOW; ++i) {
+          send(core);
+        }
+      },
+      [&](Executor::Core &core, tb::CoreRequest &) {
+        auto &quota = quotas[core.index()];
+        if (++quota.replies == REQUESTS) {
+          finished.fetch_add(1, std::memory_order_release);
+          finished.notify_one();
+        }
+        if (quota.left > 0) {
+          --quota.left;
+          send(core);
+        }
+      },
+      options);
+  if (!executor.ok()) {
+    std::fprintf(stderr, "Failed to initialize tb_client\n");
+    std::exit(EXIT_FAILURE);
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  for (std::size_t core = 0; core < cores; ++core) {
+    executor.post(core, REQUESTS);
+  }
+  for (auto done = finished.load(std::memory_order_acquire); done < cores;
+       done = finished.load(std::memory_order_acquire)) {
+    finished.wait(done, std::memory_order_acquire);
+  }
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  executor.stop();
+  return double(REQUESTS) * cores / seconds;
+}
+
+// The same load from `threads` threads through one client.
+double shared(std::size_t threads) {
+  struct Pending : tb::Request {
+    std::atomic<bool> done{false};
+  };
+  tb::Client client(tb::echo_client, "3000");
+  if (client.initStatus() != tb::TB_INIT_SUCCESS) {
+    std::fprintf(stderr, "Failed to initialize tb_client\n");
+    std::exit(EXIT_FAILURE);
+  }
+  std::vector<tb::tb_uint128_t> ids(IDS);
+
+  std::latch running(static_cast<std::ptrdiff_t>(threads) + 1);
+  std::chrono::steady_clock::time_point start;
+  {
+    std::vector<std::jthread> workers;
+    for (std::size_t t = 0; t < threads; ++t) {
+      workers.emplace_back([&] {
+        running.arrive_and_wait();
+        std::vector<Pending> window(WINDOW);
+        auto send = [&](Pending &pending) {
+          pending.packet = tb::tb_packet_t{};
+          pending.packet.operation = tb::TB_OPERATION_LOOKUP_ACCOUNTS;
+          pending.packet.data = ids.data();
+          pending.packet.data_size =
+              static_cast<uint32_t>(ids.size() * sizeof(ids[0]));
+          pending.on_reply = [](tb::Request *request, uint64_t,
+                                const uint8_t *, uint32_t) {
+            static_cast<Pending *>(request)->done.store(
+                true, std::memory_order_release);
+          };
+          client.submit(pending);
+        };
+        uint64_t sent = 0;
+        uint64_t received = 0;
+        for (auto &pending : window) {
+          send(pending);
+          ++sent;
+        }
+        while (received < REQUESTS) {
+          const auto before = received;
+          for (auto &pending : window) {
+            if (!pending.done.load(std::memory_order_acquire)) {
+              continue;
+            }
+            pending.done.store(false, std::memory_order_relaxed);
+            ++received;
+            if (sent < REQUESTS) {
+              send(pending);
+              ++sent;
+            }
+          }
+          if (received == before) {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+    running.arrive_and_wait();
+    start = std::chrono::steady_clock::now();
+  }
+  const double seconds = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  return double(REQUESTS) * threads / seconds;
+}
+} // namespace
+
+int main() {
+  const auto cpus = std::max(1u, std::thread::hardware_concurrency());
+  std::printf("%-8s %16s %16s %10s\n", "threads", "per-core req/s",
+              "shared req/s", "scaling");
+  double one = 0;
+  for (std::size_t threads = 1; threads <= std::max(cpus / 2, 1u);
+       threads *= 2) {
+    const double cores = per_core(threads);
+    const double one_client = shared(threads);
+    if (threads == 1) {
+      one = cores;
+    }
+    std::printf("%-8zu %16.0f %16.0f %9.2fx\n", threads, cores, one_client,
+                cores / one);
+  }
+  return 0;
+}
@@ -0,0 +1,407 @@
+// Wrapper overhead on the hot paths, checked against a stored baseline:
+//
+//   regressionBench                          print the measurements
+//   regressionBench baseline.json            fail on regressions
+//   regressionBench baseline.json --update   rewrite the baseline
+//
+// Arguments may come in any order; --runs=N sets how many passes over the
+// suite --update takes (default 15; a check takes 3).
+//
+// Each benchmark is gated on its cost relative to `reference`, a plain loop
+// over the same events that uses no wrapper code, so that the baseline
+// carries over between machines of the same kind and survives a busy host
+// better than absolute ns/op. A benchmark regresses when its relative cost
+// is above baseline * (1 + tolerance). --update takes the median over its
+// runs as the baseline and sets each tolerance from the spread it saw;
+// TB_PERF_TOLERANCE overrides every tolerance.
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tb_batch.hpp>
+#include <tb_client.hpp>
+#include <tb_format.hpp>
+#include <tb_netting.hpp>
+#include <vector>
+
+namespace tb = tigerbeetle;
+
+namespace {
+constexpr int SAMPLES = 9;
+constexpr double DEFAULT_TOLERANCE = 0.5;
+constexpr double MIN_TOLERANCE = 0.1;
+constexpr int UPDATE_RUNS = 15;
+constexpr int CHECK_RUNS = 3;
+
+template <typename F> double time_ns(F &&run) {
+  const auto start = std::chrono::steady_clock::now();
+  run();
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+std::vector<tb::tb_transfer_t> make_events(std::size_t count) {
+  std::vector<tb::tb_transfer_t> events(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    events[i].id = i + 1;
+    events[i].debit_account_id = 1;
+    events[i].credit_account_id = 2;
+    events[i].amount = 10;
+    events[i].ledger = 1;
+    events[i].code = 1;
+  }
+  return events;
+}
+
+// What the benchmarks are measured against: copying the events and folding
+// their ids and amounts, per event.
+double reference(const std::vector<tb::tb_transfer_t> &events) {
+  std::vector<tb::tb_transfer_t> copy;
+  tb::tb_uint128_t sum = 0;
+  const double ns = time_ns([&] {
+    copy = events;
+    for (const auto &event : copy) {
+      sum = sum * 31 + (event.id ^ event.amount);
+    }
+  });
+  if (sum == 0) {
+    std::printf("unexpected zero checksum\n");
+  }
+  return ns / double(events.size());
+}
+
+// Chains of one to four events, cycling.
+template <typename F>
+void for_each_chain(const std::vector<tb::tb_transfer_t> &events, F &&chain) {
+  for (std::size_t i = 0, length = 1; i < events.size();
+       i += length, length = length % 4 + 1) {
+    chain(std::span(events).subspan(i, std::min(length, events.size() - i)));
+  }
+}
+
+// Submit to reply callback through Client::submit, a flight at a time.
+double completion_dispatch(tb::Client &client) {
+  constexpr std::size_t FLIGHT = 256;
+  constexpr int ROUNDS = 8;
+  static std::atomic<std::size_t> replies{0};
+
+  std::vector<tb::tb_uint128_t> ids(FLIGHT, 1);
+  std::vector<tb::Request> requests(FLIGHT);
+  for (std::size_t i = 0; i < FLIGHT; ++i) {
+    requests[i].on_reply = [](tb::Request *, uint64_t, const uint8_t *,
+                              uint32_t) {
+      replies.fetch_add(1, std::memory_order_release);
+      replies.notify_one();
+    };
+  }
+  const double ns = time_ns([&] {
+    for (int round = 0; round < ROUNDS; ++round) {
+      replies = 0;
+      for (std::size_t i = 0; i < FLIGHT; ++i) {
+        auto &packet = requests[i].packet;
+        packet = {};
+        packet.operation = tb::TB_OPERATION_LOOKUP_ACCOUNTS;
+        packet.data = &ids[i];
+        packet.data_size = sizeof(tb::tb_uint128_t);
+        client.submit(requests[i]);
+      }
+      for (auto seen = replies.load(std::memory_order_acquire); seen < FLIGHT;
+           seen = replies.load(std::memory_order_acquire)) {
+        replies.wait(seen);
+      }
+    }
+  });
+  return ns / (FLIGHT * ROUNDS);
+}
+
+// ChainPacker::add and pack, per event.
+double batch_build(const std::vector<tb::tb_transfer_t> &events) {
+  tb::ChainPacker<tb::tb_transfer_t> packer;
+  std::size_t packets = 0;
+  const double ns = time_ns([&] {
+    for_each_chain(events, [&](auto chain) { packer.add(chain); });
+    packets = packer.pack().size();
+  });
+  if (packets == 0) {
+    std::printf("unexpected empty pack\n");
+  }
+  return ns / double(events.size());
+}
+
+// ChainPacker::distribute over replies with one failed event in eight, per
+// event.
+double result_decode(const std::vector<tb::tb_transfer_t> &events) {
+  using Packer = tb::ChainPacker<tb::tb_transfer_t>;
+  Packer packer;
+  for_each_chain(events, [&](auto chain) { packer.add(chain); });
+  const auto chains = packer.size();
+  const auto packets = packer.pack();
+
+  std::vector<std::vector<tb::tb_create_transfers_result_t>> replies;
+  for (const auto &packet : packets) {
+    auto &reply = replies.emplace_back();
+    for (uint32_t i = 0; i < packet.events.size(); i += 8) {
+      reply.push_back(
+          {i, tb::TB_CREATE_TRANSFER_DEBIT_ACCOUNT_NOT_FOUND});
+    }
+  }
+  std::vector<tb::ChainResult<tb::tb_transfer_t>> results(chains);
+  const double ns = time_ns([&] {
+    for (std::size_t i = 0; i < packets.size(); ++i) {
+      Packer::distribute(packets[i], tb::TB_PACKET_OK, replies[i], results);
+    }
+  });
+  return ns / double(events.size());
+}
+
+// append_csv of create_transfers events, per event.
+double csv_encode(const std::vector<tb::tb_transfer_t> &events) {
+  std::string csv;
+  const double ns = time_ns([&] { tb::append_csv(csv, events); });
+  if (csv.empty()) {
+    std::printf("unexpected empty csv\n");
+  }
+  return ns / double(events.size());
+}
+
+// LegNetter::add and take, per leg: back-and-forth legs between 4096
+// account pairs.
+double leg_netting(const std::vector<tb::tb_transfer_t> &events) {
+  auto legs = events;
+  for (std::size_t i = 0; i < legs.size(); ++i) {
+    const auto pair = 2 * (i % 4096) + 1;
+    legs[i].debit_account_id = i % 3 == 0 ? pair + 1 : pair;
+    legs[i].credit_account_id = i % 3 == 0 ? pair : pair + 1;
+  }
+  tb::LegNetter netter;
+  tb::NettingPlan plan;
+  const double ns = time_ns([&] {
+    netter.add(legs);
+    netter.take(plan);
+  });
+  if (plan.transfers.empty()) {
+    std::printf("unexpected empty netting plan\n");
+  }
+  return ns / double(legs.size());
+}
+
+struct Benchmark {
+  const char *name;
+  double ns_per_op = 0;
+  double relative = 0; // ns_per_op / reference ns_per_op
+  double tolerance = DEFAULT_TOLERANCE;
+  std::optional<double> baseline = std::nullopt; // Relative cost
+};
+
+double median(std::vector<double> values) {
+  std::nth_element(values.begin(), values.begin() + values.size() / 2,
+                   values.end());
+  return values[values.size() / 2];
+}
+
+template <typename F> double median_of(F &&sample) {
+  std::vector<double> samples;
+  sample(); // Warm-up
+  for (int i = 0; i < SAMPLES; ++i) {
+    samples.push_back(sample());
+  }
+  return median(std::move(samples));
+}
+
+// One pass over the suite. The first pass of a process also pays for page
+// faults and allocator growth, so callers discard it.
+std::vector<Benchmark> measure(tb::Client &client,
+                               const std::vector<tb::tb_transfer_t> &events) {
+  std::vector<Benchmark> suite = {
+      {"completion_dispatch"}, {"batch_build"}, {"result_decode"},
+      {"csv_encode"}, {"leg_netting"}};
+  suite[0].ns_per_op = median_of([&] { return completion_dispatch(client); });
+  suite[1].ns_per_op = median_of([&] { return batch_build(events); });
+  suite[2].ns_per_op = median_of([&] { return result_decode(events); });
+  suite[3].ns_per_op = median_of([&] { return csv_encode(events); });
+  suite[4].ns_per_op = median_of([&] { return leg_netting(events); });
+  const double unit = median_of([&] { return reference(events); });
+  for (auto &benchmark : suite) {
+    benchmark.relative = benchmark.ns_per_op / unit;
+  }
+  return suite;
+}
+
+std::optional<std::string> read_file(const char *path) {
+  std::FILE *file = std::fopen(path, "rb");
+  if (file == nullptr) {
+    return std::nullopt;
+  }
+  std::string text;
+  char buffer[4096];
+  for (std::size_t n; (n = std::fread(buffer, 1, sizeof(buffer), file)) > 0;) {
+    text.append(buffer, n);
+  }
+  std::fclose(file);
+  return text;
+}
+
+// Reads `"key": <number>` from text[from, to), the flat layout written by
+// write_baseline.
+std::optional<double> find_number(const std::string &text, const char *key,
+                                  std::size_t from, std::size_t to) {
+  const auto quoted = std::string("\"") + key + "\"";
+  const auto at = text.find(quoted, from);
+  if (at == std::string::npos || at >= to) {
+    return std::nullopt;
+  }
+  const auto colon = text.find(':', at + quoted.size());
+  if (colon == std::string::npos || colon >= to) {
+    return std::nullopt;
+  }
+  char *end = nullptr;
+  const double value = std::strtod(text.c_str() + colon + 1, &end);
+  if (end == text.c_str() + colon + 1) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+void load_baseline(const std::string &text, std::vector<Benchmark> &suite) {
+  const auto listed = text.find("\"benchmarks\"");
+  const auto shared =
+      find_number(text, "tolerance", 0, listed).value_or(DEFAULT_TOLERANCE);
+  for (auto &benchmark : suite) {
+    benchmark.tolerance = shared;
+    const auto at =
+        text.find(std::string("\"") + benchmark.name + "\"", listed);
+    if (listed == std::string::npos || at == std::string::npos) {
+      continue;
+    }
+    const auto close = text.find('}', at);
+    benchmark.baseline = find_number(text, "relative", at, close);
+    benchmark.tolerance =
+        find_number(text, "tolerance", at, close).value_or(shared);
+  }
+}
+
+bool write_baseline(const char *path, const std::vector<Benchmark> &suite) {
+  std::FILE *file = std::fopen(path, "w");
+  if (file == nullptr) {
+    return false;
+  }
+  std::fprintf(file, "{\n  \"tolerance\": %.2f,\n  \"benchmarks\": {\n",
+               DEFAULT_TOLERANCE);
+  for (std::size_t i = 0; i < suite.size(); ++i) {
+    std::fprintf(file,
+                 "    \"%s\": {\"relative\": %.3f, \"tolerance\": %.2f}%s\n",
+                 suite[i].name, suite[i].relative, suite[i].tolerance,
+                 i + 1 < suite.size() ? "," : "");
+  }
+  std::fprintf(file, "  }\n}\n");
+  return std::fclose(file) == 0;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  const char *baseline_path = nullptr;
+  bool update = false;
+  int runs = UPDATE_RUNS;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--update") == 0) {
+      update = true;
+    } else if (std::strncmp(argv[i], "--runs=", 7) == 0) {
+      runs = std::max(1, std::atoi(argv[i] + 7));
+    } else if (argv[i][0] != '-' && baseline_path == nullptr) {
+      baseline_path = argv[i];
+    } else {
+      std::printf("usage: %s [baseline.json] [--update] [--runs=N]\n",
+                  argv[0]);
+      return 2;
+    }
+  }
+  if (update && baseline_path == nullptr) {
+    std::printf("--update needs the baseline to write\n");
+    return 2;
+  }
+
+  tb::Client client(tb::echo_client, "3001");
+  if (client.initStatus() != tb::TB_INIT_SUCCESS) {
+    std::printf("echo client failed to start: %d\n", client.initStatus());
+    return 1;
+  }
+  const auto events = make_events(tb::ChainPacker<tb::tb_transfer_t>::
+                                      max_events * 4);
+
+  // Median of each benchmark over `runs` passes, after a warm-up pass.
+  // With --update that is the baseline, and the tolerance is twice the
+  // worst excess over it that a single pass showed.
+  measure(client, events);
+  std::vector<std::vector<Benchmark>> passes;
+  for (int run = 0; run < (update ? runs : CHECK_RUNS); ++run) {
+    passes.push_back(measure(client, events));
+  }
+  auto suite = passes.front();
+  for (std::size_t b = 0; b < suite.size(); ++b) {
+    std::vector<double> ns;
+    std::vector<double> relative;
+    for (const auto &pass : passes) {
+      ns.push_back(pass[b].ns_per_op);
+      relative.push_back(pass[b].relative);
+    }
+    const double worst = *std::max_element(relative.begin(), relative.end());
+    suite[b].ns_per_op = median(ns);
+    suite[b].relative = median(relative);
+    suite[b].tolerance =
+        std::max(MIN_TOLERANCE, 2 * (worst / suite[b].relative - 1));
+  }
+
+  if (update) {
+    for (const auto &benchmark : suite) {
+      std::printf("%-20s %10.1f ns/op   relative %8.3f   tolerance %.2f\n",
+                  benchmark.name, benchmark.ns_per_op, benchmark.relative,
+                  benchmark.tolerance);
+    }
+    if (!write_baseline(baseline_path, suite)) {
+      std::printf("cannot write baseline %s\n", baseline_path);
+      return 1;
+    }
+    std::printf("baseline written to %s from %d runs\n", baseline_path,
+                runs);
+    return 0;
+  }
+
+  if (baseline_path != nullptr) {
+    auto text = read_file(baseline_path);
+    if (!text) {
+      std::printf("cannot read baseline %s\n", baseline_path);
+      return 1;
+    }
+    load_baseline(*text, suite);
+  }
+  if (const char *forced = std::getenv("TB_PERF_TOLERANCE")) {
+    for (auto &benchmark : suite) {
+      benchmark.tolerance = std::strtod(forced, nullptr);
+    }
+  }
+
+  int regressions = 0;
+  for (const auto &benchmark : suite) {
+    std::printf("%-20s %10.1f ns/op   relative %8.3f", benchmark.name,
+                benchmark.ns_per_op, benchmark.relative);
+    if (benchmark.baseline && *benchmark.baseline > 0) {
+      const double ratio = benchmark.relative / *benchmark.baseline;
+      const bool regressed = ratio > 1 + benchmark.tolerance;
+      regressions += regressed;
+      std::printf("   baseline %8.3f   %+6.1f%%   %s", *benchmark.baseline,
+                  (ratio - 1) * 100,
+                  regressed ? "REGRESSED"
+                  : ratio < 1 / (1 + benchmark.tolerance)
+                      ? "improved, consider --update"
+                      : "ok");
+    }
+    std::printf("\n");
+  }
+  return regressions == 0 ? 0 : 1;
+}
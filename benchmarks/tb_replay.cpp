@@ -0,0 +1,244 @@
+// Replays a capture file written by tigerbeetle::CaptureWriter against a
+// cluster, and compares the latencies with the ones captured:
+//
+//   tb_replay capture.tbcap                 original timing
+//   tb_replay capture.tbcap --speed=4       4x faster
+//   tb_replay capture.tbcap --speed=0       as fast as possible
+//   tb_replay capture.tbcap --address=3001  cluster (default: TB_ADDRESS)
+//   tb_replay capture.tbcap --echo          echo client, no cluster
+//
+// Timed replays send each packet at its captured offset, so the original
+// concurrency comes back on its own. At full speed a packet waits until
+// fewer packets are in flight than when it was captured.
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <tb_capture.hpp>
+#include <thread>
+#include <vector>
+
+namespace tb = tigerbeetle;
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::string path;
+  std::string address = "3001";
+  double speed = 1;
+  bool echo = false;
+};
+
+struct Replayed : tb::Request {
+  const tb::CaptureEntry *entry = nullptr;
+  Clock::time_point sent{};
+  uint64_t latency_ns = 0;
+  uint8_t status = 0;
+  bool reply_matches = false;
+};
+
+// Completion side shared by every request.
+struct Tracker {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::size_t in_flight = 0;
+};
+
+Tracker tracker;
+
+void on_reply(tb::Request *request, uint64_t, const uint8_t *data,
+              uint32_t size) {
+  auto *replayed = static_cast<Replayed *>(request);
+  replayed->latency_ns = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                           replayed->sent)
+          .count());
+  replayed->status = replayed->packet.status;
+  const auto &expected = replayed->entry->reply;
+  replayed->reply_matches =
+      size == expected.size() &&
+      (size == 0 || std::memcmp(data, expected.data(), size) == 0);
+  std::lock_guard lock(tracker.mutex);
+  --tracker.in_flight;
+  tracker.cv.notify_all();
+}
+
+bool parse(int argc, char **argv, Options &options) {
+  if (const char *env = std::getenv("TB_ADDRESS"); env != nullptr) {
+    options.address = env;
+  }
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg.starts_with("--speed=")) {
+      options.speed = std::atof(argv[i] + 8);
+    } else if (arg.starts_with("--address=")) {
+      options.address = arg.substr(10);
+    } else if (arg == "--echo") {
+      options.echo = true;
+    } else if (!arg.starts_with("--") && options.path.empty()) {
+      options.path = arg;
+    } else {
+      return false;
+    }
+  }
+  return !options.path.empty() && options.speed >= 0;
+}
+
+double percentile(const std::vector<uint64_t> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  const auto rank = static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5);
+  return static_cast<double>(sorted[rank]) / 1e3;
+}
+
+double mean(const std::vector<uint64_t> &values) {
+  double sum = 0;
+  for (auto value : values) {
+    sum += static_cast<double>(value);
+  }
+  return values.empty() ? 0 : sum / static_cast<double>(values.size()) / 1e3;
+}
+
+void report(std::vector<uint64_t> original, std::vector<uint64_t> replay) {
+  std::sort(original.begin(), original.end());
+  std::sort(replay.begin(), replay.end());
+  std::printf("%-8s %14s %14s %10s\n", "latency", "captured (us)",
+              "replayed (us)", "delta");
+  const auto row = [](const char *name, double before, double after) {
+    const double delta = before > 0 ? (after - before) / before * 100 : 0;
+    std::printf("%-8s %14.1f %14.1f %+9.1f%%\n", name, before, after, delta);
+  };
+  const struct {
+    const char *name;
+    double p;
+  } points[] = {{"p50", 0.5},   {"p90", 0.9},    {"p99", 0.99},
+                {"p99.9", 0.999}, {"max", 1.0}};
+  for (const auto &point : points) {
+    row(point.name, percentile(original, point.p),
+        percentile(replay, point.p));
+  }
+  row("mean", mean(original), mean(replay));
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parse(argc, argv, options)) {
+    std::fprintf(stderr,
+                 "usage: %s <capture> [--speed=X] [--address=A] [--echo]\n",
+                 argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<tb::CaptureEntry> entries;
+  try {
+    tb::CaptureReader reader(options.path);
+    for (tb::CaptureEntry entry; reader.next(entry);) {
+      entries.push_back(std::move(entry));
+    }
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return EXIT_FAILURE;
+  }
+  // Captured in completion order, replayed in submission order.
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const auto &a, const auto &b) {
+                     return a.record.submit_ns < b.record.submit_ns;
+                   });
+  if (entries.empty()) {
+    std::fprintf(stderr, "%s: no packets captured\n", options.path.c_str());
+    return EXIT_FAILURE;
+  }
+
+  auto client = options.echo
+                    ? std::make_unique<tb::Client>(tb::echo_client,
+                                                   options.address)
+                    : std::make_unique<tb::Client>(options.address);
+  if (client->clientStatus() != tb::TB_CLIENT_STATUS::TB_CLIENT_OK) {
+    std::fprintf(stderr, "Failed to initialize tb_client\n");
+    return EXIT_FAILURE;
+  }
+
+  std::vector<Replayed> requests(entries.size());
+  const auto first_ns = entries.front().record.submit_ns;
+  const auto start = Clock::now();
+  std::size_t refused = 0;
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    auto &entry = entries[i];
+    if (options.speed > 0) {
+      const auto offset = static_cast<double>(entry.record.submit_ns -
+                                              first_ns) /
+                          options.speed;
+      std::this_thread::sleep_until(
+          start + std::chrono::nanoseconds(static_cast<int64_t>(offset)));
+    }
+    {
+      std::unique_lock lock(tracker.mutex);
+      if (options.speed == 0) {
+        tracker.cv.wait(lock, [&] {
+          return tracker.in_flight < std::max<uint32_t>(
+                                         entry.record.in_flight, 1);
+        });
+      }
+      ++tracker.in_flight;
+    }
+    auto &request = requests[i];
+    request.entry = &entry;
+    request.on_reply = on_reply;
+    request.packet.operation = entry.record.operation;
+    request.packet.data = entry.payload.data();
+    request.packet.data_size = entry.record.payload_size;
+    request.sent = Clock::now();
+    if (client->submit(request) != tb::TB_CLIENT_STATUS::TB_CLIENT_OK) {
+      std::lock_guard lock(tracker.mutex);
+      --tracker.in_flight;
+      ++refused;
+      request.entry = nullptr;
+    }
+  }
+  {
+    std::unique_lock lock(tracker.mutex);
+    tracker.cv.wait(lock, [] { return tracker.in_flight == 0; });
+  }
+  const auto elapsed = Clock::now() - start;
+
+  std::vector<uint64_t> original;
+  std::vector<uint64_t> replay;
+  std::size_t status_changed = 0;
+  std::size_t reply_changed = 0;
+  for (const auto &request : requests) {
+    if (request.entry == nullptr) {
+      continue;
+    }
+    const auto &record = request.entry->record;
+    original.push_back(record.complete_ns - record.submit_ns);
+    replay.push_back(request.latency_ns);
+    status_changed += request.status != record.status;
+    reply_changed += !request.reply_matches;
+  }
+
+  char speed[32] = "max";
+  if (options.speed > 0) {
+    std::snprintf(speed, sizeof(speed), "%gx", options.speed);
+  }
+  const auto captured_s =
+      static_cast<double>(entries.back().record.submit_ns - first_ns) / 1e9;
+  std::printf("%zu packets, captured over %.3fs, replayed in %.3fs "
+              "(speed %s)\n\n",
+              entries.size(), captured_s,
+              std::chrono::duration<double>(elapsed).count(),
+              speed);
+  report(std::move(original), std::move(replay));
+  std::printf("\npacket status changed: %zu, reply changed: %zu, "
+              "refused: %zu\n",
+              status_changed, reply_changed, refused);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+# Boost Software License - Version 1.0 - August 17th, 2003
+
+# Permission is hereby granted, free of charge, to any person or organization
+# obtaining a copy of the software and accompanying documentation covered by
+# this license (the "Software") to use, reproduce, display, distribute,
+# execute, and transmit the Software, and to prepare derivative works of the
+# Software, and to permit third-parties to whom the Software is furnished to
+# do so, all subject to the following:
+
+# The copyright notices in the Software and this entire statement, including
+# the above license grant, this restriction and the following disclaimer,
+# must be included in all copies of the Software, in whole or in part, and
+# all derivative works of the Software, unless such copies or derivative
+# works are solely in the form of machine-executable object code generated by
+# a source language processor.
+
+# Writes tb_client_names.hpp, the names tb_format.hpp prints for result,
+# status and operation codes, from the enums of the tb_client.h in use, so
+# that they always match its version. Run by FindTigerBeetle.cmake, or by
+# hand for a tb_client.h obtained some other way:
+#
+#   cmake -DTB_CLIENT_H=<tb_client.h> -DOUTPUT=<dir>/tb_client_names.hpp
+#         -P cmake/EnumNames.cmake
+
+function(tb_generate_enum_names header output)
+    file(READ ${header} text)
+    # enum type, prefix of its values, name of the table
+    set(enums
+        "TB_CREATE_ACCOUNT_RESULT TB_CREATE_ACCOUNT_ create_account_result"
+        "TB_CREATE_TRANSFER_RESULT TB_CREATE_TRANSFER_ create_transfer_result"
+        "TB_PACKET_STATUS TB_PACKET_ packet_status"
+        "TB_OPERATION TB_OPERATION_ operation"
+    )
+    set(tables "")
+    foreach(entry ${enums})
+        separate_arguments(entry)
+        list(GET entry 0 type)
+        list(GET entry 1 prefix)
+        list(GET entry 2 table)
+        string(REGEX MATCH "typedef enum ${type} {[^}]*}" block "${text}")
+        if(block STREQUAL "")
+            message(WARNING "${header} has no ${type}: its values print as numbers")
+            continue()
+        endif()
+        string(REGEX MATCHALL "${prefix}[A-Z0-9_]+[ \t]*=" values "${block}")
+        string(APPEND tables "inline constexpr EnumName ${table}_names[] = {\n")
+        foreach(value ${values})
+            string(REGEX REPLACE "[ \t]*=$" "" value "${value}")
+            string(REPLACE "${prefix}" "" name "${value}")
+            string(TOLOWER "${name}" name)
+            string(APPEND tables "    {${value}, \"${name}\"},\n")
+        endforeach()
+        string(APPEND tables "};\n"
+            "template <>\n"
+            "inline constexpr std::span<const EnumName> enum_names<${type}> =\n"
+            "    ${table}_names;\n\n")
+    endforeach()
+    file(WRITE ${output}.tmp
+        "// Generated from tb_client.h by cmake/EnumNames.cmake, do not edit.\n"
+        "// Included by tb_format.hpp.\n"
+        "#ifndef TB_CLIENT_NAMES_HPP\n"
+        "#define TB_CLIENT_NAMES_HPP\n\n"
+        "namespace tigerbeetle {\n\n"
+        "${tables}"
+        "} // namespace tigerbeetle\n"
+        "#endif // TB_CLIENT_NAMES_HPP\n")
+    # Unchanged names keep their timestamp, so nothing rebuilds.
+    configure_file(${output}.tmp ${output} COPYONLY)
+    file(REMOVE ${output}.tmp)
+endfunction()
+
+if(CMAKE_SCRIPT_MODE_FILE)
+    tb_generate_enum_names(${TB_CLIENT_H} ${OUTPUT})
+endif()
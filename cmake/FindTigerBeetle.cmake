@@ -149,6 +149,10 @@ file(COPY ${TIGERBEETLE_LIBRARY_DIR}/${CMAKE_TIGERBEETLE_LIBS_INIT}${CMAKE_TIGER
     DESTINATION ${CMAKE_CURRENT_BINARY_DIR})
 file(COPY ${TIGERBEETLE_INCLUDE_DIR}/tb_client.h
     DESTINATION ${CMAKE_CURRENT_SOURCE_DIR}/include)
+# Names of its result, status and operation codes, for tb_format.hpp
+include(${CMAKE_CURRENT_LIST_DIR}/EnumNames.cmake)
+tb_generate_enum_names(${TIGERBEETLE_INCLUDE_DIR}/tb_client.h
+    ${CMAKE_CURRENT_SOURCE_DIR}/include/tb_client_names.hpp)
 
 # copy tigerbeetle executable
 file(COPY ${TIGERBEETLE_ROOT_DIR}/tigerbeetle${CMAKE_EXECUTABLE_SUFFIX}
@@ -176,6 +180,10 @@ add_custom_target(testing
     DEPENDS ${APP_TESTS}
     WORKING_DIRECTORY ${TIGERBEETLE_ROOT_DIR}
 )
+add_custom_target(benchmarking
+    DEPENDS ${APP_BENCHMARKS} ${APP_TOOLS}
+    WORKING_DIRECTORY ${TIGERBEETLE_ROOT_DIR}
+)
 
 if(NOT TB_ADDRESS)
     set(TB_ADDRESS 3001)
@@ -209,6 +217,16 @@ if(BUILD_TESTS)
     endforeach()
 endif()
 
+if(BUILD_BENCHMARKS)
+    foreach(app ${APP_BENCHMARKS})
+        add_custom_command(TARGET benchmarking POST_BUILD
+            COMMAND ${CMAKE_BINARY_DIR}/${app}
+            WORKING_DIRECTORY ${TIGERBEETLE_ROOT_DIR}
+            COMMENT "Running ${app}"
+        )
+    endforeach()
+endif()
+
 # Clean the zig-cache directory
 execute_process(
     COMMAND ${CMAKE_COMMAND} -E remove_directory ${TIGERBEETLE_ROOT_DIR}/.zig-cache
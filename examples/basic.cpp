@@ -29,6 +29,21 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char **argv) {
     return EXIT_FAILURE;
   }
 
+  // Connect now rather than on the first request.
+  if (!client.warm_up(std::chrono::steady_clock::now() +
+                      std::chrono::seconds(30))) {
+    fmt::println("No reply from the cluster");
+    return EXIT_FAILURE;
+  }
+  const auto startup = client.startup();
+  fmt::print("Ready: init {}us, first reply after {}ms\n",
+             std::chrono::duration_cast<std::chrono::microseconds>(
+                 startup.init)
+                 .count(),
+             std::chrono::duration_cast<std::chrono::milliseconds>(
+                 startup.first_reply)
+                 .count());
+
   tigerbeetle::CompletionContext ctx{};
   tigerbeetle::tb_packet_t packet{};
 
@@ -206,7 +221,7 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char **argv) {
     fmt::print("============================================\n");
 
     std::ranges::for_each(results, [](const auto &result) {
-      fmt::print("id={}\n", static_cast<std::size_t>(result.id));
+      fmt::print("id={}\n", result.id);
       fmt::print("debits_posted={}\n", result.debits_posted);
       fmt::print("credits_posted={}\n", result.credits_posted);
     });
@@ -0,0 +1,49 @@
+#include <chrono>
+#include <cstdlib>
+#include <fmt/format.h>
+
+import tigerbeetle;
+
+namespace tb = tigerbeetle;
+
+// Same client as the other samples, through `import tigerbeetle;` instead
+// of #include <tb_client.hpp>. Built with -DTB_BUILD_MODULE=ON, which is
+// experimental.
+int main() {
+  fmt::println("TigerBeetle C++ - Module [Sample]\n");
+
+  const char *address = std::getenv("TB_ADDRESS");
+  tb::Client client(address != nullptr ? address : "3001");
+  if (client.initStatus() != tb::TB_INIT_SUCCESS ||
+      !client.warm_up(std::chrono::steady_clock::now() +
+                      std::chrono::seconds(30))) {
+    fmt::println(stderr, "Failed to connect");
+    return EXIT_FAILURE;
+  }
+
+  auto accounts = tb::make_account<2>();
+  for (std::size_t i = 0; i < accounts.size(); ++i) {
+    accounts[i].id = 1000 + i;
+    accounts[i].ledger = 1;
+    accounts[i].code = 1;
+  }
+  tb::CompletionContext ctx{};
+  tb::tb_packet_t packet{};
+  packet.operation = tb::TB_OPERATION_CREATE_ACCOUNTS;
+  packet.data = accounts.data();
+  packet.data_size = sizeof(tb::tb_account_t) * accounts.size();
+  packet.user_data = &ctx;
+  client.send_request(packet, &ctx);
+  if (packet.status != tb::TB_PACKET_OK) {
+    fmt::println(stderr, "create_accounts failed (packet status {})",
+                 packet.status);
+    return EXIT_FAILURE;
+  }
+
+  tb::CreateResults results;
+  results.decode(tb::TB_OPERATION_CREATE_ACCOUNTS, accounts.size(),
+                 ctx.reply.data(), static_cast<uint32_t>(ctx.size));
+  fmt::println("{} of {} accounts created", results.succeeded_count(),
+               results.size());
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+#include <cstdlib>
+#include <fmt/format.h>
+#include <tb_pipeline.hpp>
+
+namespace tb = tigerbeetle;
+
+int main() {
+  auto address = [&]() -> std::string {
+    const char *env_address = std::getenv("TB_ADDRESS");
+    if (env_address == nullptr) {
+      return "3001";
+    }
+    std::string_view env_address_view(env_address);
+    return std::string(env_address_view);
+  }();
+
+  try {
+
+    fmt::println("TigerBeetle C++ - Two Phase Flow [Sample]\n");
+
+    fmt::println("Connecting...");
+
+    tb::Client client(address);
+
+    if (client.initStatus() != tb::TB_INIT_SUCCESS) {
+      fmt::println(stderr, "Failed to initialize tb_client");
+      return EXIT_FAILURE;
+    }
+
+    // The whole two-phase flow is described up front and each step is
+    // submitted as soon as the previous one completes.
+    tb::Flow flow;
+
+    tb::account<2> accounts = tb::make_account<2>();
+    accounts.at(0).id = 1;
+    accounts.at(0).code = 1;
+    accounts.at(0).ledger = 1;
+    accounts.at(1).id = 2;
+    accounts.at(1).code = 1;
+    accounts.at(1).ledger = 1;
+    auto create_accounts =
+        flow.add(tb::TB_OPERATION_CREATE_ACCOUNTS, accounts);
+
+    // Start a pending transfer
+    tb::transfer<1> pending = tb::make_transfer<1>();
+    pending.at(0).id = 1;
+    pending.at(0).debit_account_id = 1;
+    pending.at(0).credit_account_id = 2;
+    pending.at(0).code = 1;
+    pending.at(0).ledger = 1;
+    pending.at(0).amount = 500;
+    pending.at(0).flags = tb::TB_TRANSFER_PENDING;
+    auto create_pending = flow.add(tb::TB_OPERATION_CREATE_TRANSFERS, pending,
+                                   {create_accounts});
+
+    // Post it once it exists
+    tb::transfer<1> post = tb::make_transfer<1>();
+    post.at(0).id = 2;
+    post.at(0).pending_id = 1;
+    post.at(0).debit_account_id = 1;
+    post.at(0).credit_account_id = 2;
+    post.at(0).code = 1;
+    post.at(0).ledger = 1;
+    post.at(0).amount = 500;
+    post.at(0).flags = tb::TB_TRANSFER_POST_PENDING_TRANSFER;
+    auto post_pending =
+        flow.add(tb::TB_OPERATION_CREATE_TRANSFERS, post, {create_pending});
+
+    tb::accountID<2> ids = {1, 2};
+    auto lookup =
+        flow.add(tb::TB_OPERATION_LOOKUP_ACCOUNTS, ids, {post_pending});
+
+    fmt::println("Running flow...");
+    flow.start(client);
+    flow.wait();
+
+    if (!flow.succeeded()) {
+      for (tb::Flow::StageId stage = 0; stage < flow.size(); ++stage) {
+        fmt::println(stderr, "stage={} status={} packet_status={}", stage,
+                     static_cast<int>(flow.status(stage)),
+                     flow.packet_status(stage));
+      }
+      return EXIT_FAILURE;
+    }
+
+    auto results = flow.reply<tb::tb_account_t>(lookup);
+    fmt::println("{} Account(s) found", results.size());
+    fmt::println("============================================");
+    for (const auto &account : results) {
+      fmt::println("id={} debits_posted={} credits_posted={}",
+                   account.id, account.debits_posted, account.credits_posted);
+    }
+
+    fmt::println("Two-phase flow completed successfully");
+  } catch (std::exception &e) {
+    fmt::println(stderr, "Exception occurred: {}", e.what());
+    return EXIT_FAILURE;
+  }
+}
@@ -0,0 +1,355 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+#ifndef TB_AGGREGATE_HPP
+#define TB_AGGREGATE_HPP
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "tb_client.hpp"
+
+namespace tigerbeetle {
+
+// Views reply bytes as the records of a lookup or query, without copying.
+// Reply buffers handed out by tb_client and CompletionContext are aligned
+// for any record type.
+template <typename T>
+std::span<const T> reply_records(const uint8_t *data, std::size_t size) {
+  return {reinterpret_cast<const T *>(data), size / sizeof(T)};
+}
+
+// Sum of 128-bit amounts, with the carries kept in `high` so that totals
+// over many accounts cannot wrap.
+struct WideSum {
+  tb_uint128_t low = 0;
+  uint64_t high = 0;
+
+  WideSum &operator+=(const WideSum &other) {
+    const auto sum = low + other.low;
+    high += other.high + (sum < low);
+    low = sum;
+    return *this;
+  }
+
+  // `value` << `shift`, for shifts that are multiples of 32 below 128.
+  static WideSum shifted(uint64_t value, unsigned shift) {
+    WideSum sum;
+    sum.low = static_cast<tb_uint128_t>(value) << shift;
+    sum.high = shift > 64 ? value >> (128 - shift) : 0;
+    return sum;
+  }
+
+  bool fits() const { return high == 0; } // Representable as tb_uint128_t
+  bool operator==(const WideSum &) const = default;
+};
+
+// Net of credits over debits: `amount` is owed to the account when `debit`
+// is false, by it otherwise.
+struct NetPosition {
+  WideSum amount;
+  bool debit = false;
+};
+
+inline NetPosition net_of(const WideSum &credits, const WideSum &debits) {
+  const bool debit = credits.high < debits.high ||
+                     (credits.high == debits.high && credits.low < debits.low);
+  const auto &big = debit ? debits : credits;
+  const auto &small = debit ? credits : debits;
+  NetPosition net{{big.low - small.low, big.high - small.high}, debit};
+  net.amount.high -= big.low < small.low;
+  return net;
+}
+
+struct BalanceTotals {
+  WideSum debits_pending;
+  WideSum debits_posted;
+  WideSum credits_pending;
+  WideSum credits_posted;
+  uint64_t accounts = 0;
+
+  BalanceTotals &operator+=(const BalanceTotals &other) {
+    debits_pending += other.debits_pending;
+    debits_posted += other.debits_posted;
+    credits_pending += other.credits_pending;
+    credits_posted += other.credits_posted;
+    accounts += other.accounts;
+    return *this;
+  }
+
+  NetPosition net_posted() const {
+    return net_of(credits_posted, debits_posted);
+  }
+  NetPosition net_pending() const {
+    return net_of(credits_pending, debits_pending);
+  }
+};
+
+struct LedgerTotals {
+  uint32_t ledger;
+  BalanceTotals totals;
+};
+
+struct CodeTotals {
+  uint32_t ledger;
+  uint16_t code;
+  BalanceTotals totals;
+};
+
+// Sums balances per ledger and per (ledger, code), straight from reply
+// buffers. Each 128-bit amount is split into 32-bit limbs that are summed in
+// 64-bit SIMD lanes (AVX2, SSE2 or NEON): a run of accounts of the same
+// group reduces with plain adds and no carry handling, and the lanes are
+// folded into WideSum totals once per run. Not thread safe;
+// add(accounts, threads) splits one span across threads and merges their
+// partial results.
+class BalanceAggregator {
+public:
+  // lookup_accounts / query_accounts results.
+  void add(std::span<const tb_account_t> accounts) {
+    while (!accounts.empty()) {
+      const auto key = key_of(accounts[0].ledger, accounts[0].code);
+      const auto count = accumulate(group(key), accounts, [key](const auto &a) {
+        return key_of(a.ledger, a.code) == key;
+      });
+      accounts = accounts.subspan(count);
+    }
+  }
+
+  // get_account_balances results, which do not carry the account's ledger
+  // and code.
+  void add(uint32_t ledger, uint16_t code,
+           std::span<const tb_account_balance_t> balances) {
+    while (!balances.empty()) {
+      const auto count = accumulate(group(key_of(ledger, code)), balances,
+                                    [](const auto &) { return true; });
+      balances = balances.subspan(count);
+    }
+  }
+
+  // Partitions `accounts` into `threads` slices (0: one per hardware
+  // thread) that are aggregated concurrently, then merged. Small inputs stay
+  // on the calling thread.
+  void add(std::span<const tb_account_t> accounts, unsigned threads) {
+    constexpr std::size_t min_slice = 16 * 1024;
+    if (threads == 0) {
+      threads = std::thread::hardware_concurrency();
+    }
+    threads = std::clamp<unsigned>(
+        threads, 1, static_cast<unsigned>(accounts.size() / min_slice) + 1);
+    if (threads == 1) {
+      add(accounts);
+      return;
+    }
+    std::vector<BalanceAggregator> partial(threads);
+    {
+      std::vector<std::jthread> workers;
+      const auto slice = (accounts.size() + threads - 1) / threads;
+      for (unsigned i = 0; i < threads; ++i) {
+        const auto begin = std::min(accounts.size(), i * slice);
+        const auto count = std::min(slice, accounts.size() - begin);
+        const auto part = accounts.subspan(begin, count);
+        workers.emplace_back([&partial, i, part] { partial[i].add(part); });
+      }
+    }
+    for (const auto &other : partial) {
+      merge(other);
+    }
+  }
+
+  void merge(const BalanceAggregator &other) {
+    for (const auto &g : other.groups) {
+      group(g.key).totals += g.totals;
+    }
+  }
+
+  // Sorted by ledger, then code.
+  std::vector<CodeTotals> by_code() const {
+    std::vector<CodeTotals> result;
+    result.reserve(groups.size());
+    for (const auto &g : groups) {
+      result.push_back({static_cast<uint32_t>(g.key >> 16),
+                        static_cast<uint16_t>(g.key), g.totals});
+    }
+    std::sort(result.begin(), result.end(), [](const auto &a, const auto &b) {
+      return a.ledger != b.ledger ? a.ledger < b.ledger : a.code < b.code;
+    });
+    return result;
+  }
+
+  // Sorted by ledger.
+  std::vector<LedgerTotals> by_ledger() const {
+    std::vector<LedgerTotals> result;
+    for (const auto &c : by_code()) {
+      if (result.empty() || result.back().ledger != c.ledger) {
+        result.push_back({c.ledger, {}});
+      }
+      result.back().totals += c.totals;
+    }
+    return result;
+  }
+
+  BalanceTotals total() const {
+    BalanceTotals sum;
+    for (const auto &g : groups) {
+      sum += g.totals;
+    }
+    return sum;
+  }
+
+  void clear() {
+    groups.clear();
+    index.clear();
+  }
+
+private:
+  struct Group {
+    uint64_t key;
+    BalanceTotals totals;
+  };
+
+  static uint64_t key_of(uint32_t ledger, uint16_t code) {
+    return static_cast<uint64_t>(ledger) << 16 | code;
+  }
+
+  Group &group(uint64_t key) {
+    if (!groups.empty() && groups[last].key == key) {
+      return groups[last];
+    }
+    auto [it, inserted] = index.try_emplace(key, groups.size());
+    if (inserted) {
+      groups.push_back({key, {}});
+    }
+    last = it->second;
+    return groups[last];
+  }
+
+  // The four amounts are contiguous in both record types: a record is read
+  // as 16 32-bit limbs that are widened and added into 16 64-bit sums, which
+  // cannot overflow within max_run records. Group detection happens in the
+  // same pass, so each record is loaded once. Returns the number of leading
+  // records of `records` that were summed.
+  template <typename T, typename Same>
+  static std::size_t accumulate(Group &g, std::span<const T> records,
+                                Same same) {
+    constexpr std::size_t max_run = std::size_t{1} << 31;
+    constexpr auto first = offsetof(T, debits_pending);
+    static_assert(offsetof(T, debits_posted) == first + 16 &&
+                  offsetof(T, credits_pending) == first + 32 &&
+                  offsetof(T, credits_posted) == first + 48);
+    const auto limit = std::min(records.size(), max_run);
+    std::size_t count = 0;
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__ARM_NEON)
+    uint64_t sums[16];
+#endif
+#if defined(__AVX2__)
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = acc0, acc2 = acc0,
+            acc3 = acc0;
+    for (; count < limit && same(records[count]); ++count) {
+      const auto *p = reinterpret_cast<const __m128i *>(
+          reinterpret_cast<const uint8_t *>(&records[count]) + first);
+      acc0 = _mm256_add_epi64(acc0, _mm256_cvtepu32_epi64(_mm_loadu_si128(p)));
+      acc1 = _mm256_add_epi64(acc1,
+                              _mm256_cvtepu32_epi64(_mm_loadu_si128(p + 1)));
+      acc2 = _mm256_add_epi64(acc2,
+                              _mm256_cvtepu32_epi64(_mm_loadu_si128(p + 2)));
+      acc3 = _mm256_add_epi64(acc3,
+                              _mm256_cvtepu32_epi64(_mm_loadu_si128(p + 3)));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(sums), acc0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(sums + 4), acc1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(sums + 8), acc2);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(sums + 12), acc3);
+#elif defined(__SSE2__)
+    const auto zero = _mm_setzero_si128();
+    __m128i acc[8] = {};
+    for (; count < limit && same(records[count]); ++count) {
+      const auto *p = reinterpret_cast<const __m128i *>(
+          reinterpret_cast<const uint8_t *>(&records[count]) + first);
+#pragma GCC unroll 4
+      for (int f = 0; f < 4; ++f) {
+        const auto limbs = _mm_loadu_si128(p + f);
+        acc[2 * f] = _mm_add_epi64(acc[2 * f], _mm_unpacklo_epi32(limbs, zero));
+        acc[2 * f + 1] =
+            _mm_add_epi64(acc[2 * f + 1], _mm_unpackhi_epi32(limbs, zero));
+      }
+    }
+    for (int i = 0; i < 8; ++i) {
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + 2 * i), acc[i]);
+    }
+#elif defined(__ARM_NEON)
+    uint64x2_t acc[8] = {};
+    for (; count < limit && same(records[count]); ++count) {
+      const auto *p = reinterpret_cast<const uint32_t *>(
+          reinterpret_cast<const uint8_t *>(&records[count]) + first);
+#pragma GCC unroll 4
+      for (int f = 0; f < 4; ++f) {
+        const auto limbs = vld1q_u32(p + 4 * f);
+        acc[2 * f] = vaddw_u32(acc[2 * f], vget_low_u32(limbs));
+        acc[2 * f + 1] = vaddw_u32(acc[2 * f + 1], vget_high_u32(limbs));
+      }
+    }
+    for (int i = 0; i < 8; ++i) {
+      vst1q_u64(sums + 2 * i, acc[i]);
+    }
+#else
+    // Without vector units, 128-bit adds with a carry check beat limbs.
+    BalanceTotals run;
+    for (; count < limit && same(records[count]); ++count) {
+      const auto &r = records[count];
+      run.debits_pending += WideSum{r.debits_pending, 0};
+      run.debits_posted += WideSum{r.debits_posted, 0};
+      run.credits_pending += WideSum{r.credits_pending, 0};
+      run.credits_posted += WideSum{r.credits_posted, 0};
+    }
+    g.totals += run;
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__ARM_NEON)
+    WideSum *totals[4] = {&g.totals.debits_pending, &g.totals.debits_posted,
+                          &g.totals.credits_pending, &g.totals.credits_posted};
+    for (unsigned i = 0; i < 16; ++i) {
+      const unsigned limb =
+          std::endian::native == std::endian::little ? i % 4 : 3 - i % 4;
+      *totals[i / 4] += WideSum::shifted(sums[i], 32 * limb);
+    }
+#endif
+    g.totals.accounts += count;
+    return count;
+  }
+
+  std::vector<Group> groups;
+  std::unordered_map<uint64_t, std::size_t> index;
+  std::size_t last = 0;
+};
+
+} // namespace tigerbeetle
+#endif // TB_AGGREGATE_HPP
@@ -0,0 +1,237 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+#ifndef TB_BATCH_HPP
+#define TB_BATCH_HPP
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <vector>
+
+#include "tb_client.hpp"
+
+namespace tigerbeetle {
+
+// Per-event-type details needed to build create_* batches.
+template <typename T> struct batch_traits;
+
+template <> struct batch_traits<tb_transfer_t> {
+  using result_type = tb_create_transfers_result_t;
+  static constexpr TB_OPERATION operation = TB_OPERATION_CREATE_TRANSFERS;
+  static constexpr uint16_t linked = TB_TRANSFER_LINKED;
+  static constexpr uint32_t linked_event_failed =
+      TB_CREATE_TRANSFER_LINKED_EVENT_FAILED;
+  static constexpr uint32_t exists = TB_CREATE_TRANSFER_EXISTS;
+};
+
+template <> struct batch_traits<tb_account_t> {
+  using result_type = tb_create_accounts_result_t;
+  static constexpr TB_OPERATION operation = TB_OPERATION_CREATE_ACCOUNTS;
+  static constexpr uint16_t linked = TB_ACCOUNT_LINKED;
+  static constexpr uint32_t linked_event_failed =
+      TB_CREATE_ACCOUNT_LINKED_EVENT_FAILED;
+  static constexpr uint32_t exists = TB_CREATE_ACCOUNT_EXISTS;
+};
+
+template <typename T>
+concept tb_event = requires { typename batch_traits<T>::result_type; };
+
+// Outcome of one submitted chain. `failures` holds every failed event with
+// its index relative to the start of the chain; it is empty on success.
+template <typename T> struct ChainResult {
+  using result_type = typename batch_traits<T>::result_type;
+
+  std::size_t chain = 0;
+  uint8_t packet_status = TB_PACKET_OK;
+  std::vector<result_type> failures;
+
+  bool ok() const { return packet_status == TB_PACKET_OK && failures.empty(); }
+
+  // The result that broke the chain, skipping the LINKED_EVENT_FAILED
+  // results of its siblings.
+  std::optional<uint32_t> cause() const {
+    for (const auto &f : failures) {
+      if (f.result != batch_traits<T>::linked_event_failed) {
+        return f.result;
+      }
+    }
+    return failures.empty() ? std::nullopt
+                            : std::optional<uint32_t>(failures[0].result);
+  }
+};
+
+// Packs linked chains into as few create_* requests as possible without ever
+// splitting a chain across two of them. The linked flag is managed here: it
+// is set on every event of a chain except the last. Chains are reordered to
+// fill packets, so chains that depend on each other must go in separate
+// rounds.
+template <tb_event T> class ChainPacker {
+public:
+  using traits = batch_traits<T>;
+  static constexpr std::size_t max_events = MAX_MESSAGE_SIZE / sizeof(T);
+
+  struct Slot {
+    std::size_t chain;
+    std::size_t offset; // First event of the chain within the packet
+    std::size_t length;
+  };
+
+  struct Packet {
+    std::vector<T> events;
+    std::vector<Slot> slots;
+  };
+
+  explicit ChainPacker(std::size_t packet_events = max_events)
+      : capacity(std::clamp<std::size_t>(packet_events, 1, max_events)) {}
+
+  // Queues a chain and returns its id, or nothing if it is empty or cannot
+  // fit in a single request.
+  std::optional<std::size_t> add(std::span<const T> chain) {
+    if (chain.empty() || chain.size() > capacity) {
+      return std::nullopt;
+    }
+    const auto id = chains.size();
+    chains.push_back(Chain{events.size(), chain.size()});
+    events.insert(events.end(), chain.begin(), chain.end());
+    for (auto i = events.size() - chain.size(); i < events.size(); ++i) {
+      events[i].flags |= traits::linked;
+    }
+    events.back().flags &= static_cast<uint16_t>(~traits::linked);
+    TB_TRACE(enqueue, nullptr, chain.size());
+    return id;
+  }
+
+  // Assigns queued chains to packets with best-fit decreasing and clears the
+  // queue. Chain ids restart from zero afterwards.
+  std::vector<Packet> pack() {
+    std::vector<std::size_t> order(chains.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](std::size_t a, std::size_t b) {
+                       return chains[a].length > chains[b].length;
+                     });
+
+    std::vector<Packet> packets;
+    // Remaining capacity -> packet index, to find the tightest fit.
+    std::multimap<std::size_t, std::size_t> room;
+    for (auto id : order) {
+      const auto &chain = chains[id];
+      auto it = room.lower_bound(chain.length);
+      std::size_t index;
+      if (it == room.end()) {
+        index = packets.size();
+        packets.emplace_back();
+        packets.back().events.reserve(capacity);
+      } else {
+        index = it->second;
+        room.erase(it);
+      }
+      auto &packet = packets[index];
+      packet.slots.push_back(Slot{id, packet.events.size(), chain.length});
+      packet.events.insert(packet.events.end(),
+                           events.begin() + chain.offset,
+                           events.begin() + chain.offset + chain.length);
+      if (auto left = capacity - packet.events.size(); left > 0) {
+        room.emplace(left, index);
+      }
+    }
+    chains.clear();
+    events.clear();
+    return packets;
+  }
+
+  // Packs and sends every queued chain, one request at a time, and returns
+  // one result per chain indexed by chain id.
+  std::vector<ChainResult<T>> send(Client &client) {
+    const auto total = chains.size();
+    auto packets = pack();
+    std::vector<ChainResult<T>> results(total);
+    for (std::size_t i = 0; i < total; ++i) {
+      results[i].chain = i;
+    }
+
+    auto ctx = std::make_unique<CompletionContext>();
+    for (auto &packet : packets) {
+      tb_packet_t request{};
+      request.operation = traits::operation;
+      request.data = packet.events.data();
+      request.data_size =
+          static_cast<uint32_t>(packet.events.size() * sizeof(T));
+      request.user_data = ctx.get();
+      request.status = TB_PACKET_OK;
+
+      client.send_request(request, ctx.get());
+
+      uint8_t status = request.status;
+      if (client.clientStatus() != TB_CLIENT_STATUS::TB_CLIENT_OK) {
+        status = TB_PACKET_CLIENT_SHUTDOWN;
+      }
+      std::span<const typename traits::result_type> failed;
+      if (status == TB_PACKET_OK) {
+        failed = {reinterpret_cast<const typename traits::result_type *>(
+                      ctx->reply.data()),
+                  ctx->size / sizeof(typename traits::result_type)};
+      }
+      distribute(packet, status, failed, results);
+    }
+    return results;
+  }
+
+  std::size_t size() const { return chains.size(); }
+  std::size_t event_count() const { return events.size(); }
+  bool empty() const { return chains.empty(); }
+
+  // Routes packet-relative results back to the chains they belong to, for
+  // packets from pack() that were submitted by the caller.
+  static void
+  distribute(const Packet &packet, uint8_t status,
+             std::span<const typename traits::result_type> failed,
+             std::vector<ChainResult<T>> &results) {
+    for (const auto &slot : packet.slots) {
+      results[slot.chain].packet_status = status;
+    }
+    for (const auto &f : failed) {
+      auto it = std::upper_bound(
+          packet.slots.begin(), packet.slots.end(), f.index,
+          [](uint32_t index, const Slot &s) { return index < s.offset; });
+      if (it == packet.slots.begin()) {
+        continue;
+      }
+      const auto &slot = *std::prev(it);
+      if (f.index >= slot.offset + slot.length) {
+        continue;
+      }
+      results[slot.chain].failures.push_back(
+          {static_cast<uint32_t>(f.index - slot.offset), f.result});
+    }
+  }
+
+private:
+  struct Chain {
+    std::size_t offset;
+    std::size_t length;
+  };
+
+  std::size_t capacity;
+  std::vector<Chain> chains;
+  std::vector<T> events;
+};
+
+} // namespace tigerbeetle
+#endif // TB_BATCH_HPP
@@ -0,0 +1,270 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+#ifndef TB_CAPTURE_HPP
+#define TB_CAPTURE_HPP
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tb_client.hpp"
+
+namespace tigerbeetle {
+
+// Capture file layout, in host byte order: the 16-byte CaptureFileHeader,
+// then one CaptureRecord per completed packet followed by its payload and
+// reply bytes. Records are in completion order.
+inline constexpr char capture_magic[8] = {'T', 'B', 'C', 'A',
+                                         'P', 'T', 'R', '1'};
+
+struct CaptureFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size; // sizeof(CaptureRecord)
+};
+
+struct CaptureRecord {
+  uint64_t submit_ns;   // Since the capture started
+  uint64_t complete_ns; // Since the capture started
+  uint32_t payload_size;
+  uint32_t reply_size;
+  uint32_t in_flight; // Packets in flight when it was submitted, itself too
+  uint8_t operation;
+  uint8_t status;
+  uint16_t reserved;
+};
+static_assert(sizeof(CaptureRecord) == 32);
+
+// Records the traffic of one or more clients into a capture file. The IO
+// thread only copies each completed packet into a memory buffer, outside
+// the writer's lock once it has reserved room; a background thread writes
+// it out. Past `max_buffered` bytes waiting for the disk, records are
+// dropped (and counted) rather than stalling the client. Two buffers of
+// `max_buffered` bytes are reserved up front and touched as they fill.
+class CaptureWriter final : public PacketRecorder {
+public:
+  explicit CaptureWriter(const std::string &path,
+                         std::size_t max_buffered = 64 * 1024 * 1024)
+      : limit(max_buffered), origin(std::chrono::steady_clock::now()),
+        filling(max_buffered), draining(max_buffered) {
+    file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+      throw std::runtime_error("Cannot open capture file " + path);
+    }
+    CaptureFileHeader header{};
+    std::memcpy(header.magic, capture_magic, sizeof(header.magic));
+    header.version = 1;
+    header.record_size = sizeof(CaptureRecord);
+    std::fwrite(&header, sizeof(header), 1, file);
+    writer = std::thread([this] { write_loop(); });
+  }
+
+  CaptureWriter(const CaptureWriter &) = delete;
+  CaptureWriter &operator=(const CaptureWriter &) = delete;
+
+  // Detach every client first: packets completing afterwards would use a
+  // destroyed recorder.
+  ~CaptureWriter() {
+    {
+      std::lock_guard lock(mutex);
+      stopping = true;
+    }
+    ready.notify_one();
+    writer.join();
+    std::fclose(file);
+  }
+
+  void attach(Client &client) { client.set_recorder(this); }
+
+  // Blocks until every record captured so far is written to the file.
+  void flush() {
+    std::unique_lock lock(mutex);
+    const auto target = appended;
+    ready.notify_one();
+    written_cv.wait(lock, [&] { return written >= target; });
+  }
+
+  std::size_t records() const {
+    return captured.load(std::memory_order_relaxed);
+  }
+  std::size_t dropped() const {
+    return lost.load(std::memory_order_relaxed);
+  }
+
+  void completed(const tb_packet_t &packet, const PacketSubmit &submit,
+                 const uint8_t *data, uint32_t size) override {
+    CaptureRecord record{};
+    record.submit_ns = since_origin(submit.time);
+    record.complete_ns = now();
+    record.in_flight = static_cast<uint32_t>(submit.in_flight);
+    record.payload_size = packet.data_size;
+    record.reply_size = size;
+    record.operation = packet.operation;
+    record.status = packet.status;
+
+    // Reserve the room under the lock, copy into it outside.
+    const auto bytes = sizeof(record) + packet.data_size + size;
+    uint8_t *at = nullptr;
+    {
+      std::lock_guard lock(mutex);
+      if (filling.used + bytes > limit) {
+        lost.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      at = filling.bytes.get() + filling.used;
+      filling.used += bytes;
+      ++copying;
+    }
+    std::memcpy(at, &record, sizeof(record));
+    if (packet.data_size != 0) {
+      std::memcpy(at + sizeof(record), packet.data, packet.data_size);
+    }
+    if (size != 0) {
+      std::memcpy(at + sizeof(record) + packet.data_size, data, size);
+    }
+    {
+      std::lock_guard lock(mutex);
+      --copying;
+      ++appended;
+    }
+    captured.fetch_add(1, std::memory_order_relaxed);
+    ready.notify_one();
+  }
+
+private:
+  // Fixed room for `limit` bytes: reserved ranges never move.
+  struct Buffer {
+    explicit Buffer(std::size_t capacity)
+        : bytes(std::make_unique_for_overwrite<uint8_t[]>(capacity)) {}
+    std::unique_ptr<uint8_t[]> bytes;
+    std::size_t used = 0;
+  };
+
+  uint64_t since_origin(std::chrono::steady_clock::time_point time) const {
+    return time > origin
+               ? static_cast<uint64_t>(
+                     std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         time - origin)
+                         .count())
+               : 0;
+  }
+
+  uint64_t now() const {
+    return since_origin(std::chrono::steady_clock::now());
+  }
+
+  void write_loop() {
+    std::unique_lock lock(mutex);
+    for (;;) {
+      // Only whole records: wait for copies into reserved room to finish.
+      ready.wait(lock, [this] {
+        return copying == 0 && (filling.used != 0 || stopping);
+      });
+      if (filling.used == 0) {
+        return;
+      }
+      std::swap(filling, draining);
+      const auto batch_end = appended;
+      lock.unlock();
+      std::fwrite(draining.bytes.get(), 1, draining.used, file);
+      std::fflush(file);
+      draining.used = 0;
+      lock.lock();
+      written = batch_end;
+      written_cv.notify_all();
+    }
+  }
+
+  const std::size_t limit;
+  const std::chrono::steady_clock::time_point origin;
+  std::FILE *file = nullptr;
+  std::atomic<std::size_t> captured{0};
+  std::atomic<std::size_t> lost{0};
+
+  std::mutex mutex; // Guards the fields below
+  std::condition_variable ready;
+  std::condition_variable written_cv;
+  Buffer filling;           // Records being appended, then written
+  Buffer draining;          // Records being written by the writer thread
+  std::size_t copying = 0;  // Records with room in `filling`, not copied yet
+  std::size_t appended = 0; // Records put in `filling` so far
+  std::size_t written = 0;  // Records handed to the file so far
+  bool stopping = false;
+  std::thread writer;
+};
+
+// One packet read back from a capture file.
+struct CaptureEntry {
+  CaptureRecord record{};
+  std::vector<uint8_t> payload;
+  std::vector<uint8_t> reply;
+};
+
+// Reads a capture file sequentially.
+class CaptureReader {
+public:
+  explicit CaptureReader(const std::string &path)
+      : file(std::fopen(path.c_str(), "rb")) {
+    if (file == nullptr) {
+      throw std::runtime_error("Cannot open capture file " + path);
+    }
+    CaptureFileHeader header{};
+    if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+        std::memcmp(header.magic, capture_magic, sizeof(header.magic)) != 0 ||
+        header.version != 1 || header.record_size != sizeof(CaptureRecord)) {
+      std::fclose(file);
+      throw std::runtime_error("Not a capture file: " + path);
+    }
+  }
+
+  CaptureReader(const CaptureReader &) = delete;
+  CaptureReader &operator=(const CaptureReader &) = delete;
+  ~CaptureReader() { std::fclose(file); }
+
+  // False at the end of the file; a record cut short by a crash counts as
+  // the end.
+  bool next(CaptureEntry &entry) {
+    if (std::fread(&entry.record, sizeof(entry.record), 1, file) != 1) {
+      return false;
+    }
+    entry.payload.resize(entry.record.payload_size);
+    entry.reply.resize(entry.record.reply_size);
+    return read(entry.payload) && read(entry.reply);
+  }
+
+private:
+  bool read(std::vector<uint8_t> &bytes) {
+    return bytes.empty() ||
+           std::fread(bytes.data(), 1, bytes.size(), file) == bytes.size();
+  }
+
+  std::FILE *file;
+};
+
+} // namespace tigerbeetle
+#endif // TB_CAPTURE_HPP
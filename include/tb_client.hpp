@@ -19,15 +19,27 @@ a source language processor.
 */
 #ifndef TB_CLIENT_HPP
 #define TB_CLIENT_HPP
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstdint>
 #include <functional>
+#include <future>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <span>
+#include <stdexcept>
+#include <stop_token>
 #include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "tb_trace.hpp"
 
 namespace tigerbeetle {
 
@@ -46,6 +58,17 @@ template <typename T>
 concept tb_integral =
     std::is_integral_v<T> && sizeof(T) == sizeof(tb_uint128_t);
 
+// Hash for tb_uint128_t keys, std::hash has no portable 128-bit
+// specialization.
+struct uint128_hash {
+  std::size_t operator()(tb_uint128_t value) const noexcept {
+    auto lo = static_cast<std::uint64_t>(value);
+    auto hi = static_cast<std::uint64_t>(value >> 64);
+    auto h = (lo ^ (hi * 0x9e3779b97f4a7c15ULL)) * 0xff51afd7ed558ccdULL;
+    return static_cast<std::size_t>(h ^ (h >> 32));
+  }
+};
+
 // Constants and type aliases
 constexpr size_t MAX_MESSAGE_SIZE = (1024 * 1024) - 256;
 template <std::size_t N> using accountID = std::array<tb_uint128_t, N>;
@@ -76,10 +99,83 @@ auto make_transfer() {
   return transfer<N>{};
 }
 
+// Wrapper-side outcomes reported through packet.status, above the range used
+// by TB_PACKET_STATUS.
+enum CLIENT_PACKET_STATUS : uint8_t {
+  CLIENT_PACKET_REJECTED = 200, // Refused by admission control (fail_fast)
+  CLIENT_PACKET_SHED = 201,     // Dropped from the admission queue
+  CLIENT_PACKET_TIMEOUT = 202,  // Deadline passed before the reply
+  CLIENT_PACKET_CANCELLED = 203 // Stop requested before the reply
+};
+
+using Deadline = std::chrono::steady_clock::time_point;
+
+// Size of one event of an operation, 1 when unknown.
+inline uint32_t event_size(uint8_t operation) {
+  switch (operation) {
+  case TB_OPERATION_CREATE_ACCOUNTS:
+    return sizeof(tb_account_t);
+  case TB_OPERATION_CREATE_TRANSFERS:
+    return sizeof(tb_transfer_t);
+  case TB_OPERATION_LOOKUP_ACCOUNTS:
+  case TB_OPERATION_LOOKUP_TRANSFERS:
+    return sizeof(tb_uint128_t);
+  case TB_OPERATION_GET_ACCOUNT_TRANSFERS:
+  case TB_OPERATION_GET_ACCOUNT_BALANCES:
+    return sizeof(tb_account_filter_t);
+  case TB_OPERATION_QUERY_ACCOUNTS:
+  case TB_OPERATION_QUERY_TRANSFERS:
+    return sizeof(tb_query_filter_t);
+  default:
+    return 1;
+  }
+}
+
+// What happens to a request that cannot be admitted right away.
+enum class OverloadPolicy : uint8_t {
+  block,      // Wait in FIFO order
+  fail_fast,  // Refuse with CLIENT_PACKET_REJECTED
+  shed_oldest // Wait, but past max_queued the oldest waiter is shed
+};
+
+enum class RateUnit : uint8_t { bytes, items };
+
+struct AdmissionOptions {
+  std::size_t max_in_flight = 0; // Submitted, not completed; 0 is unlimited
+  double rate = 0;               // Token bucket refill per second, 0 is off
+  double burst = 0;              // Bucket size, 0 is one second of rate
+  RateUnit unit = RateUnit::items;
+  OverloadPolicy policy = OverloadPolicy::block;
+  std::size_t max_queued = 1024; // Only used by shed_oldest
+};
+
+struct RequestTiming {
+  std::chrono::nanoseconds queue_wait{};   // Held back by admission control
+  std::chrono::nanoseconds service_time{}; // tb_client_submit to completion
+};
+
+struct DrainReport {
+  bool drained = false;      // Nothing was left in flight or unsent
+  std::size_t in_flight = 0; // Still waiting for a reply at the deadline
+  std::size_t unsent = 0;    // Dropped from the admission queue
+  std::size_t refused = 0;   // Submissions refused while draining
+  std::chrono::nanoseconds elapsed{};
+};
+
+// Start-up costs of a client, see Client::startup().
+struct StartupMetrics {
+  std::chrono::nanoseconds init{};        // tb_client_init
+  std::chrono::nanoseconds first_reply{}; // From construction, once ready
+  std::chrono::nanoseconds warm_up{};     // Spent in warm_up()
+  std::size_t probes = 0;                 // Sent by warm_up()
+  bool ready = false;                     // A reply came back
+};
+
 struct CompletionContext {
   std::array<uint8_t, MAX_MESSAGE_SIZE> reply;
   int size = 0;
   bool completed = false;
+  RequestTiming timing;
   std::mutex mutex;
   std::condition_variable cv; // For efficient waiting
 };
@@ -95,10 +191,56 @@ inline void default_on_completion([[maybe_unused]] uintptr_t context,
     std::copy(data_span.begin(), data_span.end(), ctx->reply.begin());
     ctx->size = static_cast<int>(size);
     ctx->completed = true;
+    // Under the lock, the waiter may free ctx as soon as it sees completed.
+    ctx->cv.notify_one();
   }
-  ctx->cv.notify_one(); // Notify the waiting thread
 }
 
+// Request submitted asynchronously through Client::submit(). `on_reply`
+// runs on the tb_client IO thread once the reply arrives (or the packet
+// fails, see packet.status); the reply bytes are only valid during the call.
+// Embed or derive from it to carry per-request state.
+struct Request {
+  tb_packet_t packet{};
+  void (*on_reply)(Request *request, uint64_t timestamp, const uint8_t *data,
+                   uint32_t size) = nullptr;
+  RequestTiming timing; // Filled in before on_reply
+
+  // Owned by Client while the request is queued or in flight.
+  std::chrono::steady_clock::time_point started{};
+  std::size_t in_flight_at_submit = 0;
+  Request *next_waiting = nullptr;
+};
+static_assert(std::is_standard_layout_v<Request>,
+              "Request must be recoverable from its packet");
+
+// How a packet was handed to tb_client, kept by the Client with the
+// request itself.
+struct PacketSubmit {
+  std::chrono::steady_clock::time_point time; // tb_client_submit
+  std::size_t in_flight = 0; // Packets in flight then, itself included
+};
+
+// Sees each packet that tb_client accepted once it completes, e.g. to
+// capture traffic (see tb_capture.hpp). Requests are recorded on the IO
+// thread, blocking send_request() calls on their caller once it wakes; the
+// call must not block.
+class PacketRecorder {
+public:
+  virtual void completed(const tb_packet_t &packet, const PacketSubmit &submit,
+                         const uint8_t *data, uint32_t size) = 0;
+
+protected:
+  ~PacketRecorder() = default;
+};
+
+// Selects tb_client_init_echo: the client replies with its own request
+// data without talking to a cluster. Meant for tests and benchmarks.
+struct echo_t {
+  explicit echo_t() = default;
+};
+inline constexpr echo_t echo_client{};
+
 class Client {
 public:
   using CallbackFn = std::function<void(uintptr_t, tb_packet_t *, uint64_t,
@@ -106,42 +248,31 @@ public:
 
   explicit Client(std::string_view address,
                   std::array<uint8_t, 16> cluster_id = {},
-                  uintptr_t on_completion_ctx = 0,
+                  [[maybe_unused]] uintptr_t on_completion_ctx = 0,
                   CallbackFn on_completion_fn = default_on_completion)
       : client{}, callback(std::move(on_completion_fn)) {
-    // Pass this as context, use static wrapper
-    status = tb_client_init(&client, cluster_id.data(), address.data(),
-                            address.length(), reinterpret_cast<uintptr_t>(this),
-                            &Client::static_on_completion);
-    client_status = (status == TB_INIT_STATUS::TB_INIT_SUCCESS)
-                        ? TB_CLIENT_STATUS::TB_CLIENT_OK
-                        : TB_CLIENT_STATUS::TB_CLIENT_INVALID;
-  }
-  // Delete copy operations
-  Client(const Client &) = delete;
-  Client &operator=(const Client &) = delete;
-
-  // Move operations
-  Client(Client &&other) noexcept : client{}, status{}, client_status{} {
-    std::swap(client, other.client);
-    std::swap(status, other.status);
-    std::swap(client_status, other.client_status);
+    init(&tb_client_init, address, cluster_id);
   }
 
-  Client &operator=(Client &&other) noexcept {
-    if (this != &other) {
-      destroy();
-      std::swap(client, other.client);
-      std::swap(status, other.status);
-      std::swap(client_status, other.client_status);
-    }
-    return *this;
+  Client(echo_t, std::string_view address,
+         std::array<uint8_t, 16> cluster_id = {},
+         CallbackFn on_completion_fn = default_on_completion)
+      : client{}, callback(std::move(on_completion_fn)) {
+    init(&tb_client_init_echo, address, cluster_id);
   }
+  // Not copyable or movable: tb_client_t, the completion threads and the
+  // hooks all hold `this`. Keep a Client in place (optional, unique_ptr).
+  Client(const Client &) = delete;
+  Client &operator=(const Client &) = delete;
+  Client(Client &&) = delete;
+  Client &operator=(Client &&) = delete;
 
   ~Client() noexcept {
+    stop_refill();
     if (client_status == TB_CLIENT_STATUS::TB_CLIENT_OK) {
       destroy();
     }
+    stop_deadlines();
   }
 
   // Accessors
@@ -156,35 +287,825 @@ public:
                      std::make_unique<const tb_client_t>(client))
                : std::nullopt;
   }
+  // Borrowed handle, without the copy made by get().
+  tb_client_t *native_handle() {
+    return client.opaque[0] != 0 ? &client : nullptr;
+  }
   TB_INIT_STATUS initStatus() const { return status; }
   TB_CLIENT_STATUS clientStatus() const { return client_status; }
 
-  // Send request with efficient waiting
+  // Admission control, off by default. Configure it before submitting work:
+  // limits apply to send_request() and submit() alike, packets already in
+  // flight are counted either way.
+  void set_admission(const AdmissionOptions &options) {
+    stop_refill();
+    {
+      std::lock_guard lock(admission_mutex);
+      admission = options;
+      if (admission.burst <= 0) {
+        admission.burst = admission.rate;
+      }
+      tokens = admission.burst;
+      refilled = std::chrono::steady_clock::now();
+      admission_enabled.store(options.max_in_flight != 0 || options.rate > 0,
+                              std::memory_order_release);
+    }
+    if (options.rate > 0) {
+      refill_thread = std::thread([this] { run_refill(); });
+    }
+  }
+  const AdmissionOptions &admission_options() const { return admission; }
+
+  // Sees every completed packet before its callback or on_reply, while the
+  // request data is still valid. Runs on the tb_client IO thread; set it
+  // before submitting work.
+  using ReplyObserver = std::function<void(
+      const tb_packet_t &packet, const uint8_t *data, uint32_t size)>;
+  void set_reply_observer(ReplyObserver fn) { observer = std::move(fn); }
+
+  // Opt-in recording of every accepted packet, nullptr to stop. Set it
+  // before submitting work; the recorder must outlive the requests it sees.
+  void set_recorder(PacketRecorder *packet_recorder) {
+    recorder = packet_recorder;
+  }
+
+  // Becomes ready with the first successful reply, from warm_up() or real
+  // traffic; holds an exception when tb_client_init failed. A client that is
+  // destroyed before any reply leaves it with std::future_error.
+  std::shared_future<void> ready() const { return ready_future; }
+
+  // Sends a cheap probe, a lookup of account 0 (never a valid id), and waits
+  // for its reply so that connecting and finding the cluster are paid for
+  // before real traffic arrives. True once the client is ready; false at
+  // `deadline`, when `stop` is requested or when the probe fails.
+  bool warm_up(Deadline deadline, std::stop_token stop = {}) {
+    if (ready_flag.load(std::memory_order_acquire)) {
+      return true;
+    }
+    if (client_status != TB_CLIENT_STATUS::TB_CLIENT_OK) {
+      return false;
+    }
+    const auto started = std::chrono::steady_clock::now();
+    tb_uint128_t id = 0;
+    tb_packet_t packet{};
+    packet.operation = TB_OPERATION_LOOKUP_ACCOUNTS;
+    packet.data = &id;
+    packet.data_size = sizeof(id);
+    auto ctx = std::make_unique<CompletionContext>();
+    send_request(packet, ctx.get(), deadline, stop);
+    std::lock_guard lock(startup_mutex);
+    ++startup_metrics.probes;
+    startup_metrics.warm_up += std::chrono::steady_clock::now() - started;
+    return startup_metrics.ready;
+  }
+
+  StartupMetrics startup() const {
+    std::lock_guard lock(startup_mutex);
+    return startup_metrics;
+  }
+
+  // Packets submitted and not completed yet.
+  std::size_t in_flight() const {
+    return in_flight_count.load(std::memory_order_acquire);
+  }
+  // Requests held back by admission control.
+  std::size_t queued() {
+    std::lock_guard lock(admission_mutex);
+    return waiting_count;
+  }
+
+  // Send request with efficient waiting. When admission control refuses or
+  // sheds the packet, packet.status says so and nothing is sent.
   void send_request(tb_packet_t &packet, CompletionContext *ctx) {
+    TB_TRACE(seal, &packet, packet.data_size);
     ctx->completed = false;
+    ctx->timing = {};
+    const auto started = std::chrono::steady_clock::now();
+    if (auto refused = admit_blocking(packet); refused != TB_PACKET_OK) {
+      packet.status = refused;
+      ctx->timing.queue_wait = std::chrono::steady_clock::now() - started;
+      return;
+    }
+    const PacketSubmit submit{std::chrono::steady_clock::now(),
+                              in_flight_count.load()};
+    ctx->timing.queue_wait = submit.time - started;
     {
       std::lock_guard lock(ctx->mutex);
-      client_status = tb_client_submit(&client, &packet);
+      client_status = submit_packet(packet);
     }
     if (client_status == TB_CLIENT_STATUS::TB_CLIENT_OK) {
       std::unique_lock lock(ctx->mutex);
       ctx->cv.wait(lock, [ctx] { return ctx->completed; });
+      ctx->timing.service_time = std::chrono::steady_clock::now() - submit.time;
+      TB_TRACE(wake, &packet, ctx->size);
+      lock.unlock();
+      if (recorder != nullptr) {
+        recorder->completed(packet, submit, ctx->reply.data(),
+                            static_cast<uint32_t>(ctx->size));
+      }
+    } else {
+      release_slot();
     }
   }
 
+  // Submit without waiting, `request.on_reply` is called on completion.
+  // The request must stay alive until then. Safe to call from inside a
+  // completion to chain requests; with admission control a request over the
+  // limit is queued rather than blocking the caller, and is submitted when a
+  // completion or the token bucket makes room.
+  // Returns TB_CLIENT_INVALID with packet.status CLIENT_PACKET_REJECTED when
+  // refused by fail_fast. A queued request that gets shed completes with
+  // CLIENT_PACKET_SHED, on the thread whose submit() pushed it out.
+  TB_CLIENT_STATUS submit(Request &request) {
+    TB_TRACE(seal, &request.packet, request.packet.data_size);
+    request.packet.user_data = &request_tag;
+    request.packet.status = TB_PACKET_OK;
+    request.timing = {};
+    request.next_waiting = nullptr;
+    request.started = std::chrono::steady_clock::now();
+    if (!admission_enabled.load(std::memory_order_acquire)) {
+      // Counted before checking, so drain() either sees it or refuses it.
+      in_flight_count.fetch_add(1);
+      if (refusing()) {
+        release_slot();
+        return refuse(request.packet);
+      }
+      return start(request);
+    }
+    Request *shed = nullptr;
+    {
+      std::lock_guard lock(admission_mutex);
+      if (refusing()) {
+        return refuse(request.packet);
+      }
+      if (waiting_head != nullptr || !try_take(request.packet)) {
+        if (admission.policy == OverloadPolicy::fail_fast) {
+          request.packet.status = CLIENT_PACKET_REJECTED;
+          return TB_CLIENT_STATUS::TB_CLIENT_INVALID;
+        }
+        shed = enqueue(request);
+        admission_cv.notify_all();
+        if (shed == nullptr) {
+          return TB_CLIENT_STATUS::TB_CLIENT_OK;
+        }
+      }
+    }
+    if (shed != nullptr) {
+      complete_unsent(*shed, CLIENT_PACKET_SHED);
+      return TB_CLIENT_STATUS::TB_CLIENT_OK;
+    }
+    return start(request);
+  }
+
+  // Registers a callback run by drain() before it waits, typically to send
+  // partially filled batches. Submissions from it are still accepted.
+  std::size_t on_drain(std::function<void()> flush) {
+    std::lock_guard lock(drain_mutex);
+    drain_hooks.emplace(++last_hook, std::move(flush));
+    return last_hook;
+  }
+  void remove_on_drain(std::size_t hook) {
+    std::lock_guard lock(drain_mutex);
+    drain_hooks.erase(hook);
+  }
+
+  // Graceful shutdown: refuses new work (TB_PACKET_CLIENT_SHUTDOWN), runs
+  // the on_drain() callbacks, then waits until every queued and in-flight
+  // packet has completed or `deadline` passes. What is still queued then is
+  // completed with TB_PACKET_CLIENT_SHUTDOWN and counted as unsent, and the
+  // client is deinitialized either way. Returns as soon as the work is done.
+  DrainReport drain(Deadline deadline) {
+    const auto started = std::chrono::steady_clock::now();
+    {
+      std::lock_guard lock(admission_mutex);
+      drain_owner.store(std::this_thread::get_id());
+      draining.store(true);
+    }
+    std::map<std::size_t, std::function<void()>> hooks;
+    {
+      std::lock_guard lock(drain_mutex);
+      hooks = drain_hooks;
+    }
+    for (auto &[hook, flush] : hooks) {
+      flush();
+    }
+    drain_owner.store({});
+    {
+      std::unique_lock lock(drain_mutex);
+      drain_cv.wait_until(lock, deadline, [this] {
+        return in_flight_count.load() == 0 && submitting.load() == 0 &&
+               queued() == 0;
+      });
+    }
+    DrainReport report;
+    report.unsent = fail_queued(TB_PACKET_CLIENT_SHUTDOWN);
+    report.in_flight = in_flight_count.load();
+    report.refused = refused_count.load(std::memory_order_relaxed);
+    report.drained = report.unsent == 0 && report.in_flight == 0;
+    destroy();
+    stop_refill();
+    stop_deadlines();
+    report.elapsed = std::chrono::steady_clock::now() - started;
+    return report;
+  }
+
+  // send_request() that gives up at `deadline` or when `stop` is requested,
+  // leaving packet.status CLIENT_PACKET_TIMEOUT or CLIENT_PACKET_CANCELLED.
+  // A packet still held back by admission control then is never sent.
+  // The packet data is copied and the reply is only written to `ctx` while
+  // the caller waits, so both may be freed as soon as this returns; a late
+  // reply is dropped. The client callback is not involved.
+  void send_request(tb_packet_t &packet, CompletionContext *ctx,
+                    Deadline deadline, std::stop_token stop = {}) {
+    ctx->completed = false;
+    ctx->timing = {};
+    auto *call = make_call(packet);
+    call->ctx = ctx;
+    call->refs.store(2, std::memory_order_relaxed); // In flight and waiter
+    if (auto result = submit(*call); result != TB_CLIENT_STATUS::TB_CLIENT_OK) {
+      // Refused (admission, drain): packet.status says why, the client
+      // itself stays usable.
+      packet.status = call->packet.status;
+      release(call);
+      release(call);
+      return;
+    }
+    std::unique_lock lock(call->mutex);
+    if (!call->cv.wait_until(lock, stop, deadline,
+                             [call] { return call->delivered; })) {
+      lock.unlock();
+      call->give_up(stop.stop_requested() ? CLIENT_PACKET_CANCELLED
+                                          : CLIENT_PACKET_TIMEOUT);
+      lock.lock();
+      // Lost to a reply being copied right now, let it finish.
+      call->cv.wait(lock, [call] { return call->delivered; });
+    }
+    packet.status = call->status;
+    TB_TRACE(wake, &call->packet, ctx->size);
+    ctx->timing = call->reported;
+    lock.unlock();
+    release(call);
+  }
+
+  // submit() whose `on_reply` runs with CLIENT_PACKET_TIMEOUT at `deadline`
+  // (on an internal timer thread) or CLIENT_PACKET_CANCELLED when `stop` is
+  // requested (on the requesting thread), whichever comes first. on_reply
+  // still runs exactly once, after which the request may be reused or freed
+  // even if the packet is still in flight: the client sends a copy of the
+  // data and drops a late reply. A request still held back by admission
+  // control at that point is taken out of the queue and never sent.
+  TB_CLIENT_STATUS submit(Request &request, Deadline deadline,
+                          std::stop_token stop = {}) {
+    request.packet.status = TB_PACKET_OK;
+    request.timing = {};
+    if (stop.stop_requested()) {
+      request.packet.status = CLIENT_PACKET_CANCELLED;
+      return TB_CLIENT_STATUS::TB_CLIENT_INVALID;
+    }
+    auto *call = make_call(request.packet);
+    call->target = &request;
+    if (deadline != Deadline::max()) {
+      arm(call, deadline);
+    }
+    if (stop.stop_possible()) {
+      call->on_stop.emplace(stop, Call::Cancel{call});
+    }
+    auto result = submit(*call);
+    if (result != TB_CLIENT_STATUS::TB_CLIENT_OK) {
+      disarm(call);
+      if (call->claimed.exchange(true)) {
+        result = TB_CLIENT_STATUS::TB_CLIENT_OK; // Cancelled meanwhile
+      } else {
+        request.packet.status = call->packet.status;
+      }
+      release(call);
+    }
+    return result;
+  }
+
 private:
+  // Marks packets owned by a Request, whatever callback the client has.
+  static inline char request_tag = 0;
+
   // Static wrapper to call the stored std::function
   static void static_on_completion([[maybe_unused]] uintptr_t context,
                                    [[maybe_unused]] tb_packet_t *packet,
                                    [[maybe_unused]] uint64_t timestamp,
                                    const uint8_t *data, uint32_t size) {
+#if defined(TB_TRACING)
+    [[maybe_unused]] thread_local const bool named = [] {
+      trace::name_thread("tb_client io");
+      return true;
+    }();
+#endif
+    TB_TRACE(complete, packet, size);
     auto *self = reinterpret_cast<Client *>(context);
+    if (packet->status == TB_PACKET_OK &&
+        !self->ready_flag.load(std::memory_order_relaxed)) {
+      self->mark_ready();
+    }
+    const bool is_request = packet->user_data == &request_tag;
+    if (self->recorder != nullptr && is_request) {
+      const auto *request = reinterpret_cast<const Request *>(packet);
+      self->recorder->completed(
+          *packet, {request->started, request->in_flight_at_submit}, data,
+          size);
+    }
+    if (self->observer) {
+      self->observer(*packet, data, size);
+    }
+    if (is_request) {
+      auto *request = reinterpret_cast<Request *>(packet);
+      request->timing.service_time =
+          std::chrono::steady_clock::now() - request->started;
+      self->release_slot();
+      request->on_reply(request, timestamp, data, size);
+      return;
+    }
+    self->release_slot();
     if (self->callback) {
       self->callback(context, packet, timestamp, data, size);
     }
   }
 
+  // Client-owned copy of a request sent with a deadline or stop token, so
+  // its caller can walk away early. Freed by whichever of the IO thread, the
+  // deadline thread and a blocking waiter lets go last.
+  struct Call : Request {
+    struct Cancel {
+      Call *call;
+      void operator()() const noexcept {
+        call->give_up(CLIENT_PACKET_CANCELLED);
+      }
+    };
+
+    // on_reply of the copy.
+    static void complete(Request *request, uint64_t timestamp,
+                         const uint8_t *data, uint32_t size) {
+      auto *call = static_cast<Call *>(request);
+      call->client->disarm(call);
+      call->finish(call->packet.status, call->timing, timestamp, data, size);
+      release(call);
+    }
+
+    // Deadline or cancellation. A copy still in the admission queue leaves
+    // it first, so that the caller can rely on it never being sent.
+    void give_up(uint8_t outcome) {
+      const bool withdrawn = client->withdraw(*this);
+      finish(outcome, {}, 0, nullptr, 0);
+      if (withdrawn) {
+        release(this); // The reference complete() would have dropped
+      }
+    }
+
+    // Hands the outcome to the caller, first come first served. Only replies
+    // come with timing, `timing` itself belongs to whoever completes the copy.
+    void finish(uint8_t outcome, const RequestTiming &measured,
+                uint64_t timestamp, const uint8_t *data, uint32_t size) {
+      if (claimed.exchange(true, std::memory_order_acq_rel)) {
+        return;
+      }
+      if (target != nullptr) {
+        target->packet.status = outcome;
+        target->timing = measured;
+        target->on_reply(target, timestamp, data, size);
+        return;
+      }
+      std::lock_guard lock(mutex);
+      if (outcome < CLIENT_PACKET_REJECTED) {
+        std::copy_n(data, size, ctx->reply.begin());
+        ctx->size = static_cast<int>(size);
+        ctx->completed = true;
+      }
+      status = outcome;
+      reported = measured;
+      delivered = true;
+      cv.notify_all();
+    }
+
+    Client *client = nullptr;
+    std::vector<uint8_t> payload;
+    std::atomic<int> refs{1};
+    std::atomic<bool> claimed{false};
+    Request *target = nullptr;          // submit()
+    CompletionContext *ctx = nullptr;   // send_request()
+    std::mutex mutex;                   // Guards the fields below for ctx
+    std::condition_variable_any cv;
+    bool delivered = false;
+    uint8_t status = TB_PACKET_OK;
+    RequestTiming reported;
+    std::multimap<Deadline, Call *>::iterator timer; // Under deadline_mutex
+    bool armed = false;
+    std::optional<std::stop_callback<Cancel>> on_stop; // Destroyed first
+  };
+
+  Call *make_call(const tb_packet_t &packet) {
+    auto *call = new Call;
+    call->client = this;
+    const auto *data = static_cast<const uint8_t *>(packet.data);
+    call->payload.assign(data, data + packet.data_size);
+    call->packet.data = call->payload.data();
+    call->packet.data_size = packet.data_size;
+    call->packet.user_tag = packet.user_tag;
+    call->packet.operation = packet.operation;
+    call->on_reply = &Call::complete;
+    return call;
+  }
+
+  static void release(Call *call) {
+    if (call->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete call;
+    }
+  }
+
+  void arm(Call *call, Deadline deadline) {
+    std::lock_guard lock(deadline_mutex);
+    if (!deadline_thread.joinable()) {
+      deadline_thread = std::thread([this] { run_deadlines(); });
+    }
+    call->refs.fetch_add(1, std::memory_order_relaxed);
+    call->timer = deadlines.emplace(deadline, call);
+    call->armed = true;
+    if (call->timer == deadlines.begin()) {
+      deadline_cv.notify_one();
+    }
+  }
+
+  void disarm(Call *call) {
+    {
+      std::lock_guard lock(deadline_mutex);
+      if (!call->armed) {
+        return;
+      }
+      deadlines.erase(call->timer);
+      call->armed = false;
+    }
+    release(call);
+  }
+
+  void run_deadlines() {
+    std::unique_lock lock(deadline_mutex);
+    while (!deadlines_stopping) {
+      if (deadlines.empty()) {
+        deadline_cv.wait(lock);
+        continue;
+      }
+      auto first = deadlines.begin();
+      if (const auto when = first->first;
+          when > std::chrono::steady_clock::now()) {
+        deadline_cv.wait_until(lock, when); // The entry may go meanwhile
+        continue;
+      }
+      auto *call = first->second;
+      deadlines.erase(first);
+      call->armed = false;
+      lock.unlock();
+      call->give_up(CLIENT_PACKET_TIMEOUT);
+      release(call);
+      lock.lock();
+    }
+  }
+
+  void stop_deadlines() {
+    {
+      std::lock_guard lock(deadline_mutex);
+      deadlines_stopping = true;
+    }
+    deadline_cv.notify_all();
+    if (deadline_thread.joinable()) {
+      deadline_thread.join();
+    }
+  }
+
+  using InitFn = TB_INIT_STATUS (*)(tb_client_t *, const uint8_t *,
+                                    const char *, uint32_t, uintptr_t,
+                                    void (*)(uintptr_t, tb_packet_t *,
+                                             uint64_t, const uint8_t *,
+                                             uint32_t));
+
+  void init(InitFn init_fn, std::string_view address,
+            std::array<uint8_t, 16> &cluster_id) {
+    constructed = std::chrono::steady_clock::now();
+    // Pass this as context, use static wrapper
+    status = init_fn(&client, cluster_id.data(), address.data(),
+                     static_cast<uint32_t>(address.length()),
+                     reinterpret_cast<uintptr_t>(this),
+                     &Client::static_on_completion);
+    client_status = (status == TB_INIT_STATUS::TB_INIT_SUCCESS)
+                        ? TB_CLIENT_STATUS::TB_CLIENT_OK
+                        : TB_CLIENT_STATUS::TB_CLIENT_INVALID;
+    startup_metrics.init = std::chrono::steady_clock::now() - constructed;
+    if (client_status != TB_CLIENT_STATUS::TB_CLIENT_OK) {
+      ready_promise.set_exception(std::make_exception_ptr(
+          std::runtime_error("tb_client_init failed")));
+    }
+  }
+
+  // First successful reply, on the IO thread.
+  void mark_ready() {
+    std::lock_guard lock(startup_mutex);
+    if (ready_flag.exchange(true, std::memory_order_acq_rel)) {
+      return;
+    }
+    startup_metrics.ready = true;
+    startup_metrics.first_reply =
+        std::chrono::steady_clock::now() - constructed;
+    ready_promise.set_value();
+  }
+
+  // Submits a request that already holds an in-flight slot.
+  TB_CLIENT_STATUS start(Request &request) {
+    const auto now = std::chrono::steady_clock::now();
+    request.timing.queue_wait = now - request.started;
+    request.started = now;
+    request.in_flight_at_submit = in_flight_count.load();
+    auto result = submit_packet(request.packet);
+    if (result != TB_CLIENT_STATUS::TB_CLIENT_OK) {
+      release_slot();
+    }
+    return result;
+  }
+
+  // tb_client_submit, counted so that drain() never deinitializes the client
+  // under a caller that is still inside it.
+  TB_CLIENT_STATUS submit_packet(tb_packet_t &packet) {
+    submitting.fetch_add(1);
+    TB_TRACE(submit, &packet, packet.data_size);
+    auto result = tb_client_submit(&client, &packet);
+    if (submitting.fetch_sub(1) == 1 && draining.load()) {
+      std::lock_guard lock(drain_mutex);
+      drain_cv.notify_all();
+    }
+    return result;
+  }
+
+  // Takes an in-flight slot for a blocking caller, waiting per policy.
+  uint8_t admit_blocking(const tb_packet_t &packet) {
+    if (!admission_enabled.load(std::memory_order_acquire)) {
+      in_flight_count.fetch_add(1);
+      if (refusing()) {
+        release_slot();
+        refused_count.fetch_add(1, std::memory_order_relaxed);
+        return TB_PACKET_CLIENT_SHUTDOWN;
+      }
+      return TB_PACKET_OK;
+    }
+    std::unique_lock lock(admission_mutex);
+    if (refusing()) {
+      refused_count.fetch_add(1, std::memory_order_relaxed);
+      return TB_PACKET_CLIENT_SHUTDOWN;
+    }
+    if (waiting_head == nullptr && try_take(packet)) {
+      return TB_PACKET_OK;
+    }
+    if (admission.policy == OverloadPolicy::fail_fast) {
+      return CLIENT_PACKET_REJECTED;
+    }
+    // Stands in the queue for the caller; no on_reply marks it as blocking.
+    Request waiter;
+    waiter.packet.operation = packet.operation;
+    waiter.packet.data_size = packet.data_size;
+    waiter.packet.status = waiting_status;
+    Request *shed = enqueue(waiter);
+    admission_cv.notify_all();
+    if (shed != nullptr) {
+      lock.unlock();
+      complete_unsent(*shed, CLIENT_PACKET_SHED);
+      lock.lock();
+    }
+    admission_cv.wait(
+        lock, [&waiter] { return waiter.packet.status != waiting_status; });
+    return waiter.packet.status;
+  }
+
+  double cost(const tb_packet_t &packet) const {
+    if (admission.unit == RateUnit::bytes) {
+      return packet.data_size;
+    }
+    return std::max<uint32_t>(1,
+                              packet.data_size / event_size(packet.operation));
+  }
+
+  // Caller holds admission_mutex.
+  bool try_take(const tb_packet_t &packet) {
+    if (admission.max_in_flight != 0 &&
+        in_flight_count.load(std::memory_order_relaxed) >=
+            admission.max_in_flight) {
+      return false;
+    }
+    if (admission.rate > 0) {
+      const auto now = std::chrono::steady_clock::now();
+      const std::chrono::duration<double> elapsed = now - refilled;
+      tokens =
+          std::min(admission.burst, tokens + admission.rate * elapsed.count());
+      refilled = now;
+      // A packet larger than the bucket goes through once it is full.
+      const auto needed = cost(packet);
+      if (tokens < std::min(needed, admission.burst)) {
+        return false;
+      }
+      tokens -= needed;
+    }
+    in_flight_count.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Caller holds admission_mutex. Returns an asynchronous request pushed out
+  // by shed_oldest, to be completed once the lock is released.
+  Request *enqueue(Request &request) {
+    request.next_waiting = nullptr;
+    (waiting_tail != nullptr ? waiting_tail->next_waiting : waiting_head) =
+        &request;
+    waiting_tail = &request;
+    ++waiting_count;
+    if (admission.policy != OverloadPolicy::shed_oldest ||
+        waiting_count <= admission.max_queued) {
+      return nullptr;
+    }
+    auto *oldest = pop_waiting();
+    if (oldest->on_reply == nullptr) {
+      oldest->packet.status = CLIENT_PACKET_SHED;
+      admission_cv.notify_all();
+      return nullptr;
+    }
+    return oldest;
+  }
+
+  Request *pop_waiting() {
+    auto *head = waiting_head;
+    waiting_head = head->next_waiting;
+    if (waiting_head == nullptr) {
+      waiting_tail = nullptr;
+    }
+    head->next_waiting = nullptr;
+    --waiting_count;
+    return head;
+  }
+
+  // Unlinks a request from the admission queue. Returns false when it is not
+  // queued, i.e. already admitted, shed or never held back.
+  bool withdraw(Request &request) {
+    {
+      std::lock_guard lock(admission_mutex);
+      Request *previous = nullptr;
+      Request **link = &waiting_head;
+      while (*link != nullptr && *link != &request) {
+        previous = *link;
+        link = &previous->next_waiting;
+      }
+      if (*link == nullptr) {
+        return false;
+      }
+      *link = request.next_waiting;
+      if (waiting_tail == &request) {
+        waiting_tail = previous;
+      }
+      request.next_waiting = nullptr;
+      --waiting_count;
+    }
+    if (draining.load()) {
+      std::lock_guard lock(drain_mutex);
+      drain_cv.notify_all();
+    }
+    return true;
+  }
+
+  // Caller holds admission_mutex. Admits waiters in FIFO order while there
+  // is room; blocking callers are woken, asynchronous requests are chained
+  // for submit_admitted().
+  Request *dispatch() {
+    Request *ready = nullptr;
+    Request **tail = &ready;
+    bool woke = false;
+    while (waiting_head != nullptr && try_take(waiting_head->packet)) {
+      auto *request = pop_waiting();
+      if (request->on_reply == nullptr) {
+        request->packet.status = TB_PACKET_OK;
+        woke = true;
+      } else {
+        *tail = request;
+        tail = &request->next_waiting;
+      }
+    }
+    if (woke) {
+      admission_cv.notify_all();
+    }
+    return ready;
+  }
+
+  void submit_admitted(Request *ready) {
+    while (ready != nullptr) {
+      auto *request = ready;
+      ready = request->next_waiting;
+      request->next_waiting = nullptr;
+      if (start(*request) != TB_CLIENT_STATUS::TB_CLIENT_OK) {
+        complete_unsent(*request, TB_PACKET_CLIENT_SHUTDOWN);
+      }
+    }
+  }
+
+  static void complete_unsent(Request &request, uint8_t packet_status) {
+    request.timing.queue_wait =
+        std::chrono::steady_clock::now() - request.started;
+    request.packet.status = packet_status;
+    request.on_reply(&request, 0, nullptr, 0);
+  }
+
+  void release_slot() {
+    if (!admission_enabled.load(std::memory_order_acquire)) {
+      in_flight_count.fetch_sub(1, std::memory_order_release);
+    } else {
+      Request *ready = nullptr;
+      {
+        std::lock_guard lock(admission_mutex);
+        in_flight_count.fetch_sub(1, std::memory_order_release);
+        ready = dispatch();
+      }
+      submit_admitted(ready);
+    }
+    if (draining.load()) {
+      std::lock_guard lock(drain_mutex);
+      drain_cv.notify_all();
+    }
+  }
+
+  // Whether new work is turned away; drain hooks may still submit.
+  bool refusing() const {
+    return draining.load() &&
+           std::this_thread::get_id() != drain_owner.load();
+  }
+
+  TB_CLIENT_STATUS refuse(tb_packet_t &packet) {
+    refused_count.fetch_add(1, std::memory_order_relaxed);
+    packet.status = TB_PACKET_CLIENT_SHUTDOWN;
+    return TB_CLIENT_STATUS::TB_CLIENT_INVALID;
+  }
+
+  // Completes everything still in the admission queue with `packet_status`.
+  std::size_t fail_queued(uint8_t packet_status) {
+    Request *unsent = nullptr;
+    std::size_t count = 0;
+    {
+      std::lock_guard lock(admission_mutex);
+      Request **tail = &unsent;
+      while (waiting_head != nullptr) {
+        auto *request = pop_waiting();
+        ++count;
+        if (request->on_reply == nullptr) {
+          request->packet.status = packet_status;
+        } else {
+          *tail = request;
+          tail = &request->next_waiting;
+        }
+      }
+      admission_cv.notify_all();
+    }
+    while (unsent != nullptr) {
+      auto *request = unsent;
+      unsent = request->next_waiting;
+      request->next_waiting = nullptr;
+      complete_unsent(*request, packet_status);
+    }
+    return count;
+  }
+
+  // Admits requests held back only by the token bucket; completions take
+  // care of the in-flight limit.
+  void run_refill() {
+    std::unique_lock lock(admission_mutex);
+    while (!stopping) {
+      if (auto *ready = dispatch(); ready != nullptr) {
+        lock.unlock();
+        submit_admitted(ready);
+        lock.lock();
+        continue;
+      }
+      if (waiting_head == nullptr) {
+        admission_cv.wait(lock);
+        continue;
+      }
+      const auto needed = std::min(cost(waiting_head->packet), admission.burst);
+      const auto deficit = std::max(needed - tokens, 0.0) / admission.rate;
+      admission_cv.wait_for(lock, std::chrono::duration<double>(deficit));
+    }
+  }
+
+  void stop_refill() {
+    {
+      std::lock_guard lock(admission_mutex);
+      stopping = true;
+    }
+    admission_cv.notify_all();
+    if (refill_thread.joinable()) {
+      refill_thread.join();
+    }
+    std::lock_guard lock(admission_mutex);
+    stopping = false;
+  }
+
   void destroy() {
+    stop_refill();
+    fail_queued(TB_PACKET_CLIENT_SHUTDOWN); // Will not be sent any more
     if (client.opaque[0] != 0) {
       client_status = tb_client_deinit(&client);
       std::fill_n(client.opaque, 4, 0);
@@ -195,6 +1116,46 @@ private:
   TB_INIT_STATUS status;
   TB_CLIENT_STATUS client_status;
   CallbackFn callback; // Stored std::function
+  ReplyObserver observer;
+  PacketRecorder *recorder = nullptr;
+
+  std::chrono::steady_clock::time_point constructed;
+  std::atomic<bool> ready_flag{false};
+  std::promise<void> ready_promise;
+  std::shared_future<void> ready_future = ready_promise.get_future().share();
+  mutable std::mutex startup_mutex; // Guards startup_metrics
+  StartupMetrics startup_metrics;
+
+  // Marks a blocking caller still waiting in the admission queue.
+  static constexpr uint8_t waiting_status = 0xFF;
+
+  std::atomic<bool> admission_enabled{false};
+  std::atomic<std::size_t> in_flight_count{0};
+  AdmissionOptions admission;
+  std::mutex admission_mutex;
+  std::condition_variable admission_cv;
+  Request *waiting_head = nullptr; // FIFO linked through next_waiting
+  Request *waiting_tail = nullptr;
+  std::size_t waiting_count = 0;
+  double tokens = 0;
+  std::chrono::steady_clock::time_point refilled;
+  std::thread refill_thread;
+  bool stopping = false;
+
+  std::mutex deadline_mutex;
+  std::condition_variable deadline_cv;
+  std::multimap<Deadline, Call *> deadlines;
+  std::thread deadline_thread;
+  bool deadlines_stopping = false;
+
+  std::atomic<bool> draining{false};
+  std::atomic<std::thread::id> drain_owner; // Thread running the drain hooks
+  std::atomic<std::size_t> refused_count{0};
+  std::atomic<std::size_t> submitting{0};
+  std::mutex drain_mutex; // Guards drain_hooks, signals completions
+  std::condition_variable drain_cv;
+  std::map<std::size_t, std::function<void()>> drain_hooks;
+  std::size_t last_hook = 0;
 };
 
 } // namespace tigerbeetle
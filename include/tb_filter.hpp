@@ -0,0 +1,206 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+#ifndef TB_FILTER_HPP
+#define TB_FILTER_HPP
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory_resource>
+#include <ranges>
+#include <vector>
+
+#include "tb_batch.hpp"
+
+namespace tigerbeetle {
+
+// Split block Bloom filter of ids this process saw committed. Each id sets
+// one bit in each of the eight 32-bit words of a single 32-byte block, so
+// a query touches one cache line. Queries and inserts are lock free and may
+// run from any thread; clear() may not run concurrently with them.
+//
+// A negative answer is exact for the ids recorded here, a positive one is
+// only probable. Retry paths can drop an event whose id "may be committed"
+// only if a false positive is acceptable, otherwise it marks the events
+// worth a lookup before resubmitting. Lookups can skip ids the filter
+// rejects only when this process is the sole writer of those ids.
+class IdFilter {
+public:
+  static constexpr std::size_t block_size = 32; // Bytes
+
+  // Uses about `memory_bytes` (at least one block) from `resource`;
+  // HugePageResource suits filters of hundreds of millions of ids.
+  explicit IdFilter(
+      std::size_t memory_bytes,
+      std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+      : blocks(std::max<std::size_t>(memory_bytes / block_size, 1)),
+        words(blocks * words_per_block, 0, resource) {}
+
+  IdFilter(const IdFilter &) = delete;
+  IdFilter &operator=(const IdFilter &) = delete;
+
+  // Memory needed to hold `ids` ids at about `false_positive_rate`.
+  static std::size_t bytes_for(std::size_t ids,
+                               double false_positive_rate = 0.01) {
+    std::size_t bits_per_id = 4;
+    while (bits_per_id < 64 &&
+           expected_false_positives(bits_per_id) > false_positive_rate) {
+      ++bits_per_id;
+    }
+    return std::max<std::size_t>(ids * bits_per_id / 8, block_size);
+  }
+
+  void insert(tb_uint128_t id) {
+    const auto h = hash(id);
+    auto *block = &words[block_of(h) * words_per_block];
+    for (std::size_t i = 0; i < words_per_block; ++i) {
+      std::atomic_ref(block[i]).fetch_or(bit_of(h, i),
+                                         std::memory_order_relaxed);
+    }
+  }
+
+  template <std::ranges::input_range Ids>
+    requires std::convertible_to<std::ranges::range_reference_t<Ids>,
+                                 tb_uint128_t>
+  void insert(const Ids &ids) {
+    for (tb_uint128_t id : ids) {
+      insert(id);
+    }
+  }
+
+  // False: `id` was never inserted. True: it probably was.
+  bool may_contain(tb_uint128_t id) const {
+    const auto h = hash(id);
+    const auto *block = &words[block_of(h) * words_per_block];
+    uint32_t missing = 0;
+    for (std::size_t i = 0; i < words_per_block; ++i) {
+      const auto word = std::atomic_ref(const_cast<uint32_t &>(block[i]))
+                            .load(std::memory_order_relaxed);
+      missing |= bit_of(h, i) & ~word;
+    }
+    return missing == 0;
+  }
+
+  // Records the events of a create_* request that the reply shows
+  // committed: those without a result, and those that already existed.
+  template <tb_event T>
+  void record_created(
+      std::span<const T> events,
+      std::span<const typename batch_traits<T>::result_type> results) {
+    std::size_t next = 0;
+    for (const auto &r : results) {
+      if (r.index >= events.size() || r.index < next) {
+        continue; // Not a reply to these events
+      }
+      for (; next < r.index; ++next) {
+        insert(events[next].id);
+      }
+      if (r.result == batch_traits<T>::exists) {
+        insert(events[next].id);
+      }
+      next = r.index + 1;
+    }
+    for (; next < events.size(); ++next) {
+      insert(events[next].id);
+    }
+  }
+
+  // Feeds a completed packet through record_created() when it is a
+  // successful create_accounts or create_transfers.
+  void record_reply(const tb_packet_t &packet, const uint8_t *data,
+                    uint32_t size) {
+    if (packet.status != TB_PACKET_OK) {
+      return;
+    }
+    switch (packet.operation) {
+    case TB_OPERATION_CREATE_ACCOUNTS:
+      record<tb_account_t>(packet, data, size);
+      break;
+    case TB_OPERATION_CREATE_TRANSFERS:
+      record<tb_transfer_t>(packet, data, size);
+      break;
+    default:
+      break;
+    }
+  }
+
+  // Keeps the filter up to date with every create_* reply of `client`.
+  // Replaces any other reply observer; the filter must outlive the client's
+  // in-flight requests.
+  void attach(Client &client) {
+    client.set_reply_observer(
+        [this](const tb_packet_t &packet, const uint8_t *data,
+               uint32_t size) { record_reply(packet, data, size); });
+  }
+
+  std::size_t memory() const { return words.size() * sizeof(uint32_t); }
+
+  void clear() { std::fill(words.begin(), words.end(), 0); }
+
+private:
+  static constexpr std::size_t words_per_block = block_size / sizeof(uint32_t);
+
+  // Odd multipliers that pick a bit per word from the low half of the hash.
+  static constexpr uint32_t salts[words_per_block] = {
+      0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+      0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+  static uint64_t hash(tb_uint128_t id) {
+    auto h = static_cast<uint64_t>(id) ^
+             static_cast<uint64_t>(id >> 64) * 0x9e3779b97f4a7c15ULL;
+    h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdULL;
+    h = (h ^ (h >> 33)) * 0xc4ceb9fe1a85ec53ULL;
+    return h ^ (h >> 33);
+  }
+
+  std::size_t block_of(uint64_t h) const {
+    return static_cast<std::size_t>((h >> 32) * blocks >> 32);
+  }
+
+  static uint32_t bit_of(uint64_t h, std::size_t word) {
+    return uint32_t{1} << ((static_cast<uint32_t>(h) * salts[word]) >> 27);
+  }
+
+  // Poisson estimate over the number of ids that land in one block.
+  static double expected_false_positives(std::size_t bits_per_id) {
+    const double per_block = 8.0 * block_size / bits_per_id;
+    double p = std::exp(-per_block);
+    double rate = 0;
+    for (int n = 0; n < 1000; ++n) {
+      const double word_hit = 1 - std::pow(1 - 1.0 / 32, n);
+      rate += p * std::pow(word_hit, words_per_block);
+      p *= per_block / (n + 1);
+    }
+    return rate;
+  }
+
+  template <typename T>
+  void record(const tb_packet_t &packet, const uint8_t *data, uint32_t size) {
+    using Result = typename batch_traits<T>::result_type;
+    record_created<T>(
+        {static_cast<const T *>(packet.data), packet.data_size / sizeof(T)},
+        {reinterpret_cast<const Result *>(data), size / sizeof(Result)});
+  }
+
+  std::size_t blocks;
+  std::pmr::vector<uint32_t> words;
+};
+
+} // namespace tigerbeetle
+#endif // TB_FILTER_HPP
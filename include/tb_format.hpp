@@ -0,0 +1,531 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+#ifndef TB_FORMAT_HPP
+#define TB_FORMAT_HPP
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <concepts>
+#include <cstring>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#if __has_include(<format>)
+#include <format>
+#endif
+#if defined(USE_FMT)
+#include <fmt/format.h>
+#endif
+
+#include "tb_client.hpp"
+
+namespace tigerbeetle {
+
+constexpr std::size_t MAX_DECIMAL_DIGITS = 39; // 2^128 - 1
+constexpr std::size_t MAX_HEX_DIGITS = 32;
+
+inline constexpr char digit_pairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+inline constexpr uint64_t powers_of_ten[] = {1ULL,
+                                             10ULL,
+                                             100ULL,
+                                             1000ULL,
+                                             10000ULL,
+                                             100000ULL,
+                                             1000000ULL,
+                                             10000000ULL,
+                                             100000000ULL,
+                                             1000000000ULL,
+                                             10000000000ULL,
+                                             100000000000ULL,
+                                             1000000000000ULL,
+                                             10000000000000ULL,
+                                             100000000000000ULL,
+                                             1000000000000000ULL,
+                                             10000000000000000ULL,
+                                             100000000000000000ULL,
+                                             1000000000000000000ULL,
+                                             10000000000000000000ULL};
+
+// Exactly 19 digits, zero padded, two at a time from the end.
+inline char *write_decimal19(char *out, uint64_t value) {
+  char *p = out + 19;
+  for (int i = 0; i < 9; ++i) {
+    p -= 2;
+    std::memcpy(p, digit_pairs + 2 * (value % 100), 2);
+    value /= 100;
+  }
+  *--p = static_cast<char>('0' + value);
+  return out + 19;
+}
+
+inline char *write_decimal64(char *out, uint64_t value) {
+  char buffer[20];
+  char *p = buffer + sizeof(buffer);
+  while (value >= 100) {
+    p -= 2;
+    std::memcpy(p, digit_pairs + 2 * (value % 100), 2);
+    value /= 100;
+  }
+  if (value >= 10) {
+    p -= 2;
+    std::memcpy(p, digit_pairs + 2 * value, 2);
+  } else {
+    *--p = static_cast<char>('0' + value);
+  }
+  const auto size = static_cast<std::size_t>(buffer + sizeof(buffer) - p);
+  std::memcpy(out, p, size);
+  return out + size;
+}
+
+// Writes `value` in decimal without leading zeros and returns the end. `out`
+// needs room for MAX_DECIMAL_DIGITS. 128-bit values are split into 10^19
+// chunks so that only the first one or two steps divide 128-bit numbers.
+template <typename V> char *write_decimal(char *out, V value) {
+  if constexpr (sizeof(V) <= sizeof(uint64_t)) {
+    return write_decimal64(out, static_cast<uint64_t>(value));
+  } else {
+    constexpr uint64_t chunk = powers_of_ten[19];
+    if (value >> 64 == 0) {
+      return write_decimal64(out, static_cast<uint64_t>(value));
+    }
+    const tb_uint128_t high = value / chunk;
+    const auto low = static_cast<uint64_t>(value % chunk);
+    if (high >> 64 == 0) {
+      out = write_decimal64(out, static_cast<uint64_t>(high));
+    } else {
+      out = write_decimal64(out, static_cast<uint64_t>(high / chunk));
+      out = write_decimal19(out, static_cast<uint64_t>(high % chunk));
+    }
+    return write_decimal19(out, low);
+  }
+}
+
+// Lowercase hex without prefix or leading zeros. `out` needs room for
+// MAX_HEX_DIGITS.
+inline char *write_hex(char *out, tb_uint128_t value) {
+  const auto high = static_cast<uint64_t>(value >> 64);
+  const auto low = static_cast<uint64_t>(value);
+  const int bits = high != 0 ? 128 - std::countl_zero(high)
+                             : 64 - std::countl_zero(low);
+  const int digits = std::max(1, (bits + 3) / 4);
+  for (int i = digits - 1; i >= 0; --i) {
+    out[i] = "0123456789abcdef"[static_cast<unsigned>(value & 0xF)];
+    value >>= 4;
+  }
+  return out + digits;
+}
+
+// std::to_chars for tb_uint128_t, base 10 or 16.
+inline std::to_chars_result to_chars(char *first, char *last,
+                                     tb_uint128_t value, int base = 10) {
+  char buffer[MAX_DECIMAL_DIGITS];
+  char *end =
+      base == 16 ? write_hex(buffer, value) : write_decimal(buffer, value);
+  const auto size = end - buffer;
+  if (last - first < size) {
+    return {last, std::errc::value_too_large};
+  }
+  std::memcpy(first, buffer, static_cast<std::size_t>(size));
+  return {first + size, std::errc{}};
+}
+
+// std::from_chars for tb_uint128_t, base 10 or 16: no sign, prefix or
+// whitespace. On overflow every digit is consumed, `value` is left alone and
+// the result is errc::result_out_of_range.
+inline std::from_chars_result from_chars(const char *first, const char *last,
+                                         tb_uint128_t &value, int base = 10) {
+  const char *p = first;
+  tb_uint128_t result = 0;
+  bool overflow = false;
+  if (base == 16) {
+    for (; p != last; ++p) {
+      unsigned digit;
+      if (*p >= '0' && *p <= '9') {
+        digit = static_cast<unsigned>(*p - '0');
+      } else if ((*p | 0x20) >= 'a' && (*p | 0x20) <= 'f') {
+        digit = static_cast<unsigned>((*p | 0x20) - 'a' + 10);
+      } else {
+        break;
+      }
+      overflow |= (result >> 124) != 0;
+      result = result << 4 | digit;
+    }
+  } else {
+    constexpr auto max = ~tb_uint128_t{0};
+    // Up to 19 digits at a time in 64-bit arithmetic.
+    while (p != last && static_cast<unsigned>(*p - '0') < 10) {
+      uint64_t chunk = 0;
+      std::size_t n = 0;
+      for (; n < 19 && p != last && static_cast<unsigned>(*p - '0') < 10;
+           ++n, ++p) {
+        chunk = chunk * 10 + static_cast<uint64_t>(*p - '0');
+      }
+      const auto scale = powers_of_ten[n];
+      if (!overflow && result <= (max - chunk) / scale) {
+        result = result * scale + chunk;
+      } else {
+        overflow = true;
+      }
+    }
+  }
+  if (p == first) {
+    return {first, std::errc::invalid_argument};
+  }
+  if (overflow) {
+    return {p, std::errc::result_out_of_range};
+  }
+  value = result;
+  return {p, std::errc{}};
+}
+
+// Parses the whole of `text`, or nothing.
+inline std::optional<tb_uint128_t> parse_uint128(std::string_view text,
+                                                 int base = 10) {
+  tb_uint128_t value = 0;
+  const auto [end, error] =
+      from_chars(text.data(), text.data() + text.size(), value, base);
+  if (error != std::errc{} || end != text.data() + text.size()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+// Calls f(name, value) for every field of a record, in declaration order.
+template <typename F>
+constexpr void for_each_field(const tb_account_t &a, F &&f) {
+  f("id", a.id);
+  f("debits_pending", a.debits_pending);
+  f("debits_posted", a.debits_posted);
+  f("credits_pending", a.credits_pending);
+  f("credits_posted", a.credits_posted);
+  f("user_data_128", a.user_data_128);
+  f("user_data_64", a.user_data_64);
+  f("user_data_32", a.user_data_32);
+  f("ledger", a.ledger);
+  f("code", a.code);
+  f("flags", a.flags);
+  f("timestamp", a.timestamp);
+}
+
+template <typename F>
+constexpr void for_each_field(const tb_transfer_t &t, F &&f) {
+  f("id", t.id);
+  f("debit_account_id", t.debit_account_id);
+  f("credit_account_id", t.credit_account_id);
+  f("amount", t.amount);
+  f("pending_id", t.pending_id);
+  f("user_data_128", t.user_data_128);
+  f("user_data_64", t.user_data_64);
+  f("user_data_32", t.user_data_32);
+  f("timeout", t.timeout);
+  f("ledger", t.ledger);
+  f("code", t.code);
+  f("flags", t.flags);
+  f("timestamp", t.timestamp);
+}
+
+template <typename F>
+constexpr void for_each_field(const tb_create_accounts_result_t &r, F &&f) {
+  f("index", r.index);
+  f("result", r.result);
+}
+
+template <typename F>
+constexpr void for_each_field(const tb_create_transfers_result_t &r, F &&f) {
+  f("index", r.index);
+  f("result", r.result);
+}
+
+template <typename T>
+concept tb_record = requires(const T &record) {
+  for_each_field(record, [](const char *, const auto &) {});
+};
+
+template <typename V> constexpr std::size_t max_decimal_digits() {
+  switch (sizeof(V)) {
+  case 1:
+    return 3;
+  case 2:
+    return 5;
+  case 4:
+    return 10;
+  case 8:
+    return 20;
+  default:
+    return MAX_DECIMAL_DIGITS;
+  }
+}
+
+// Longest text written by write_fields or write_csv_row for a T.
+template <tb_record T> constexpr std::size_t max_text_size() {
+  std::size_t size = 0;
+  for_each_field(T{}, [&](const char *name, const auto &value) {
+    size += std::char_traits<char>::length(name) + 2 +
+            max_decimal_digits<std::remove_cvref_t<decltype(value)>>();
+  });
+  return size;
+}
+
+// `id=1 debits_pending=0 ...`, in decimal. `out` needs max_text_size<T>().
+template <tb_record T> char *write_fields(char *out, const T &record) {
+  bool first = true;
+  for_each_field(record, [&](const char *name, const auto &value) {
+    if (!first) {
+      *out++ = ' ';
+    }
+    first = false;
+    const auto length = std::strlen(name);
+    std::memcpy(out, name, length);
+    out += length;
+    *out++ = '=';
+    out = write_decimal(out, value);
+  });
+  return out;
+}
+
+// One CSV row in csv_header<T>() order, without the line break.
+template <tb_record T> char *write_csv_row(char *out, const T &record) {
+  bool first = true;
+  for_each_field(record, [&](const char *, const auto &value) {
+    if (!first) {
+      *out++ = ',';
+    }
+    first = false;
+    out = write_decimal(out, value);
+  });
+  return out;
+}
+
+template <tb_record T> std::string csv_header() {
+  std::string header;
+  for_each_field(T{}, [&](const char *name, const auto &) {
+    if (!header.empty()) {
+      header += ',';
+    }
+    header += name;
+  });
+  return header;
+}
+
+// Appends one CSV row per record. The output grows once for the whole range,
+// rows are encoded straight into it.
+template <std::ranges::contiguous_range R>
+  requires tb_record<std::ranges::range_value_t<R>>
+void append_csv(std::string &out, const R &records) {
+  using T = std::ranges::range_value_t<R>;
+  const auto start = out.size();
+  out.resize(start + std::ranges::size(records) * (max_text_size<T>() + 1));
+  char *p = out.data() + start;
+  for (const auto &record : records) {
+    p = write_csv_row(p, record);
+    *p++ = '\n';
+  }
+  out.resize(static_cast<std::size_t>(p - out.data()));
+}
+
+// Appends every value in decimal, each followed by `separator`.
+template <std::ranges::contiguous_range R>
+  requires std::same_as<std::ranges::range_value_t<R>, tb_uint128_t>
+void append_decimal(std::string &out, const R &values, char separator = '\n') {
+  const auto start = out.size();
+  out.resize(start + std::ranges::size(values) * (MAX_DECIMAL_DIGITS + 1));
+  char *p = out.data() + start;
+  for (const auto value : values) {
+    p = write_decimal(p, value);
+    *p++ = separator;
+  }
+  out.resize(static_cast<std::size_t>(p - out.data()));
+}
+
+// Shared by the std and fmt formatters. Records print as `name=value` pairs,
+// or as a CSV row with the `c` spec: "{}", "{:c}".
+template <tb_record T> struct RecordFormatter {
+  bool csv = false;
+
+  template <typename ParseContext> constexpr auto parse(ParseContext &ctx) {
+    auto it = ctx.begin();
+    if (it != ctx.end() && *it == 'c') {
+      csv = true;
+      ++it;
+    }
+    return it; // Anything else before '}' is rejected by the library
+  }
+
+  template <typename FormatContext>
+  auto format(const T &record, FormatContext &ctx) const {
+    char buffer[max_text_size<T>()];
+    char *end =
+        csv ? write_csv_row(buffer, record) : write_fields(buffer, record);
+    return std::copy(buffer, end, ctx.out());
+  }
+};
+
+// A named value of a tb_client.h enum: lowercase, without the prefix, e.g.
+// TB_CREATE_TRANSFER_EXISTS is "exists".
+struct EnumName {
+  int64_t value;
+  std::string_view name;
+};
+
+// Names of E's values; empty unless tb_client_names.hpp, generated from the
+// tb_client.h in use by cmake/EnumNames.cmake, is on the include path.
+template <typename E>
+inline constexpr std::span<const EnumName> enum_names = {};
+
+inline constexpr EnumName client_packet_status_names[] = {
+    {CLIENT_PACKET_REJECTED, "rejected"},
+    {CLIENT_PACKET_SHED, "shed"},
+    {CLIENT_PACKET_TIMEOUT, "timeout"},
+    {CLIENT_PACKET_CANCELLED, "cancelled"},
+};
+template <>
+inline constexpr std::span<const EnumName>
+    enum_names<CLIENT_PACKET_STATUS> = client_packet_status_names;
+
+} // namespace tigerbeetle
+
+#if __has_include("tb_client_names.hpp")
+#include "tb_client_names.hpp"
+#endif
+
+namespace tigerbeetle {
+
+// Name of a result, status or operation code, empty when unknown. Packet
+// statuses include the wrapper's own (CLIENT_PACKET_STATUS).
+template <typename E> constexpr std::string_view enum_name(E value) {
+  const auto number =
+      static_cast<int64_t>(static_cast<std::underlying_type_t<E>>(value));
+  for (const auto &entry : enum_names<E>) {
+    if (entry.value == number) {
+      return entry.name;
+    }
+  }
+  if constexpr (std::same_as<E, TB_PACKET_STATUS>) {
+    return enum_name(static_cast<CLIENT_PACKET_STATUS>(number));
+  }
+  return {};
+}
+
+// Result and status codes print as their name, "{:d}" or a value the names
+// do not know as their number.
+template <typename E> struct EnumFormatter {
+  bool numeric = false;
+
+  template <typename ParseContext> constexpr auto parse(ParseContext &ctx) {
+    auto it = ctx.begin();
+    if (it != ctx.end() && *it == 'd') {
+      numeric = true;
+      ++it;
+    }
+    return it;
+  }
+
+  template <typename FormatContext>
+  auto format(E value, FormatContext &ctx) const {
+    if (const auto name = enum_name(value); !numeric && !name.empty()) {
+      return std::copy(name.begin(), name.end(), ctx.out());
+    }
+    char buffer[20];
+    char *end = write_decimal64(
+        buffer, static_cast<uint64_t>(static_cast<std::underlying_type_t<E>>(
+                    value)));
+    return std::copy(buffer, end, ctx.out());
+  }
+};
+
+} // namespace tigerbeetle
+
+// tb_uint128_t already has formatters in both libraries, as a builtin
+// integer type.
+#if defined(__cpp_lib_format)
+template <>
+struct std::formatter<tigerbeetle::tb_account_t>
+    : tigerbeetle::RecordFormatter<tigerbeetle::tb_account_t> {};
+template <>
+struct std::formatter<tigerbeetle::tb_transfer_t>
+    : tigerbeetle::RecordFormatter<tigerbeetle::tb_transfer_t> {};
+template <>
+struct std::formatter<tigerbeetle::tb_create_accounts_result_t>
+    : tigerbeetle::RecordFormatter<tigerbeetle::tb_create_accounts_result_t> {
+};
+template <>
+struct std::formatter<tigerbeetle::tb_create_transfers_result_t>
+    : tigerbeetle::RecordFormatter<tigerbeetle::tb_create_transfers_result_t> {
+};
+template <>
+struct std::formatter<tigerbeetle::TB_CREATE_ACCOUNT_RESULT>
+    : tigerbeetle::EnumFormatter<tigerbeetle::TB_CREATE_ACCOUNT_RESULT> {};
+template <>
+struct std::formatter<tigerbeetle::TB_CREATE_TRANSFER_RESULT>
+    : tigerbeetle::EnumFormatter<tigerbeetle::TB_CREATE_TRANSFER_RESULT> {};
+template <>
+struct std::formatter<tigerbeetle::TB_PACKET_STATUS>
+    : tigerbeetle::EnumFormatter<tigerbeetle::TB_PACKET_STATUS> {};
+template <>
+struct std::formatter<tigerbeetle::TB_OPERATION>
+    : tigerbeetle::EnumFormatter<tigerbeetle::TB_OPERATION> {};
+template <>
+struct std::formatter<tigerbeetle::CLIENT_PACKET_STATUS>
+    : tigerbeetle::EnumFormatter<tigerbeetle::CLIENT_PACKET_STATUS> {};
+#endif
+
+#if defined(USE_FMT)
+template <>
+struct fmt::formatter<tigerbeetle::tb_account_t>
+    : tigerbeetle::RecordFormatter<tigerbeetle::tb_account_t> {};
+template <>
+struct fmt::formatter<tigerbeetle::tb_transfer_t>
+    : tigerbeetle::RecordFormatter<tigerbeetle::tb_transfer_t> {};
+template <>
+struct fmt::formatter<tigerbeetle::tb_create_accounts_result_t>
+    : tigerbeetle::RecordFormatter<tigerbeetle::tb_create_accounts_result_t> {
+};
+template <>
+struct fmt::formatter<tigerbeetle::tb_create_transfers_result_t>
+    : tigerbeetle::RecordFormatter<tigerbeetle::tb_create_transfers_result_t> {
+};
+template <>
+struct fmt::formatter<tigerbeetle::TB_CREATE_ACCOUNT_RESULT>
+    : tigerbeetle::EnumFormatter<tigerbeetle::TB_CREATE_ACCOUNT_RESULT> {};
+template <>
+struct fmt::formatter<tigerbeetle::TB_CREATE_TRANSFER_RESULT>
+    : tigerbeetle::EnumFormatter<tigerbeetle::TB_CREATE_TRANSFER_RESULT> {};
+template <>
+struct fmt::formatter<tigerbeetle::TB_PACKET_STATUS>
+    : tigerbeetle::EnumFormatter<tigerbeetle::TB_PACKET_STATUS> {};
+template <>
+struct fmt::formatter<tigerbeetle::TB_OPERATION>
+    : tigerbeetle::EnumFormatter<tigerbeetle::TB_OPERATION> {};
+template <>
+struct fmt::formatter<tigerbeetle::CLIENT_PACKET_STATUS>
+    : tigerbeetle::EnumFormatter<tigerbeetle::CLIENT_PACKET_STATUS> {};
+#endif
+
+#endif // TB_FORMAT_HPP
@@ -0,0 +1,178 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+#ifndef TB_MEMORY_HPP
+#define TB_MEMORY_HPP
+#include <atomic>
+#include <cstring>
+#include <memory_resource>
+#include <ranges>
+#include <vector>
+
+#include "tb_client.hpp"
+
+namespace tigerbeetle {
+
+// Batch and reply storage backed by a caller-chosen memory resource.
+template <typename T> using Batch = std::pmr::vector<T>;
+using ReplyBuffer = std::pmr::vector<uint8_t>;
+
+// Pool options sized so that whole request messages are recycled by a
+// std::pmr pool resource instead of going back upstream.
+inline std::pmr::pool_options message_pool_options() {
+  std::pmr::pool_options options;
+  options.max_blocks_per_chunk = 16;
+  options.largest_required_pool_block = MAX_MESSAGE_SIZE;
+  return options;
+}
+
+class PacketPool;
+
+// A Request that owns its payload and reply storage. Both buffers keep their
+// capacity when the request is recycled, so after warm-up filling and
+// completing pooled requests does not allocate.
+struct PooledRequest : Request {
+  explicit PooledRequest(std::pmr::memory_resource *resource)
+      : payload(resource), reply(resource) {}
+
+  // Copies `events` into the payload and points the packet at it.
+  template <std::ranges::contiguous_range Events>
+  void assign(TB_OPERATION operation, const Events &events) {
+    auto bytes = std::as_bytes(std::span(events));
+    payload.resize(bytes.size());
+    std::memcpy(payload.data(), bytes.data(), bytes.size());
+    packet = tb_packet_t{};
+    packet.operation = operation;
+    packet.data = payload.data();
+    packet.data_size = static_cast<uint32_t>(payload.size());
+  }
+
+  // Keeps a copy of a reply, usually from `on_reply` on the IO thread. The
+  // reply only allocates when it has to grow, and then from the request's
+  // resource: with an unsynchronized resource shared with other threads,
+  // size the replies beforehand (PacketPool::prefault) so it never grows.
+  void store_reply(const uint8_t *data, uint32_t size) {
+    reply.resize(size);
+    if (size != 0) {
+      std::memcpy(reply.data(), data, size);
+    }
+  }
+
+  std::pmr::vector<uint8_t> payload;
+  std::pmr::vector<uint8_t> reply;
+  void *user_data = nullptr;
+
+private:
+  friend class PacketPool;
+  PacketPool *home = nullptr;
+  PooledRequest *next = nullptr;
+};
+
+// Freelist of pooled requests. acquire() belongs to the thread that owns the
+// pool, typically one pool per submitting thread; release() may run on any
+// thread, including the tb_client IO thread from inside a completion, and
+// hands the request back to the pool it came from without locking.
+// The pool must outlive every request acquired from it.
+class PacketPool {
+public:
+  explicit PacketPool(
+      std::size_t preallocate = 0,
+      std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+      : memory(resource) {
+    for (std::size_t i = 0; i < preallocate; ++i) {
+      auto *request = make();
+      request->next = local;
+      local = request;
+    }
+  }
+
+  PacketPool(const PacketPool &) = delete;
+  PacketPool &operator=(const PacketPool &) = delete;
+
+  ~PacketPool() {
+    drain(local);
+    drain(returned.exchange(nullptr, std::memory_order_acquire));
+  }
+
+  // Owner thread only.
+  PooledRequest *acquire() {
+    if (local == nullptr) {
+      local = returned.exchange(nullptr, std::memory_order_acquire);
+    }
+    if (local == nullptr) {
+      ++created;
+      return make();
+    }
+    auto *request = local;
+    local = request->next;
+    request->next = nullptr;
+    request->on_reply = nullptr;
+    request->user_data = nullptr;
+    return request;
+  }
+
+  // Any thread.
+  static void release(PooledRequest *request) {
+    auto *pool = request->home;
+    auto *head = pool->returned.load(std::memory_order_relaxed);
+    do {
+      request->next = head;
+    } while (!pool->returned.compare_exchange_weak(
+        head, request, std::memory_order_release, std::memory_order_relaxed));
+  }
+
+  // Grows the payload and reply of every pooled request to `bytes` and
+  // writes them once, so that the first requests neither allocate nor
+  // page-fault. Owner thread only, usually right after construction.
+  void prefault(std::size_t bytes = MAX_MESSAGE_SIZE) {
+    for (auto *request = local; request != nullptr; request = request->next) {
+      request->payload.resize(bytes);
+      request->payload.clear();
+      request->reply.resize(bytes);
+      request->reply.clear();
+    }
+  }
+
+  // Requests created after construction, i.e. misses of the freelist.
+  std::size_t misses() const { return created; }
+  std::pmr::memory_resource *resource() const { return memory; }
+
+private:
+  PooledRequest *make() {
+    auto *request = new PooledRequest(memory);
+    request->home = this;
+    return request;
+  }
+
+  static void drain(PooledRequest *head) {
+    while (head != nullptr) {
+      auto *next = head->next;
+      delete head;
+      head = next;
+    }
+  }
+
+  std::pmr::memory_resource *memory;
+  PooledRequest *local = nullptr; // Owner side, no synchronization
+  std::size_t created = 0;
+  std::atomic<PooledRequest *> returned{nullptr};
+};
+
+} // namespace tigerbeetle
+#endif // TB_MEMORY_HPP
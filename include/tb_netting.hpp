@@ -0,0 +1,510 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+#ifndef TB_NETTING_HPP
+#define TB_NETTING_HPP
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "tb_client.hpp"
+#include "tb_pending.hpp"
+
+namespace tigerbeetle {
+
+// Where a leg went: the transfer that carries it, or no_transfer when it was
+// offset entirely by legs in the opposite direction.
+struct NettedLeg {
+  static constexpr uint32_t no_transfer =
+      std::numeric_limits<uint32_t>::max();
+
+  tb_uint128_t leg_id = 0;
+  tb_uint128_t net_id = 0; // 0 when offset entirely
+  uint32_t transfer = no_transfer; // Index into NettingPlan::transfers
+};
+
+// Transfers to submit for one window of legs, and the audit trail mapping
+// every leg, in arrival order, to the transfer that carries it.
+struct NettingPlan {
+  std::vector<tb_transfer_t> transfers;
+  std::vector<NettedLeg> audit;
+
+  void clear() {
+    transfers.clear();
+    audit.clear();
+  }
+};
+
+// Collapses plain transfers moving money between the same two accounts, on
+// the same ledger and code, into at most one net transfer per pair. The net
+// transfer takes the id of the first leg in the winning direction and
+// carries no user data; legs that cancel out are sent as nothing at all.
+//
+// Pending, linked, post/void, balancing, imported and closing transfers,
+// transfers with a timeout and those the cluster would reject anyway (zero
+// id, same account on both sides) are passed through untouched, after the
+// net transfers. So is a leg that would overflow its pair's 128-bit total.
+//
+// An id seen twice in a window is not netted twice: both legs are passed
+// through in arrival order, so the cluster creates the first and answers
+// the second with EXISTS or EXISTS_WITH_DIFFERENT_*, as it would without
+// netting.
+//
+// Netting trades per-leg semantics for throughput: the cluster only ever
+// sees the net transfers, so the original ids are not created there (the
+// audit trail is the record of them) and balance limits apply to the net
+// amounts. For the same reason a leg retried in a later window is not
+// idempotent: unless its id carried a net transfer, the cluster does not
+// know it and the retry is netted and committed again.
+class LegNetter {
+public:
+  // Whether `leg` may be folded into a net transfer.
+  static bool nettable(const tb_transfer_t &leg) {
+    return leg.flags == 0 && leg.timeout == 0 && leg.pending_id == 0 &&
+           leg.id != 0 && leg.debit_account_id != leg.credit_account_id;
+  }
+
+  void add(const tb_transfer_t &leg) {
+    const auto index = static_cast<uint32_t>(legs.size());
+    if (const auto first = find_or_insert_id(leg.id, index); first != index) {
+      pin(legs[first]);
+      legs.push_back(Leg{leg, 0, true});
+      return;
+    }
+    if (!nettable(leg)) {
+      legs.push_back(Leg{leg, 0, true});
+      return;
+    }
+    const auto pair_index = find_or_insert_pair(pair_key(leg));
+    auto &pair = pairs[pair_index];
+    auto &total = leg.debit_account_id == pair.key.low ? pair.forward
+                                                       : pair.backward;
+    if (total > std::numeric_limits<tb_uint128_t>::max() - leg.amount) {
+      legs.push_back(Leg{leg, 0, true});
+      return;
+    }
+    total += leg.amount;
+    legs.push_back(Leg{leg, pair_index, false});
+  }
+
+  void add(std::span<const tb_transfer_t> batch) {
+    for (const auto &leg : batch) {
+      add(leg);
+    }
+  }
+
+  std::size_t size() const { return legs.size(); }
+  bool empty() const { return legs.empty(); }
+
+  // Moves the window into `plan` and starts a new one. Net transfers come
+  // first, in the order their pairs were first seen, then the passed
+  // through transfers in arrival order.
+  void take(NettingPlan &plan) {
+    plan.clear();
+    plan.audit.reserve(legs.size());
+    std::vector<uint32_t> &carrier = scratch;
+    carrier.assign(pairs.size(), NettedLeg::no_transfer);
+    for (std::size_t i = 0; i < pairs.size(); ++i) {
+      const auto &pair = pairs[i];
+      if (pair.forward == pair.backward) {
+        continue;
+      }
+      const bool forward = pair.forward > pair.backward;
+      auto &net = plan.transfers.emplace_back();
+      net.debit_account_id = forward ? pair.key.low : pair.key.high;
+      net.credit_account_id = forward ? pair.key.high : pair.key.low;
+      net.amount = forward ? pair.forward - pair.backward
+                           : pair.backward - pair.forward;
+      net.ledger = pair.key.ledger;
+      net.code = pair.key.code;
+      carrier[i] = static_cast<uint32_t>(plan.transfers.size() - 1);
+    }
+    // Ids go to the net transfers once pinned legs are known.
+    for (const auto &leg : legs) {
+      if (leg.passed || carrier[leg.pair] == NettedLeg::no_transfer) {
+        continue;
+      }
+      auto &net = plan.transfers[carrier[leg.pair]];
+      if (net.id == 0 &&
+          net.debit_account_id == leg.transfer.debit_account_id) {
+        net.id = leg.transfer.id;
+      }
+    }
+    for (const auto &leg : legs) {
+      const auto id = leg.transfer.id;
+      if (leg.passed) {
+        plan.audit.push_back(NettedLeg{
+            id, id, static_cast<uint32_t>(plan.transfers.size())});
+        plan.transfers.push_back(leg.transfer);
+        continue;
+      }
+      const auto transfer = carrier[leg.pair];
+      plan.audit.push_back(NettedLeg{
+          id,
+          transfer == NettedLeg::no_transfer ? 0
+                                             : plan.transfers[transfer].id,
+          transfer});
+    }
+    clear();
+  }
+
+  void clear() {
+    legs.clear();
+    pairs.clear();
+    std::fill(pair_slots.begin(), pair_slots.end(), Slot{});
+    std::fill(id_slots.begin(), id_slots.end(), Slot{});
+    ids = 0;
+  }
+
+private:
+  struct Key {
+    tb_uint128_t low;
+    tb_uint128_t high;
+    uint32_t ledger;
+    uint16_t code;
+
+    bool operator==(const Key &) const = default;
+  };
+
+  struct Pair {
+    Key key;
+    tb_uint128_t forward = 0;  // Debited from low, credited to high
+    tb_uint128_t backward = 0; // Debited from high, credited to low
+  };
+
+  struct Leg {
+    tb_transfer_t transfer;
+    uint32_t pair; // Into pairs when netted
+    bool passed;
+  };
+
+  // Open addressing with linear probing, kept at most half full. A slot is
+  // eight bytes, so a probe sequence usually stays within one cache line;
+  // the tag rejects most mismatches before the entry itself is touched.
+  struct Slot {
+    uint32_t tag = 0; // High bits of the hash, never 0 in a used slot
+    uint32_t index = 0;
+  };
+
+  static Key pair_key(const tb_transfer_t &leg) {
+    const bool forward = leg.debit_account_id < leg.credit_account_id;
+    return {forward ? leg.debit_account_id : leg.credit_account_id,
+            forward ? leg.credit_account_id : leg.debit_account_id,
+            leg.ledger, leg.code};
+  }
+
+  static uint64_t hash(const Key &key) {
+    const uint128_hash mix;
+    uint64_t h = mix(key.low);
+    h ^= mix(key.high) * 0x9e3779b97f4a7c15ULL;
+    h ^= (uint64_t{key.ledger} << 16 | key.code) * 0xc2b2ae3d27d4eb4fULL;
+    return h ^ (h >> 29);
+  }
+
+  static uint64_t hash(tb_uint128_t id) {
+    const uint64_t h = uint128_hash{}(id) * 0x9e3779b97f4a7c15ULL;
+    return h ^ (h >> 29);
+  }
+
+  static uint32_t tag_of(uint64_t h) {
+    return static_cast<uint32_t>(h >> 32) | 1;
+  }
+
+  // The slot holding the entry `matches` accepts, or the free slot where it
+  // goes.
+  template <typename Matches>
+  static Slot &probe(std::vector<Slot> &table, uint64_t h, Matches &&matches) {
+    const auto tag = tag_of(h);
+    const auto mask = table.size() - 1;
+    for (auto i = static_cast<std::size_t>(h) & mask;; i = (i + 1) & mask) {
+      auto &slot = table[i];
+      if (slot.tag == 0 || (slot.tag == tag && matches(slot.index))) {
+        return slot;
+      }
+    }
+  }
+
+  // Makes room for one more entry, rehashing `count` existing ones.
+  template <typename HashOf>
+  static void reserve_one(std::vector<Slot> &table, std::size_t count,
+                          HashOf &&hash_of) {
+    if (2 * (count + 1) <= table.size()) {
+      return;
+    }
+    table.assign(std::max<std::size_t>(64, 2 * table.size()), Slot{});
+    for (std::size_t i = 0; i < count; ++i) {
+      const auto h = hash_of(i);
+      probe(table, h, [](uint32_t) { return false; }) =
+          Slot{tag_of(h), static_cast<uint32_t>(i)};
+    }
+  }
+
+  uint32_t find_or_insert_pair(const Key &key) {
+    reserve_one(pair_slots, pairs.size(),
+                [this](std::size_t i) { return hash(pairs[i].key); });
+    const auto h = hash(key);
+    auto &slot = probe(pair_slots, h,
+                       [&](uint32_t i) { return pairs[i].key == key; });
+    if (slot.tag == 0) {
+      slot = Slot{tag_of(h), static_cast<uint32_t>(pairs.size())};
+      pairs.push_back(Pair{key});
+    }
+    return slot.index;
+  }
+
+  // Index of the first leg with `id`, `index` if there is none yet. Ids are
+  // only rehashed from first occurrences, which is every leg whose id is
+  // still mapped to itself.
+  uint32_t find_or_insert_id(tb_uint128_t id, uint32_t index) {
+    if (2 * (ids + 1) > id_slots.size()) {
+      id_slots.assign(std::max<std::size_t>(64, 2 * id_slots.size()),
+                      Slot{});
+      ids = 0;
+      for (uint32_t i = 0; i < legs.size(); ++i) {
+        const auto leg_id = legs[i].transfer.id;
+        const auto h = hash(leg_id);
+        auto &slot = probe(id_slots, h, [&](uint32_t j) {
+          return legs[j].transfer.id == leg_id;
+        });
+        if (slot.tag == 0) {
+          slot = Slot{tag_of(h), i};
+          ++ids;
+        }
+      }
+    }
+    const auto h = hash(id);
+    auto &slot = probe(id_slots, h,
+                       [&](uint32_t i) { return legs[i].transfer.id == id; });
+    if (slot.tag == 0) {
+      slot = Slot{tag_of(h), index};
+      ++ids;
+    }
+    return slot.index;
+  }
+
+  // Takes a netted leg back out of its pair, to be sent as it is.
+  void pin(Leg &leg) {
+    if (leg.passed) {
+      return;
+    }
+    auto &pair = pairs[leg.pair];
+    (leg.transfer.debit_account_id == pair.key.low ? pair.forward
+                                                   : pair.backward) -=
+        leg.transfer.amount;
+    leg.passed = true;
+  }
+
+  std::vector<Slot> pair_slots;
+  std::vector<Slot> id_slots;
+  std::size_t ids = 0; // Distinct ids in id_slots
+  std::vector<Pair> pairs;
+  std::vector<Leg> legs;
+  std::vector<uint32_t> scratch;
+};
+
+// Outcome of one flushed window. `results` is per entry of `transfers`;
+// a leg's outcome is that of its carrier.
+struct NettingReport : NettingPlan {
+  std::vector<DecisionResult> results;
+
+  // Outcome of the leg at `index` in `audit`. Legs offset entirely always
+  // succeed.
+  DecisionResult result_of(std::size_t index) const {
+    const auto transfer = audit[index].transfer;
+    return transfer == NettedLeg::no_transfer ? DecisionResult{}
+                                              : results[transfer];
+  }
+
+  bool ok() const {
+    return std::all_of(results.begin(), results.end(),
+                       [](const DecisionResult &r) { return r.ok(); });
+  }
+};
+
+struct NettingOptions {
+  // A window opens with its first leg and closes this long after, when
+  // add() or poll() next runs.
+  std::chrono::microseconds linger{1000};
+  std::size_t max_legs = 1 << 20; // Closes a window early
+  std::size_t batch_size = MAX_TRANSFERS_PER_BATCH;
+};
+
+// Running totals of a NettingStage.
+struct NettingStats {
+  uint64_t legs = 0;      // Accepted by add()
+  uint64_t transfers = 0; // Submitted to the cluster in their place
+  uint64_t windows = 0;
+};
+
+// Netting stage in front of a Client: legs are collected for a linger
+// window, netted by LegNetter, and the resulting transfers are sent as
+// create_transfers batches. Each flushed window is reported, audit trail
+// included, to `on_flushed` on the flushing thread. Windows are also
+// flushed when the client drains.
+//
+// add() may be called from any thread; the caller that closes a window
+// sends it, so keep one stage per producer thread where latency matters.
+class NettingStage {
+public:
+  using Clock = std::chrono::steady_clock;
+  using FlushedFn = std::function<void(const NettingReport &)>;
+
+  explicit NettingStage(Client &tb_client, NettingOptions opts = {},
+                        FlushedFn flushed = {})
+      : client(tb_client), options(opts), on_flushed(std::move(flushed)),
+        ctx(std::make_unique<CompletionContext>()) {
+    options.batch_size = std::clamp<std::size_t>(options.batch_size, 1,
+                                                 MAX_TRANSFERS_PER_BATCH);
+    options.max_legs = std::max<std::size_t>(options.max_legs, 1);
+    drain_hook = client.on_drain([this] { flush(); });
+  }
+
+  NettingStage(const NettingStage &) = delete;
+  NettingStage &operator=(const NettingStage &) = delete;
+
+  ~NettingStage() { client.remove_on_drain(drain_hook); }
+
+  void add(const tb_transfer_t &leg, Clock::time_point now = Clock::now()) {
+    add(std::span(&leg, 1), now);
+  }
+
+  void add(std::span<const tb_transfer_t> legs,
+           Clock::time_point now = Clock::now()) {
+    bool due = false;
+    {
+      std::lock_guard lock(mutex);
+      if (open.empty()) {
+        opened = now;
+      }
+      open.add(legs);
+      totals.legs += legs.size();
+      due = open.size() >= options.max_legs || now - opened >= options.linger;
+    }
+    if (due) {
+      flush();
+    }
+  }
+
+  // Flushes the window if its linger time is up. Returns the number of legs
+  // flushed.
+  std::size_t poll(Clock::time_point now = Clock::now()) {
+    {
+      std::lock_guard lock(mutex);
+      if (open.empty() || now - opened < options.linger) {
+        return 0;
+      }
+    }
+    return flush();
+  }
+
+  // Nets and sends the open window now. Returns the number of legs flushed.
+  std::size_t flush() {
+    std::lock_guard send_lock(send_mutex);
+    {
+      std::lock_guard lock(mutex);
+      if (open.empty()) {
+        return 0;
+      }
+      open.take(report);
+      totals.transfers += report.transfers.size();
+      ++totals.windows;
+    }
+    send();
+    if (on_flushed) {
+      on_flushed(report);
+    }
+    return report.audit.size();
+  }
+
+  // Legs waiting in the open window.
+  std::size_t pending() const {
+    std::lock_guard lock(mutex);
+    return open.size();
+  }
+
+  NettingStats stats() const {
+    std::lock_guard lock(mutex);
+    return totals;
+  }
+
+private:
+  void send() {
+    report.results.assign(report.transfers.size(), DecisionResult{});
+    for (std::size_t start = 0; start < report.transfers.size();
+         start += options.batch_size) {
+      const auto count =
+          std::min(options.batch_size, report.transfers.size() - start);
+      tb_packet_t packet{};
+      packet.operation = TB_OPERATION_CREATE_TRANSFERS;
+      packet.data = report.transfers.data() + start;
+      packet.data_size = static_cast<uint32_t>(count * sizeof(tb_transfer_t));
+      packet.user_data = ctx.get();
+      packet.status = TB_PACKET_OK;
+
+      client.send_request(packet, ctx.get());
+
+      auto results = std::span(report.results).subspan(start, count);
+      if (client.clientStatus() != TB_CLIENT_STATUS::TB_CLIENT_OK ||
+          packet.status != TB_PACKET_OK) {
+        const auto status = packet.status != TB_PACKET_OK
+                                ? packet.status
+                                : uint8_t{TB_PACKET_CLIENT_SHUTDOWN};
+        for (auto &r : results) {
+          r.packet_status = status;
+        }
+        continue;
+      }
+      // Only failed events are reported back.
+      std::span<const tb_create_transfers_result_t> failed(
+          reinterpret_cast<const tb_create_transfers_result_t *>(
+              ctx->reply.data()),
+          ctx->size / sizeof(tb_create_transfers_result_t));
+      for (const auto &f : failed) {
+        if (f.index < results.size()) {
+          results[f.index].result =
+              static_cast<TB_CREATE_TRANSFER_RESULT>(f.result);
+        }
+      }
+    }
+  }
+
+  Client &client;
+  NettingOptions options;
+  FlushedFn on_flushed;
+
+  mutable std::mutex mutex; // Guards open, opened and totals
+  LegNetter open;
+  Clock::time_point opened;
+  NettingStats totals;
+
+  std::mutex send_mutex; // Serializes flushes, guards the fields below
+  NettingReport report;
+  std::unique_ptr<CompletionContext> ctx;
+  std::size_t drain_hook = 0;
+};
+
+} // namespace tigerbeetle
+#endif // TB_NETTING_HPP
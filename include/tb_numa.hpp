@@ -0,0 +1,269 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+#ifndef TB_NUMA_HPP
+#define TB_NUMA_HPP
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace tigerbeetle {
+
+constexpr std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// NUMA node of the CPU the calling thread is running on, 0 when unknown.
+inline int current_numa_node() {
+#if defined(__linux__)
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+    return static_cast<int>(node);
+  }
+#endif
+  return 0;
+}
+
+// CPUs that belong to a NUMA node, empty when unknown.
+inline std::vector<int> numa_node_cpus([[maybe_unused]] int node) {
+  std::vector<int> cpus;
+#if defined(__linux__)
+  char path[64];
+  std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+                node);
+  std::FILE *file = std::fopen(path, "r");
+  if (file == nullptr) {
+    return cpus;
+  }
+  // Ranges such as "0-3,8-11"
+  int first = 0;
+  while (std::fscanf(file, "%d", &first) == 1) {
+    int last = first;
+    int sep = std::fgetc(file);
+    if (sep == '-') {
+      if (std::fscanf(file, "%d", &last) != 1) {
+        break;
+      }
+      sep = std::fgetc(file);
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+    if (sep != ',') {
+      break;
+    }
+  }
+  std::fclose(file);
+#endif
+  return cpus;
+}
+
+// Pins the calling thread to a set of CPUs until restored or destroyed.
+// Threads started in the meantime inherit the mask.
+class CpuAffinity {
+public:
+  explicit CpuAffinity([[maybe_unused]] const std::vector<int> &cpus) {
+#if defined(__linux__)
+    if (cpus.empty() ||
+        sched_getaffinity(0, sizeof(previous), &previous) != 0) {
+      return;
+    }
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (auto cpu : cpus) {
+      if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &mask);
+      }
+    }
+    active = sched_setaffinity(0, sizeof(mask), &mask) == 0;
+#endif
+  }
+
+  CpuAffinity(const CpuAffinity &) = delete;
+  CpuAffinity &operator=(const CpuAffinity &) = delete;
+
+  ~CpuAffinity() { restore(); }
+
+  bool pinned() const { return active; }
+
+  void restore() {
+#if defined(__linux__)
+    if (active) {
+      sched_setaffinity(0, sizeof(previous), &previous);
+    }
+#endif
+    active = false;
+  }
+
+private:
+#if defined(__linux__)
+  cpu_set_t previous{};
+#endif
+  bool active = false;
+};
+
+// Pins the calling thread to the CPUs of a NUMA node, which is how the IO
+// thread of a Client constructed in this scope is kept on the node:
+//
+//   NodeAffinity pin(current_numa_node());
+//   Client client(address);
+class NodeAffinity : public CpuAffinity {
+public:
+  explicit NodeAffinity(int node) : CpuAffinity(numa_node_cpus(node)) {}
+};
+
+struct HugePageOptions {
+  int node = -1;        // NUMA node to bind to, -1 leaves placement alone
+  bool hugetlb = true;  // Try MAP_HUGETLB before transparent huge pages
+  bool prefault = true; // Touch every page on the allocating thread
+};
+
+// Memory resource that maps 2 MiB huge pages, falling back to regular pages
+// advised for transparent huge pages when none are reserved. Every
+// allocation is its own mapping rounded up to HUGE_PAGE_SIZE, so it is meant
+// as the upstream of a pool resource rather than for small objects:
+//
+//   HugePageResource huge({.node = current_numa_node()});
+//   std::pmr::unsynchronized_pool_resource pool(message_pool_options(),
+//                                               &huge);
+//
+// On platforms without mmap it forwards to aligned operator new.
+class HugePageResource : public std::pmr::memory_resource {
+public:
+  explicit HugePageResource(HugePageOptions opts = {}) : options(opts) {}
+
+  // Mappings served by MAP_HUGETLB and by the regular-page fallback.
+  std::size_t hugetlb_mappings() const {
+    return hugetlb_count.load(std::memory_order_relaxed);
+  }
+  std::size_t fallback_mappings() const {
+    return fallback_count.load(std::memory_order_relaxed);
+  }
+  int node() const { return options.node; }
+
+private:
+  static std::size_t round_up(std::size_t bytes) {
+    return (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+  }
+
+  void *do_allocate(std::size_t bytes, std::size_t alignment) override {
+#if defined(__linux__)
+    if (alignment <= HUGE_PAGE_SIZE) {
+      const auto length = round_up(bytes == 0 ? 1 : bytes);
+      void *ptr = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+      if (options.hugetlb) {
+        ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) {
+          hugetlb_count.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+#endif
+      if (ptr == MAP_FAILED) {
+        ptr = map_aligned(length);
+#if defined(MADV_HUGEPAGE)
+        madvise(ptr, length, MADV_HUGEPAGE);
+#endif
+        fallback_count.fetch_add(1, std::memory_order_relaxed);
+      }
+      bind(ptr, length);
+      if (options.prefault) {
+        // First touch decides placement, fault everything in now.
+        auto *bytes_ptr = static_cast<volatile uint8_t *>(ptr);
+        for (std::size_t offset = 0; offset < length; offset += 4096) {
+          bytes_ptr[offset] = 0;
+        }
+      }
+      return ptr;
+    }
+#endif
+    return ::operator new(bytes, std::align_val_t(alignment));
+  }
+
+  void do_deallocate(void *ptr, [[maybe_unused]] std::size_t bytes,
+                     std::size_t alignment) override {
+#if defined(__linux__)
+    if (alignment <= HUGE_PAGE_SIZE) {
+      munmap(ptr, round_up(bytes == 0 ? 1 : bytes));
+      return;
+    }
+#endif
+    ::operator delete(ptr, std::align_val_t(alignment));
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+
+#if defined(__linux__)
+  // Transparent huge pages only back 2 MiB aligned ranges, so over-map and
+  // trim both ends.
+  static void *map_aligned(std::size_t length) {
+    const auto padded = length + HUGE_PAGE_SIZE;
+    void *raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    const auto start = reinterpret_cast<uintptr_t>(raw);
+    const auto aligned = (start + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    if (const auto head = aligned - start; head != 0) {
+      munmap(raw, head);
+    }
+    if (const auto tail = start + padded - (aligned + length); tail != 0) {
+      munmap(reinterpret_cast<void *>(aligned + length), tail);
+    }
+    return reinterpret_cast<void *>(aligned);
+  }
+#endif
+
+  void bind([[maybe_unused]] void *ptr, [[maybe_unused]] std::size_t length) {
+#if defined(__linux__) && defined(SYS_mbind)
+    constexpr int MPOL_BIND_MODE = 2; // MPOL_BIND from <linux/mempolicy.h>
+    constexpr std::size_t BITS = 8 * sizeof(unsigned long);
+    if (options.node < 0 || options.node >= static_cast<int>(16 * BITS)) {
+      return;
+    }
+    unsigned long mask[16] = {};
+    const auto node = static_cast<std::size_t>(options.node);
+    mask[node / BITS] = 1UL << (node % BITS);
+    // Best effort: a kernel without NUMA support leaves placement alone.
+    syscall(SYS_mbind, ptr, length, MPOL_BIND_MODE, mask, 16 * BITS + 1, 0);
+#endif
+  }
+
+  HugePageOptions options;
+  std::atomic<std::size_t> hugetlb_count{0};
+  std::atomic<std::size_t> fallback_count{0};
+};
+
+} // namespace tigerbeetle
+#endif // TB_NUMA_HPP
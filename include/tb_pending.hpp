@@ -0,0 +1,420 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+#ifndef TB_PENDING_HPP
+#define TB_PENDING_HPP
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "tb_client.hpp"
+
+namespace tigerbeetle {
+
+// Posting with this amount settles the full pending amount.
+constexpr tb_uint128_t AMOUNT_MAX = std::numeric_limits<tb_uint128_t>::max();
+
+// Maximum number of transfers that fit in a single request.
+constexpr std::size_t MAX_TRANSFERS_PER_BATCH =
+    MAX_MESSAGE_SIZE / sizeof(tb_transfer_t);
+
+// Hashed timing wheel. Entries are bucketed by deadline tick, so scheduling
+// is O(1) and advancing only visits the slots that elapsed. Deadlines further
+// away than one revolution stay in their slot until their round comes up.
+// Cancellation is lazy: owners drop stale keys when they fire.
+template <typename Key, typename Clock = std::chrono::steady_clock>
+class TimerWheel {
+public:
+  using time_point = typename Clock::time_point;
+  using duration = typename Clock::duration;
+
+  explicit TimerWheel(duration tick_length, std::size_t slot_count = 4096,
+                      time_point start = Clock::now())
+      : slots(slot_count == 0 ? 1 : slot_count), tick(tick_length),
+        origin(start) {}
+
+  void schedule(const Key &key, time_point deadline) {
+    // Round up so that an entry never fires before its deadline.
+    auto at = ticks_at(deadline);
+    if (deadline > origin + at * tick) {
+      ++at;
+    }
+    at = std::max(at, cursor);
+    slots[at % slots.size()].push_back(Entry{key, at});
+    ++count;
+  }
+
+  // Fires every entry whose deadline is at or before `now`, in tick order.
+  template <typename Fn> std::size_t advance(time_point now, Fn &&on_expired) {
+    const auto target = ticks_at(now);
+    if (target < cursor) {
+      return 0;
+    }
+    std::size_t fired = 0;
+    const auto span =
+        std::min<std::uint64_t>(target - cursor + 1, slots.size());
+    for (std::uint64_t t = cursor; t < cursor + span; ++t) {
+      auto &slot = slots[t % slots.size()];
+      std::size_t kept = 0;
+      for (std::size_t i = 0; i < slot.size(); ++i) {
+        if (slot[i].tick <= target) {
+          on_expired(slot[i].key);
+          ++fired;
+        } else {
+          slot[kept++] = slot[i];
+        }
+      }
+      slot.resize(kept);
+    }
+    // The current tick stays open for entries scheduled in the past.
+    cursor = target;
+    count -= fired;
+    return fired;
+  }
+
+  std::size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+private:
+  struct Entry {
+    Key key;
+    std::uint64_t tick;
+  };
+
+  std::uint64_t ticks_at(time_point t) const {
+    if (t <= origin) {
+      return 0;
+    }
+    return static_cast<std::uint64_t>((t - origin) / tick);
+  }
+
+  std::vector<std::vector<Entry>> slots;
+  duration tick;
+  time_point origin;
+  std::uint64_t cursor = 0;
+  std::size_t count = 0;
+};
+
+// Outcome of a single post/void decision.
+struct DecisionResult {
+  uint8_t packet_status = TB_PACKET_OK;
+  TB_CREATE_TRANSFER_RESULT result = TB_CREATE_TRANSFER_OK;
+
+  bool ok() const {
+    return packet_status == TB_PACKET_OK && result == TB_CREATE_TRANSFER_OK;
+  }
+};
+
+struct PendingTransferOptions {
+  std::chrono::milliseconds tick{100};
+  std::size_t wheel_slots = 4096;
+  std::size_t batch_size = MAX_TRANSFERS_PER_BATCH;
+  // Longest a decision waits for its batch to fill, 0 to wait for flush().
+  std::chrono::milliseconds linger{10};
+};
+
+// Tracks outstanding pending transfers and coalesces post/void decisions from
+// any number of threads into full TB_OPERATION_CREATE_TRANSFERS batches.
+// Decisions are sent when a batch fills up, when flush() is called, when the
+// client drains, or once the oldest one has lingered for `linger`. The
+// manager has no thread of its own: lingering decisions go out from the next
+// post/void, poll() or expire() call, so a caller that may stop deciding must
+// call one of them periodically (or flush()).
+class PendingTransferManager {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit PendingTransferManager(Client &tb_client,
+                                  PendingTransferOptions opts = {})
+      : client(tb_client), options(opts),
+        wheel(std::chrono::duration_cast<Clock::duration>(opts.tick),
+              opts.wheel_slots),
+        linger_wheel(std::chrono::duration_cast<Clock::duration>(
+                         std::clamp(opts.linger / 4,
+                                    std::chrono::milliseconds(1),
+                                    std::chrono::milliseconds(1000))),
+                     64),
+        ctx(std::make_unique<CompletionContext>()) {
+    options.batch_size = std::clamp<std::size_t>(options.batch_size, 1,
+                                                 MAX_TRANSFERS_PER_BATCH);
+    queue.reserve(options.batch_size);
+    // Queued decisions go out before the client drains.
+    drain_hook = client.on_drain([this] { flush(); });
+  }
+
+  PendingTransferManager(const PendingTransferManager &) = delete;
+  PendingTransferManager &operator=(const PendingTransferManager &) = delete;
+
+  ~PendingTransferManager() { client.remove_on_drain(drain_hook); }
+
+  // Starts tracking a pending transfer that the cluster has accepted.
+  // `created` is when it was created; its `timeout` (seconds) counts from
+  // there. A zero timeout never expires locally.
+  void track(const tb_transfer_t &pending, Clock::time_point created =
+                                               Clock::now()) {
+    std::lock_guard lock(mutex);
+    auto deadline = Clock::time_point::max();
+    if (pending.timeout != 0) {
+      deadline = created + std::chrono::seconds(pending.timeout);
+      wheel.schedule(pending.id, deadline);
+    }
+    tracked.insert_or_assign(pending.id, Tracked{pending, deadline});
+  }
+
+  // Queues a post of `pending_id` as transfer `id`. Without an explicit
+  // amount the tracked pending amount is posted in full.
+  std::future<DecisionResult>
+  post(tb_uint128_t id, tb_uint128_t pending_id,
+       std::optional<tb_uint128_t> amount = std::nullopt) {
+    return decide(id, pending_id, TB_TRANSFER_POST_PENDING_TRANSFER, amount);
+  }
+
+  // Queues a void of `pending_id` as transfer `id`.
+  std::future<DecisionResult> void_pending(tb_uint128_t id,
+                                           tb_uint128_t pending_id) {
+    return decide(id, pending_id, TB_TRANSFER_VOID_PENDING_TRANSFER,
+                  std::nullopt);
+  }
+
+  // Sends every queued decision, in batches of at most `batch_size`.
+  // Returns the number of decisions sent.
+  std::size_t flush() {
+    std::lock_guard send_lock(send_mutex);
+    std::size_t sent = 0;
+    for (;;) {
+      {
+        std::lock_guard lock(mutex);
+        if (queue.empty()) {
+          break;
+        }
+        const auto n = std::min(queue.size(), options.batch_size);
+        batch.assign(queue.begin(), queue.begin() + n);
+        queue.erase(queue.begin(), queue.begin() + n);
+        if (queue.empty()) {
+          ++generation; // Any linger deadline pending is for sent decisions
+        }
+      }
+      send_batch();
+      sent += batch.size();
+      batch.clear();
+    }
+    return sent;
+  }
+
+  // Flushes the queued decisions if the oldest one has lingered long
+  // enough. Returns the number of decisions sent.
+  std::size_t poll(Clock::time_point now = Clock::now()) {
+    bool due = false;
+    {
+      std::lock_guard lock(mutex);
+      linger_wheel.advance(now, [&](uint64_t opened) {
+        due = due || (opened == generation && !queue.empty());
+      });
+    }
+    return due ? flush() : 0;
+  }
+
+  // Drops every tracked transfer whose timeout elapsed by `now`, calling
+  // `on_expired` with each one. The cluster voids them on its own; this only
+  // keeps the local view from growing without bound. Also polls lingering
+  // decisions.
+  template <typename Fn>
+  std::size_t expire(Clock::time_point now, Fn &&on_expired) {
+    poll(now);
+    std::vector<tb_transfer_t> expired;
+    {
+      std::lock_guard lock(mutex);
+      wheel.advance(now, [&](const tb_uint128_t &id) {
+        auto it = tracked.find(id);
+        // Skip keys that were decided or re-tracked with another deadline.
+        if (it == tracked.end() || it->second.deadline > now) {
+          return;
+        }
+        expired.push_back(it->second.transfer);
+        tracked.erase(it);
+      });
+    }
+    for (const auto &transfer : expired) {
+      on_expired(transfer);
+    }
+    return expired.size();
+  }
+
+  std::size_t expire(Clock::time_point now = Clock::now()) {
+    return expire(now, [](const tb_transfer_t &) {});
+  }
+
+  bool is_tracked(tb_uint128_t pending_id) const {
+    std::lock_guard lock(mutex);
+    return tracked.contains(pending_id);
+  }
+  std::size_t outstanding() const {
+    std::lock_guard lock(mutex);
+    return tracked.size();
+  }
+  std::size_t queued() const {
+    std::lock_guard lock(mutex);
+    return queue.size();
+  }
+
+private:
+  struct Tracked {
+    tb_transfer_t transfer;
+    Clock::time_point deadline;
+  };
+
+  struct Decision {
+    tb_transfer_t transfer;
+    std::shared_ptr<std::promise<DecisionResult>> promise;
+  };
+
+  std::future<DecisionResult> decide(tb_uint128_t id, tb_uint128_t pending_id,
+                                     TB_TRANSFER_FLAGS flag,
+                                     std::optional<tb_uint128_t> amount) {
+    Decision decision{tb_transfer_t{},
+                      std::make_shared<std::promise<DecisionResult>>()};
+    auto future = decision.promise->get_future();
+    auto &transfer = decision.transfer;
+    transfer.id = id;
+    transfer.pending_id = pending_id;
+    transfer.flags = static_cast<uint16_t>(flag);
+    transfer.amount = amount.value_or(
+        flag == TB_TRANSFER_POST_PENDING_TRANSFER ? AMOUNT_MAX : 0);
+
+    bool full = false;
+    {
+      std::lock_guard lock(mutex);
+      if (auto it = tracked.find(pending_id); it != tracked.end()) {
+        const auto &pending = it->second.transfer;
+        transfer.debit_account_id = pending.debit_account_id;
+        transfer.credit_account_id = pending.credit_account_id;
+        transfer.ledger = pending.ledger;
+        transfer.code = pending.code;
+        if (!amount && flag == TB_TRANSFER_POST_PENDING_TRANSFER) {
+          transfer.amount = pending.amount;
+        }
+      }
+      if (queue.empty() && options.linger.count() != 0) {
+        linger_wheel.schedule(generation, Clock::now() + options.linger);
+      }
+      queue.push_back(std::move(decision));
+      TB_TRACE(enqueue, nullptr, queue.size());
+      full = queue.size() >= options.batch_size;
+    }
+    if (full) {
+      flush();
+    } else {
+      poll();
+    }
+    return future;
+  }
+
+  void send_batch() {
+    transfers.resize(batch.size());
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+      transfers[i] = batch[i].transfer;
+    }
+
+    tb_packet_t packet{};
+    packet.operation = TB_OPERATION_CREATE_TRANSFERS;
+    packet.data = transfers.data();
+    packet.data_size =
+        static_cast<uint32_t>(transfers.size() * sizeof(tb_transfer_t));
+    packet.user_data = ctx.get();
+    packet.status = TB_PACKET_OK;
+
+    client.send_request(packet, ctx.get());
+
+    std::vector<DecisionResult> results(batch.size());
+    if (client.clientStatus() != TB_CLIENT_STATUS::TB_CLIENT_OK) {
+      for (auto &r : results) {
+        r.packet_status = TB_PACKET_CLIENT_SHUTDOWN;
+      }
+    } else if (packet.status != TB_PACKET_OK) {
+      for (auto &r : results) {
+        r.packet_status = packet.status;
+      }
+    } else {
+      // Only failed events are reported back.
+      std::span<const tb_create_transfers_result_t> failed(
+          reinterpret_cast<const tb_create_transfers_result_t *>(
+              ctx->reply.data()),
+          ctx->size / sizeof(tb_create_transfers_result_t));
+      for (const auto &f : failed) {
+        if (f.index < results.size()) {
+          results[f.index].result =
+              static_cast<TB_CREATE_TRANSFER_RESULT>(f.result);
+        }
+      }
+    }
+
+    {
+      std::lock_guard lock(mutex);
+      for (std::size_t i = 0; i < batch.size(); ++i) {
+        if (settles(results[i])) {
+          tracked.erase(batch[i].transfer.pending_id);
+        }
+      }
+    }
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+      batch[i].promise->set_value(results[i]);
+    }
+  }
+
+  // Whether a decision result means the pending transfer is no longer open.
+  static bool settles(const DecisionResult &r) {
+    if (r.packet_status != TB_PACKET_OK) {
+      return false;
+    }
+    switch (r.result) {
+    case TB_CREATE_TRANSFER_OK:
+    case TB_CREATE_TRANSFER_PENDING_TRANSFER_NOT_FOUND:
+    case TB_CREATE_TRANSFER_PENDING_TRANSFER_ALREADY_POSTED:
+    case TB_CREATE_TRANSFER_PENDING_TRANSFER_ALREADY_VOIDED:
+    case TB_CREATE_TRANSFER_PENDING_TRANSFER_EXPIRED:
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  Client &client;
+  PendingTransferOptions options;
+
+  mutable std::mutex mutex; // Guards the fields up to send_mutex
+  std::unordered_map<tb_uint128_t, Tracked, uint128_hash> tracked;
+  TimerWheel<tb_uint128_t, Clock> wheel;
+  std::vector<Decision> queue;
+  // Deadlines of the queue generations (one per emptied queue) still
+  // lingering; only the current generation's counts.
+  TimerWheel<uint64_t, Clock> linger_wheel;
+  uint64_t generation = 0;
+
+  std::mutex send_mutex; // Serializes flushes, guards the fields below
+  std::vector<Decision> batch;
+  std::vector<tb_transfer_t> transfers;
+  std::unique_ptr<CompletionContext> ctx;
+  std::size_t drain_hook = 0;
+};
+
+} // namespace tigerbeetle
+#endif // TB_PENDING_HPP
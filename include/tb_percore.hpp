@@ -0,0 +1,386 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+#ifndef TB_PERCORE_HPP
+#define TB_PERCORE_HPP
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <latch>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tb_client.hpp"
+#include "tb_numa.hpp"
+
+namespace tigerbeetle {
+
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+// Bounded single-producer single-consumer queue. Each side keeps a cached
+// copy of the other side's index and only reads the shared one when the
+// cache says full (or empty), so in steady state the two cores exchange one
+// cache line per batch of items rather than per item.
+template <typename T> class SpscRing {
+public:
+  explicit SpscRing(std::size_t capacity)
+      : mask(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1),
+        slots(mask + 1) {}
+
+  SpscRing(const SpscRing &) = delete;
+  SpscRing &operator=(const SpscRing &) = delete;
+
+  // Producer only. False when full.
+  bool try_push(T value) {
+    const auto tail = tail_index.load(std::memory_order_relaxed);
+    if (tail - head_cache == slots.size()) {
+      head_cache = head_index.load(std::memory_order_acquire);
+      if (tail - head_cache == slots.size()) {
+        return false;
+      }
+    }
+    slots[tail & mask] = std::move(value);
+    tail_index.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only. False when empty.
+  bool try_pop(T &value) {
+    const auto head = head_index.load(std::memory_order_relaxed);
+    if (head == tail_cache) {
+      tail_cache = tail_index.load(std::memory_order_acquire);
+      if (head == tail_cache) {
+        return false;
+      }
+    }
+    value = std::move(slots[head & mask]);
+    head_index.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only.
+  bool empty() const {
+    return head_index.load(std::memory_order_relaxed) ==
+           tail_index.load(std::memory_order_acquire);
+  }
+
+  std::size_t capacity() const { return slots.size(); }
+
+private:
+  const std::size_t mask;
+  std::vector<T> slots;
+  alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> head_index{0};
+  std::size_t tail_cache = 0; // Consumer side
+  alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> tail_index{0};
+  std::size_t head_cache = 0; // Producer side
+};
+
+struct CoreOptions {
+  std::vector<int> cpus;    // One worker pinned to each; empty runs one
+                            // unpinned worker per hardware thread
+  std::vector<int> io_cpus; // Where each core's IO thread runs, empty for
+                            // the worker's CPU
+  std::size_t max_in_flight = 64;    // Requests per core
+  std::size_t inbox_capacity = 4096; // Posted jobs per core
+};
+
+// Counters of one core, written by its worker only.
+struct CoreCounters {
+  uint64_t jobs = 0;
+  uint64_t requests = 0;
+  uint64_t replies = 0;
+  uint64_t failed = 0; // Replies whose packet status is not TB_PACKET_OK
+};
+
+// A request owned by one core, recycled through its pool. Payload and reply
+// keep their capacity, so a warmed-up core does not allocate.
+struct CoreRequest : Request {
+  // Copies `events` into the payload and points the packet at it.
+  template <std::ranges::contiguous_range Events>
+  void assign(TB_OPERATION operation, const Events &events) {
+    auto bytes = std::as_bytes(std::span(events));
+    payload.resize(bytes.size());
+    std::memcpy(payload.data(), bytes.data(), bytes.size());
+    packet = tb_packet_t{};
+    packet.operation = operation;
+    packet.data = payload.data();
+    packet.data_size = static_cast<uint32_t>(payload.size());
+  }
+
+  std::vector<uint8_t> payload;
+  std::vector<uint8_t> reply;
+  uint64_t user_tag = 0;
+
+private:
+  template <typename> friend class CoreExecutor;
+  SpscRing<CoreRequest *> *completed = nullptr;
+};
+
+// Thread-per-core, shared-nothing execution. Each core is a worker thread
+// pinned to one CPU that owns a Client (and so its IO thread), a pool of
+// requests with their payload and reply buffers, and its counters, all
+// allocated on that core. Work reaches a core through its inbox ring and
+// replies come back through its completion ring; nothing else is shared
+// between cores, nor locked.
+//
+// Jobs run `on_job` on their core, which usually fills and submits requests;
+// replies run `on_reply` on the same core, after which the request goes back
+// to the pool. A core busy-polls its rings, then yields, then naps when
+// idle.
+template <typename Job> class CoreExecutor {
+public:
+  class Core;
+  using JobHandler = std::function<void(Core &core, Job &job)>;
+  using ReplyHandler = std::function<void(Core &core, CoreRequest &request)>;
+
+  class alignas(CACHE_LINE_SIZE) Core {
+  public:
+    std::size_t index() const { return core_index; }
+    Client &client() { return *tb_client; }
+
+    // A free request of this core, nullptr while max_in_flight are out.
+    CoreRequest *acquire() {
+      if (free.empty()) {
+        return nullptr;
+      }
+      auto *request = free.back();
+      free.pop_back();
+      request->user_tag = 0;
+      return request;
+    }
+
+    // Back to the pool without sending it.
+    void release(CoreRequest &request) { free.push_back(&request); }
+
+    // Sends an acquired request; its reply comes back to on_reply on this
+    // core. False when the client refused it: the request stays with the
+    // caller, its packet status says why.
+    bool submit(CoreRequest &request) {
+      request.on_reply = &on_completed;
+      request.completed = &completions;
+      if (tb_client->submit(request) != TB_CLIENT_STATUS::TB_CLIENT_OK) {
+        return false;
+      }
+      ++in_flight_count;
+      bump(counters.requests);
+      return true;
+    }
+
+    std::size_t in_flight() const { return in_flight_count; }
+
+  private:
+    friend class CoreExecutor;
+
+    struct Counters {
+      std::atomic<uint64_t> jobs{0};
+      std::atomic<uint64_t> requests{0};
+      std::atomic<uint64_t> replies{0};
+      std::atomic<uint64_t> failed{0};
+    };
+
+    Core(std::size_t index, const CoreOptions &options, JobHandler job,
+         ReplyHandler reply)
+        : core_index(index), inbox(options.inbox_capacity),
+          completions(std::max<std::size_t>(options.max_in_flight, 1)),
+          requests(std::max<std::size_t>(options.max_in_flight, 1)),
+          on_job(std::move(job)), on_reply(std::move(reply)) {
+      free.reserve(requests.size());
+      for (auto &request : requests) {
+        free.push_back(&request);
+      }
+    }
+
+    // Single writer: a plain load and store, no locked instruction.
+    static void bump(std::atomic<uint64_t> &counter) {
+      counter.store(counter.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+    }
+
+    // On the IO thread of this core's client, its only producer.
+    static void on_completed(Request *request, uint64_t, const uint8_t *data,
+                             uint32_t size) {
+      auto &owned = static_cast<CoreRequest &>(*request);
+      owned.reply.assign(data, data + size);
+      // Never full: the ring holds every request of the core.
+      owned.completed->try_push(&owned);
+    }
+
+    // One pass over both rings, true if anything was done.
+    bool poll() {
+      bool progressed = false;
+      for (CoreRequest *request; completions.try_pop(request);) {
+        --in_flight_count;
+        bump(counters.replies);
+        if (request->packet.status != TB_PACKET_OK) {
+          bump(counters.failed);
+        }
+        on_reply(*this, *request);
+        free.push_back(request);
+        progressed = true;
+      }
+      for (Job job; !free.empty() && inbox.try_pop(job);) {
+        bump(counters.jobs);
+        on_job(*this, job);
+        progressed = true;
+      }
+      return progressed;
+    }
+
+    const std::size_t core_index;
+    std::optional<Client> tb_client;
+    TB_INIT_STATUS init_status = TB_INIT_UNEXPECTED;
+    SpscRing<Job> inbox;
+    SpscRing<CoreRequest *> completions;
+    std::vector<CoreRequest> requests;
+    std::vector<CoreRequest *> free;
+    std::size_t in_flight_count = 0;
+    JobHandler on_job;
+    ReplyHandler on_reply;
+    Counters counters;
+  };
+
+  CoreExecutor(std::string_view address, JobHandler on_job,
+               ReplyHandler on_reply, CoreOptions options = {},
+               std::array<uint8_t, 16> cluster_id = {})
+      : CoreExecutor(false, address, std::move(on_job), std::move(on_reply),
+                     std::move(options), cluster_id) {}
+
+  CoreExecutor(echo_t, std::string_view address, JobHandler on_job,
+               ReplyHandler on_reply, CoreOptions options = {},
+               std::array<uint8_t, 16> cluster_id = {})
+      : CoreExecutor(true, address, std::move(on_job), std::move(on_reply),
+                     std::move(options), cluster_id) {}
+
+  CoreExecutor(const CoreExecutor &) = delete;
+  CoreExecutor &operator=(const CoreExecutor &) = delete;
+
+  ~CoreExecutor() { stop(); }
+
+  std::size_t size() const { return cores.size(); }
+
+  // Every core's client initialized.
+  bool ok() const {
+    return std::all_of(cores.begin(), cores.end(), [](const auto &core) {
+      return core->init_status == TB_INIT_SUCCESS;
+    });
+  }
+
+  // Queues a job on a core; false when its inbox is full. Each core's inbox
+  // takes jobs from one thread at a time.
+  bool post(std::size_t core, Job job) {
+    return cores[core]->inbox.try_push(std::move(job));
+  }
+
+  CoreCounters metrics(std::size_t core) const {
+    const auto &counters = cores[core]->counters;
+    return {counters.jobs.load(std::memory_order_relaxed),
+            counters.requests.load(std::memory_order_relaxed),
+            counters.replies.load(std::memory_order_relaxed),
+            counters.failed.load(std::memory_order_relaxed)};
+  }
+
+  // Runs the jobs already posted and waits for their replies, then stops
+  // the cores. Nothing may be posted meanwhile.
+  void stop() {
+    stopping.store(true, std::memory_order_release);
+    workers.clear(); // Joins
+  }
+
+private:
+  CoreExecutor(bool echo, std::string_view address, JobHandler on_job,
+               ReplyHandler on_reply, CoreOptions options,
+               std::array<uint8_t, 16> cluster_id) {
+    auto cpus = options.cpus;
+    if (cpus.empty()) {
+      cpus.assign(std::max(1u, std::thread::hardware_concurrency()), -1);
+    }
+    cores.resize(cpus.size());
+    std::latch started(static_cast<std::ptrdiff_t>(cpus.size()));
+    for (std::size_t i = 0; i < cpus.size(); ++i) {
+      const int io_cpu = i < options.io_cpus.size() ? options.io_cpus[i]
+                                                     : cpus[i];
+      workers.emplace_back([&, i, cpu = cpus[i], io_cpu] {
+        run(i, cpu, io_cpu, echo, address, options, on_job, on_reply,
+            cluster_id, started);
+      });
+    }
+    started.wait();
+  }
+
+  void run(std::size_t index, int cpu, int io_cpu, bool echo,
+           std::string_view address, const CoreOptions &options,
+           const JobHandler &on_job, const ReplyHandler &on_reply,
+           std::array<uint8_t, 16> cluster_id, std::latch &started) {
+    CpuAffinity pin(cpu >= 0 ? std::vector<int>{cpu} : std::vector<int>{});
+    // Allocated here, so that it lands on this core's NUMA node.
+    auto core = std::unique_ptr<Core>(
+        new Core(index, options, on_job, on_reply));
+    {
+      // The IO thread inherits the mask of the thread creating it.
+      CpuAffinity io(io_cpu >= 0 && io_cpu != cpu ? std::vector<int>{io_cpu}
+                                                  : std::vector<int>{});
+      if (echo) {
+        core->tb_client.emplace(echo_client, address, cluster_id);
+      } else {
+        core->tb_client.emplace(address, cluster_id);
+      }
+      core->init_status = core->tb_client->initStatus();
+    }
+    auto &self = *core;
+    cores[index] = std::move(core);
+    started.count_down();
+    // Constructor arguments are gone from here on.
+
+    for (unsigned idle = 0;;) {
+      if (self.poll()) {
+        idle = 0;
+        continue;
+      }
+      if (stopping.load(std::memory_order_acquire) &&
+          self.in_flight_count == 0 && self.inbox.empty()) {
+        break;
+      }
+      if (++idle < 64) {
+        continue;
+      }
+      if (idle < 1024) {
+        std::this_thread::yield();
+      } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+      }
+    }
+    self.tb_client.reset();
+  }
+
+  std::vector<std::unique_ptr<Core>> cores;
+  std::atomic<bool> stopping{false};
+  std::vector<std::jthread> workers; // Last: joined before the cores go
+};
+
+} // namespace tigerbeetle
+#endif // TB_PERCORE_HPP
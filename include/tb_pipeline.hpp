@@ -0,0 +1,253 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+#ifndef TB_PIPELINE_HPP
+#define TB_PIPELINE_HPP
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <initializer_list>
+#include <ranges>
+#include <stdexcept>
+#include <vector>
+
+#include "tb_client.hpp"
+
+namespace tigerbeetle {
+
+enum class StageStatus : uint8_t {
+  waiting,   // Prerequisites still running
+  submitted, // In flight
+  succeeded,
+  failed,  // Packet error, or a create_* reply that reported failed events
+  skipped, // A prerequisite did not succeed
+};
+
+// A small DAG of operations. Stages without prerequisites are submitted
+// together by start(); every other stage is submitted from the completion of
+// its last prerequisite, so no thread waits between steps. A flow runs once
+// and must outlive its execution.
+class Flow {
+public:
+  using StageId = std::size_t;
+  // Fills the payload of a stage right before it is submitted, usually from
+  // the replies of its prerequisites. Runs on the thread that releases it.
+  using Prepare = std::function<void(Flow &flow, StageId stage)>;
+
+  Flow() = default;
+  Flow(const Flow &) = delete;
+  Flow &operator=(const Flow &) = delete;
+
+  template <std::ranges::contiguous_range Events>
+  StageId add(TB_OPERATION operation, const Events &events,
+              std::initializer_list<StageId> after = {}) {
+    auto id = add(operation, Prepare{}, after);
+    set_payload(id, events);
+    return id;
+  }
+
+  // Prerequisites must be stages that were already added, which keeps the
+  // graph acyclic.
+  StageId add(TB_OPERATION operation, Prepare prepare,
+              std::initializer_list<StageId> after = {}) {
+    const auto id = stages.size();
+    for (auto dep : after) {
+      if (dep >= id) {
+        throw std::out_of_range("Flow stage depends on an unknown stage");
+      }
+    }
+    auto stage = std::make_unique<Stage>();
+    stage->flow = this;
+    stage->id = id;
+    stage->operation = operation;
+    stage->prepare = std::move(prepare);
+    stage->prerequisites = after.size();
+    stages.push_back(std::move(stage));
+    for (auto dep : after) {
+      stages[dep]->dependents.push_back(id);
+    }
+    return id;
+  }
+
+  template <std::ranges::contiguous_range Events>
+  void set_payload(StageId stage, const Events &events) {
+    auto bytes = std::as_bytes(std::span(events));
+    auto &payload = stages.at(stage)->payload;
+    payload.resize(bytes.size());
+    std::memcpy(payload.data(), bytes.data(), bytes.size());
+  }
+
+  template <typename T> std::span<const T> reply(StageId stage) const {
+    const auto &bytes = stages.at(stage)->reply;
+    return {reinterpret_cast<const T *>(bytes.data()),
+            bytes.size() / sizeof(T)};
+  }
+
+  StageStatus status(StageId stage) const {
+    return stages.at(stage)->state.load(std::memory_order_acquire);
+  }
+  uint8_t packet_status(StageId stage) const {
+    return stages.at(stage)->packet_status;
+  }
+  std::size_t size() const { return stages.size(); }
+
+  // Called once every stage has settled, on the thread that settled the
+  // last one. Set it before start().
+  void on_done(std::function<void(Flow &)> fn) { done_fn = std::move(fn); }
+
+  // Submits the stages that have no prerequisites. Returns false if the
+  // flow is empty or was already started.
+  bool start(Client &tb_client) {
+    if (stages.empty() || started) {
+      return false;
+    }
+    started = true;
+    client = &tb_client;
+    remaining.store(stages.size(), std::memory_order_relaxed);
+    std::vector<Stage *> roots;
+    for (auto &stage : stages) {
+      stage->waiting.store(stage->prerequisites, std::memory_order_relaxed);
+      if (stage->prerequisites == 0) {
+        roots.push_back(stage.get());
+      }
+    }
+    // The flow may be finished (and released by its owner) as soon as the
+    // last root is launched, so only locals are touched from here on.
+    for (auto *root : roots) {
+      launch(*root);
+    }
+    return true;
+  }
+
+  void wait() {
+    std::unique_lock lock(mutex);
+    cv.wait(lock, [this] { return finished; });
+  }
+
+  template <typename Rep, typename Period>
+  bool wait_for(std::chrono::duration<Rep, Period> timeout) {
+    std::unique_lock lock(mutex);
+    return cv.wait_for(lock, timeout, [this] { return finished; });
+  }
+
+  bool done() const {
+    std::lock_guard lock(mutex);
+    return finished;
+  }
+
+  // Whether every stage succeeded. Only meaningful once done.
+  bool succeeded() const {
+    for (const auto &stage : stages) {
+      if (stage->state.load(std::memory_order_acquire) !=
+          StageStatus::succeeded) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+private:
+  struct Stage : Request {
+    Flow *flow = nullptr;
+    StageId id = 0;
+    TB_OPERATION operation{};
+    Prepare prepare;
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> reply;
+    std::vector<StageId> dependents;
+    std::size_t prerequisites = 0;
+    std::atomic<std::size_t> waiting{0};
+    std::atomic<bool> poisoned{false};
+    std::atomic<StageStatus> state{StageStatus::waiting};
+    uint8_t packet_status = TB_PACKET_OK;
+  };
+
+  static void on_stage_reply(Request *request, [[maybe_unused]] uint64_t ts,
+                             const uint8_t *data, uint32_t size) {
+    auto *stage = static_cast<Stage *>(request);
+    stage->packet_status = request->packet.status;
+    stage->reply.assign(data, data + size);
+    // create_* replies only list the events that failed.
+    const bool creates =
+        stage->operation == TB_OPERATION_CREATE_ACCOUNTS ||
+        stage->operation == TB_OPERATION_CREATE_TRANSFERS;
+    const bool ok =
+        stage->packet_status == TB_PACKET_OK && !(creates && size != 0);
+    stage->flow->settle(*stage,
+                        ok ? StageStatus::succeeded : StageStatus::failed);
+  }
+
+  void launch(Stage &stage) {
+    if (stage.poisoned.load(std::memory_order_acquire)) {
+      settle(stage, StageStatus::skipped);
+      return;
+    }
+    if (stage.prepare) {
+      stage.prepare(*this, stage.id);
+    }
+    stage.packet = tb_packet_t{};
+    stage.packet.operation = stage.operation;
+    stage.packet.data = stage.payload.data();
+    stage.packet.data_size = static_cast<uint32_t>(stage.payload.size());
+    stage.on_reply = &Flow::on_stage_reply;
+    stage.state.store(StageStatus::submitted, std::memory_order_release);
+    if (client->submit(stage) != TB_CLIENT_STATUS::TB_CLIENT_OK) {
+      // Keep why it was refused (admission control, drain), if known.
+      stage.packet_status = stage.packet.status != TB_PACKET_OK
+                                ? stage.packet.status
+                                : uint8_t{TB_PACKET_CLIENT_SHUTDOWN};
+      settle(stage, StageStatus::failed);
+    }
+  }
+
+  void settle(Stage &stage, StageStatus result) {
+    stage.state.store(result, std::memory_order_release);
+    for (auto id : stage.dependents) {
+      auto &next = *stages[id];
+      if (result != StageStatus::succeeded) {
+        next.poisoned.store(true, std::memory_order_release);
+      }
+      if (next.waiting.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        launch(next);
+      }
+    }
+    if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      if (done_fn) {
+        done_fn(*this);
+      }
+      // Notify under the lock: a waiter may destroy the flow right after.
+      std::lock_guard lock(mutex);
+      finished = true;
+      cv.notify_all();
+    }
+  }
+
+  std::vector<std::unique_ptr<Stage>> stages;
+  Client *client = nullptr;
+  bool started = false;
+  std::atomic<std::size_t> remaining{0};
+  std::function<void(Flow &)> done_fn;
+
+  mutable std::mutex mutex;
+  std::condition_variable cv;
+  bool finished = false;
+};
+
+} // namespace tigerbeetle
+#endif // TB_PIPELINE_HPP
@@ -0,0 +1,339 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+#ifndef TB_QUERY_HPP
+#define TB_QUERY_HPP
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include "tb_client.hpp"
+
+namespace tigerbeetle {
+
+template <typename T>
+concept tb_query_record =
+    std::same_as<T, tb_account_t> || std::same_as<T, tb_transfer_t>;
+
+struct ParallelQueryOptions {
+  std::size_t shards = 8; // Timestamp sub-ranges, queried concurrently
+  std::size_t window = 2; // Pages a shard may fetch ahead of the reader
+  uint32_t page_limit = 0; // Records per request, 0 (or more) for a full reply
+};
+
+// Splits the timestamp range of `filter` into at most `shards` contiguous
+// sub-filters, in ascending timestamp order. The first and last keep the
+// filter's own bounds, so an open bound (0) stays open; an open upper bound
+// is split as if it were the current time and an open lower bound from 0,
+// which for real timestamps (nanoseconds since the epoch) leaves nearly all
+// the records to one shard: narrow open bounds first, as ParallelQuery does.
+inline std::vector<tb_query_filter_t>
+split_by_timestamp(const tb_query_filter_t &filter, std::size_t shards) {
+  const uint64_t lo = filter.timestamp_min;
+  uint64_t hi = filter.timestamp_max;
+  if (hi == 0) {
+    hi = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count());
+  }
+  if (shards <= 1 || hi <= lo) {
+    return {filter};
+  }
+  const auto total = static_cast<tb_uint128_t>(hi - lo) + 1;
+  const auto count = static_cast<std::size_t>(
+      std::min<tb_uint128_t>(total, shards));
+  std::vector<tb_query_filter_t> parts(count, filter);
+  for (std::size_t i = 1; i < count; ++i) {
+    parts[i].timestamp_min = lo + static_cast<uint64_t>(total * i / count);
+    parts[i - 1].timestamp_max = parts[i].timestamp_min - 1;
+  }
+  return parts;
+}
+
+// query_accounts / query_transfers over a timestamp range, split into
+// sub-ranges that are queried concurrently and paged independently. The
+// sub-ranges are disjoint and ordered, so their pages come out as one stream
+// in timestamp order (descending with TB_QUERY_FILTER_REVERSED) without a
+// merge: next() reads the shards one after the other while the following
+// ones fetch ahead, at most `window` pages each.
+//
+// An open bound (0) is first narrowed to the timestamp of the first (or
+// last) matching record, with a one-record query through the first client,
+// so that the shards split the range that actually holds data. Records
+// created after that are not read.
+//
+// filter.limit caps the whole stream, 0 for no cap. The sub-ranges use the
+// clients round-robin; a client sends one request at a time to the cluster,
+// so it takes several clients for the cluster to serve shards in parallel.
+// The clients must outlive the query; next() belongs to one thread.
+template <tb_query_record T> class ParallelQuery {
+public:
+  ParallelQuery(std::span<Client *const> clients,
+                const tb_query_filter_t &filter,
+                const ParallelQueryOptions &options = {})
+      : limit(filter.limit), window(std::max<std::size_t>(options.window, 1)),
+        reversed((filter.flags & TB_QUERY_FILTER_REVERSED) != 0) {
+    start(clients, filter, options);
+  }
+
+  ParallelQuery(Client &client, const tb_query_filter_t &filter,
+                const ParallelQueryOptions &options = {})
+      : limit(filter.limit), window(std::max<std::size_t>(options.window, 1)),
+        reversed((filter.flags & TB_QUERY_FILTER_REVERSED) != 0) {
+    Client *const only = &client;
+    start(std::span(&only, 1), filter, options);
+  }
+
+  ParallelQuery(const ParallelQuery &) = delete;
+  ParallelQuery &operator=(const ParallelQuery &) = delete;
+
+  // Waits for the requests still in flight.
+  ~ParallelQuery() {
+    std::unique_lock lock(mutex);
+    stopped = true;
+    cv.wait(lock, [this] {
+      return std::none_of(shards.begin(), shards.end(),
+                          [](const Shard &s) { return s.in_flight; });
+    });
+  }
+
+  // Next page of the stream, empty at the end or after a failed request.
+  // Valid until the following call.
+  std::span<const T> next() {
+    if (limit != 0 && delivered >= limit) {
+      return {};
+    }
+    std::unique_lock lock(mutex);
+    while (reading < shards.size()) {
+      auto &shard = shards[reversed ? shards.size() - 1 - reading : reading];
+      cv.wait(lock, [&] { return !shard.pages.empty() || !shard.in_flight; });
+      if (!shard.pages.empty()) {
+        current = std::move(shard.pages.front());
+        shard.pages.pop_front();
+        const bool resume = !shard.in_flight && !shard.done;
+        shard.in_flight = shard.in_flight || resume;
+        lock.unlock();
+        if (resume) {
+          fetch(shard);
+        }
+        std::span<const T> page(current);
+        if (limit != 0) {
+          page = page.first(std::min<std::size_t>(page.size(),
+                                                  limit - delivered));
+        }
+        delivered += page.size();
+        if (!page.empty()) {
+          return page;
+        }
+        lock.lock();
+      } else if (shard.status != TB_PACKET_OK) {
+        return {}; // The rest of the stream would have a gap
+      } else if (shard.done) {
+        ++reading;
+      }
+    }
+    return {};
+  }
+
+  // Calls `fn` with each record in stream order, returns how many.
+  template <typename F> std::size_t for_each(F &&fn) {
+    std::size_t count = 0;
+    for (auto page = next(); !page.empty(); page = next()) {
+      for (const auto &record : page) {
+        fn(record);
+      }
+      count += page.size();
+    }
+    return count;
+  }
+
+  // First failed request, TB_PACKET_OK if none so far.
+  uint8_t packet_status() const {
+    std::lock_guard lock(mutex);
+    for (const auto &shard : shards) {
+      if (shard.status != TB_PACKET_OK) {
+        return shard.status;
+      }
+    }
+    return TB_PACKET_OK;
+  }
+  bool ok() const { return packet_status() == TB_PACKET_OK; }
+
+  std::size_t shard_count() const { return shards.size(); }
+
+private:
+  void start(std::span<Client *const> clients, const tb_query_filter_t &filter,
+             const ParallelQueryOptions &options) {
+    // A reply holds at most one message, and a shorter page than asked for
+    // ends its shard: never ask for more.
+    constexpr auto full = static_cast<uint32_t>(MAX_MESSAGE_SIZE / sizeof(T));
+    const auto page =
+        options.page_limit != 0 ? std::min(options.page_limit, full) : full;
+    auto bounded = filter;
+    const bool open =
+        filter.timestamp_min == 0 || filter.timestamp_max == 0;
+    // Nothing to split when nothing matches or a probe failed: one shard
+    // with the filter as given finds out.
+    const auto parts =
+        options.shards > 1 && open && !narrow(*clients[0], bounded)
+            ? std::vector<tb_query_filter_t>{filter}
+            : split_by_timestamp(bounded, options.shards);
+    for (std::size_t i = 0; i < parts.size(); ++i) {
+      auto &shard = shards.emplace_back();
+      shard.query = this;
+      shard.client = clients[i % clients.size()];
+      shard.filter = parts[i];
+      shard.filter.limit = limit != 0 ? std::min(page, limit) : page;
+    }
+    for (auto &shard : shards) {
+      shard.in_flight = true;
+      fetch(shard);
+    }
+  }
+
+  // Replaces the open timestamp bounds of `filter` with those of the first
+  // and last matching records. False if none matches or a probe failed.
+  static bool narrow(Client &client, tb_query_filter_t &filter) {
+    auto ctx = std::make_unique<CompletionContext>();
+    auto edge = [&](bool last, uint64_t &timestamp) {
+      auto probe = filter;
+      probe.limit = 1;
+      probe.flags = last ? probe.flags | TB_QUERY_FILTER_REVERSED
+                         : probe.flags & ~uint32_t{TB_QUERY_FILTER_REVERSED};
+      tb_packet_t packet{};
+      packet.operation = std::same_as<T, tb_account_t>
+                             ? TB_OPERATION_QUERY_ACCOUNTS
+                             : TB_OPERATION_QUERY_TRANSFERS;
+      packet.data = &probe;
+      packet.data_size = sizeof(probe);
+      packet.user_data = ctx.get();
+      client.send_request(packet, ctx.get(), Deadline::max());
+      if (packet.status != TB_PACKET_OK ||
+          ctx->size < static_cast<int>(sizeof(T))) {
+        return false;
+      }
+      T record;
+      std::memcpy(&record, ctx->reply.data(), sizeof(T));
+      timestamp = record.timestamp;
+      return true;
+    };
+    return (filter.timestamp_min != 0 || edge(false, filter.timestamp_min)) &&
+           (filter.timestamp_max != 0 || edge(true, filter.timestamp_max));
+  }
+
+  // One sub-range; the request carries the filter of its next page.
+  struct Shard : Request {
+    ParallelQuery *query = nullptr;
+    Client *client = nullptr;
+    tb_query_filter_t filter{};
+    std::deque<std::vector<T>> pages; // Fetched, not read yet
+    std::size_t fetched = 0;
+    uint8_t status = TB_PACKET_OK;
+    bool in_flight = false;
+    bool done = false;
+  };
+
+  // Sends the next page request of a shard marked in flight.
+  void fetch(Shard &shard) {
+    shard.packet = {};
+    shard.packet.operation = std::same_as<T, tb_account_t>
+                                 ? TB_OPERATION_QUERY_ACCOUNTS
+                                 : TB_OPERATION_QUERY_TRANSFERS;
+    shard.packet.data = &shard.filter;
+    shard.packet.data_size = sizeof(shard.filter);
+    shard.on_reply = &on_page;
+    if (shard.client->submit(shard) != TB_CLIENT_STATUS::TB_CLIENT_OK) {
+      // Refused without a completion.
+      std::lock_guard lock(mutex);
+      shard.status = shard.packet.status != TB_PACKET_OK
+                         ? shard.packet.status
+                         : static_cast<uint8_t>(TB_PACKET_CLIENT_SHUTDOWN);
+      shard.done = true;
+      shard.in_flight = false;
+      cv.notify_all();
+    }
+  }
+
+  static void on_page(Request *request, [[maybe_unused]] uint64_t timestamp,
+                      const uint8_t *data, uint32_t size) {
+    auto &shard = *static_cast<Shard *>(request);
+    auto &self = *shard.query;
+    bool resume = false;
+    {
+      std::lock_guard lock(self.mutex);
+      if (shard.packet.status != TB_PACKET_OK) {
+        shard.status = shard.packet.status;
+        shard.done = true;
+      } else {
+        const auto count = size / sizeof(T);
+        std::vector<T> page(count);
+        if (count != 0) {
+          std::memcpy(page.data(), data, count * sizeof(T));
+        }
+        shard.fetched += count;
+        // A short page is the last one of its sub-range.
+        shard.done = count < shard.filter.limit ||
+                     (self.limit != 0 && shard.fetched >= self.limit);
+        if (!shard.done) {
+          const auto last = page.back().timestamp;
+          if (self.reversed) {
+            shard.filter.timestamp_max = last - 1;
+          } else {
+            shard.filter.timestamp_min = last + 1;
+          }
+        }
+        if (count != 0) {
+          shard.pages.push_back(std::move(page));
+        }
+      }
+      resume = !shard.done && !self.stopped &&
+               shard.pages.size() < self.window;
+      shard.in_flight = resume;
+      // Under the lock: the destructor may return as soon as it sees the
+      // last shard settle.
+      self.cv.notify_all();
+    }
+    if (resume) {
+      self.fetch(shard);
+    }
+  }
+
+  const uint32_t limit;
+  const std::size_t window;
+  const bool reversed;
+  std::deque<Shard> shards;
+  std::vector<T> current; // Page handed out by next()
+  std::size_t reading = 0;
+  std::size_t delivered = 0;
+
+  mutable std::mutex mutex; // Guards the shards' pages and flags
+  std::condition_variable cv;
+  bool stopped = false;
+};
+
+} // namespace tigerbeetle
+#endif // TB_QUERY_HPP
@@ -0,0 +1,320 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+#ifndef TB_RECONCILE_HPP
+#define TB_RECONCILE_HPP
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <ranges>
+#include <thread>
+#include <vector>
+
+#include "tb_client.hpp"
+
+namespace tigerbeetle {
+
+// One account of an external ledger snapshot, as the balances it should
+// have in the cluster.
+struct ExpectedBalance {
+  tb_uint128_t id = 0;
+  tb_uint128_t debits_pending = 0;
+  tb_uint128_t debits_posted = 0;
+  tb_uint128_t credits_pending = 0;
+  tb_uint128_t credits_posted = 0;
+};
+
+enum class MismatchKind : uint8_t {
+  missing, // No such account in the cluster
+  balance, // At least one of the four balances differs
+  failed,  // The lookup itself failed, see packet_status
+};
+
+struct Mismatch {
+  MismatchKind kind;
+  ExpectedBalance expected;
+  tb_account_t actual{}; // Only set for MismatchKind::balance
+  uint8_t packet_status = TB_PACKET_OK;
+};
+
+struct ReconcileOptions {
+  // Ids per lookup_accounts request, capped so that the reply fits.
+  std::size_t batch = MAX_MESSAGE_SIZE / sizeof(tb_account_t);
+  std::size_t in_flight = 16; // Lookups submitted at once
+  unsigned threads = 0;       // Comparison threads, 0: one per hardware thread
+};
+
+struct ReconcileReport {
+  std::size_t checked = 0;
+  std::size_t matched = 0;
+  std::size_t missing = 0;
+  std::size_t mismatched = 0; // MismatchKind::balance
+  std::size_t failed = 0;     // Ids whose lookup failed
+  std::size_t lookups = 0;
+  std::chrono::nanoseconds elapsed{};
+
+  bool ok() const { return matched == checked; }
+};
+
+inline bool balances_equal(const ExpectedBalance &expected,
+                           const tb_account_t &actual) {
+  return expected.debits_pending == actual.debits_pending &&
+         expected.debits_posted == actual.debits_posted &&
+         expected.credits_pending == actual.credits_pending &&
+         expected.credits_posted == actual.credits_posted;
+}
+
+// Compares the ids of one lookup_accounts request with its reply. The reply
+// only holds the accounts that exist, in request order, so both sides are
+// walked once. Calls `sink` for every mismatch and returns the number of
+// matching accounts.
+template <typename Sink>
+std::size_t compare_lookup(std::span<const ExpectedBalance> expected,
+                           std::span<const tb_account_t> reply, Sink &&sink) {
+  std::size_t matched = 0;
+  std::size_t next = 0;
+  for (const auto &e : expected) {
+    if (next < reply.size() && reply[next].id == e.id) {
+      const auto &actual = reply[next++];
+      if (balances_equal(e, actual)) {
+        ++matched;
+      } else {
+        sink(Mismatch{MismatchKind::balance, e, actual});
+      }
+    } else {
+      sink(Mismatch{MismatchKind::missing, e});
+    }
+  }
+  return matched;
+}
+
+// Checks a stream of expected balances against the cluster. The snapshot is
+// read once, in batches of `batch` ids that are looked up with up to
+// `in_flight` requests outstanding; replies are compared on a pool of
+// threads while further lookups are in flight, so memory stays bounded by
+// in_flight * batch records whatever the size of either side. Accounts that
+// exist only in the cluster are not reported.
+class Reconciler {
+public:
+  // Called for every mismatch, from the comparison threads but never
+  // concurrently, in no particular order.
+  using Sink = std::function<void(const Mismatch &)>;
+
+  explicit Reconciler(Client &tb_client, ReconcileOptions settings = {})
+      : client(tb_client), options(normalized(settings)) {}
+
+  Reconciler(const Reconciler &) = delete;
+  Reconciler &operator=(const Reconciler &) = delete;
+
+  // Blocks until every entry of `snapshot` has been checked. Not reentrant;
+  // iterating the snapshot must not throw.
+  template <std::ranges::input_range Snapshot>
+    requires std::convertible_to<std::ranges::range_reference_t<Snapshot>,
+                                 const ExpectedBalance &>
+  ReconcileReport run(Snapshot &&snapshot, Sink sink) {
+    const auto started = std::chrono::steady_clock::now();
+    report = {};
+    on_mismatch = std::move(sink);
+    slots.clear();
+    free_slots.clear();
+    for (std::size_t i = 0; i < options.in_flight; ++i) {
+      slots.push_back(std::make_unique<Slot>(*this, options.batch));
+      free_slots.push_back(slots.back().get());
+    }
+    {
+      std::vector<std::jthread> workers;
+      for (unsigned i = 0; i < options.threads; ++i) {
+        workers.emplace_back([this](std::stop_token stop) { compare(stop); });
+      }
+      Slot *slot = nullptr;
+      for (const ExpectedBalance &entry : snapshot) {
+        if (slot == nullptr) {
+          slot = take_free();
+        }
+        slot->expected.push_back(entry);
+        slot->ids.push_back(entry.id);
+        if (slot->ids.size() == options.batch) {
+          lookup(*slot);
+          slot = nullptr;
+        }
+      }
+      if (slot != nullptr) {
+        lookup(*slot);
+      }
+      std::unique_lock lock(mutex);
+      slot_free.wait(lock,
+                     [this] { return free_slots.size() == slots.size(); });
+      for (auto &worker : workers) {
+        worker.request_stop();
+      }
+      reply_ready.notify_all();
+    }
+    report.elapsed = std::chrono::steady_clock::now() - started;
+    return report;
+  }
+
+private:
+  static ReconcileOptions normalized(ReconcileOptions settings) {
+    settings.batch = std::clamp<std::size_t>(
+        settings.batch, 1, MAX_MESSAGE_SIZE / sizeof(tb_account_t));
+    settings.in_flight = std::max<std::size_t>(settings.in_flight, 1);
+    if (settings.threads == 0) {
+      settings.threads = std::thread::hardware_concurrency();
+    }
+    settings.threads = std::clamp<unsigned>(
+        settings.threads, 1, static_cast<unsigned>(settings.in_flight));
+    return settings;
+  }
+
+  struct Slot : Request {
+    Slot(Reconciler &reconciler, std::size_t batch) : owner(&reconciler) {
+      expected.reserve(batch);
+      ids.reserve(batch);
+      reply.reserve(batch * sizeof(tb_account_t));
+    }
+
+    Reconciler *owner;
+    std::vector<ExpectedBalance> expected;
+    std::vector<tb_uint128_t> ids;
+    std::vector<uint8_t> reply;
+    uint8_t packet_status = TB_PACKET_OK;
+  };
+
+  Slot *take_free() {
+    std::unique_lock lock(mutex);
+    slot_free.wait(lock, [this] { return !free_slots.empty(); });
+    auto *slot = free_slots.back();
+    free_slots.pop_back();
+    return slot;
+  }
+
+  void lookup(Slot &slot) {
+    slot.packet = tb_packet_t{};
+    slot.packet.operation = TB_OPERATION_LOOKUP_ACCOUNTS;
+    slot.packet.data = slot.ids.data();
+    slot.packet.data_size =
+        static_cast<uint32_t>(slot.ids.size() * sizeof(tb_uint128_t));
+    slot.on_reply = &Reconciler::on_lookup_reply;
+    if (client.submit(slot) != TB_CLIENT_STATUS::TB_CLIENT_OK) {
+      slot.packet_status = slot.packet.status;
+      if (slot.packet_status == TB_PACKET_OK) {
+        slot.packet_status = TB_PACKET_CLIENT_SHUTDOWN;
+      }
+      slot.reply.clear();
+      push_ready(slot);
+    }
+  }
+
+  // Runs on the tb_client IO thread: keep the reply and hand it over.
+  static void on_lookup_reply(Request *request, [[maybe_unused]] uint64_t ts,
+                              const uint8_t *data, uint32_t size) {
+    auto *slot = static_cast<Slot *>(request);
+    slot->packet_status = request->packet.status;
+    slot->reply.assign(data, data + size);
+    slot->owner->push_ready(*slot);
+  }
+
+  void push_ready(Slot &slot) {
+    // Notify under the lock: run() may return as soon as the slot is back.
+    std::lock_guard lock(mutex);
+    ready.push_back(&slot);
+    reply_ready.notify_one();
+  }
+
+  void compare(std::stop_token stop) {
+    std::vector<Mismatch> found;
+    for (;;) {
+      Slot *slot = nullptr;
+      {
+        std::unique_lock lock(mutex);
+        reply_ready.wait(lock, [&] {
+          return !ready.empty() || stop.stop_requested();
+        });
+        if (ready.empty()) {
+          return;
+        }
+        slot = ready.front();
+        ready.pop_front();
+      }
+
+      found.clear();
+      std::size_t matched = 0;
+      auto collect = [&found](const Mismatch &m) { found.push_back(m); };
+      if (slot->packet_status == TB_PACKET_OK) {
+        const std::span<const tb_account_t> accounts(
+            reinterpret_cast<const tb_account_t *>(slot->reply.data()),
+            slot->reply.size() / sizeof(tb_account_t));
+        matched = compare_lookup(slot->expected, accounts, collect);
+      } else {
+        for (const auto &e : slot->expected) {
+          collect(Mismatch{MismatchKind::failed, e, {}, slot->packet_status});
+        }
+      }
+
+      {
+        std::lock_guard lock(sink_mutex);
+        report.checked += slot->expected.size();
+        report.matched += matched;
+        report.lookups += 1;
+        for (const auto &m : found) {
+          switch (m.kind) {
+          case MismatchKind::missing:
+            ++report.missing;
+            break;
+          case MismatchKind::balance:
+            ++report.mismatched;
+            break;
+          case MismatchKind::failed:
+            ++report.failed;
+            break;
+          }
+          if (on_mismatch) {
+            on_mismatch(m);
+          }
+        }
+      }
+      slot->expected.clear();
+      slot->ids.clear();
+      std::lock_guard lock(mutex);
+      free_slots.push_back(slot);
+      slot_free.notify_all();
+    }
+  }
+
+  Client &client;
+  ReconcileOptions options;
+  Sink on_mismatch;
+  ReconcileReport report; // Guarded by sink_mutex while running
+  std::mutex sink_mutex;
+
+  // Queues between the feeding thread, the IO thread and the comparison
+  // threads.
+  std::vector<std::unique_ptr<Slot>> slots;
+  std::mutex mutex;
+  std::condition_variable reply_ready;
+  std::condition_variable slot_free;
+  std::deque<Slot *> ready;
+  std::vector<Slot *> free_slots;
+};
+
+} // namespace tigerbeetle
+#endif // TB_RECONCILE_HPP
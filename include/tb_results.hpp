@@ -0,0 +1,238 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+#ifndef TB_RESULTS_HPP
+#define TB_RESULTS_HPP
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <span>
+#include <vector>
+
+#include "tb_client.hpp"
+
+namespace tigerbeetle {
+
+// Indices of the set bits of a bitmap, in increasing order. Walks a word at
+// a time: clear words are skipped whole and set bits are found with
+// countr_zero, so there is no test per index.
+class BitIndices {
+public:
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;
+
+    std::size_t operator*() const {
+      return word * 64 + static_cast<std::size_t>(std::countr_zero(bits));
+    }
+    iterator &operator++() {
+      bits &= bits - 1;
+      skip();
+      return *this;
+    }
+    iterator operator++(int) {
+      auto old = *this;
+      ++*this;
+      return old;
+    }
+    bool operator==(const iterator &other) const {
+      return word == other.word && bits == other.bits;
+    }
+
+  private:
+    friend class BitIndices;
+    iterator(std::span<const uint64_t> bitmap, std::size_t count,
+             bool inverted, std::size_t first)
+        : words(bitmap), size(count), invert(inverted), word(first) {
+      if (word < words.size()) {
+        bits = load();
+        skip();
+      }
+    }
+
+    uint64_t load() const {
+      auto loaded = invert ? ~words[word] : words[word];
+      if (word == words.size() - 1 && size % 64 != 0) {
+        loaded &= (uint64_t{1} << (size % 64)) - 1;
+      }
+      return loaded;
+    }
+
+    void skip() {
+      while (bits == 0 && ++word < words.size()) {
+        bits = load();
+      }
+      if (bits == 0) {
+        word = words.size();
+      }
+    }
+
+    std::span<const uint64_t> words;
+    std::size_t size = 0;
+    bool invert = false;
+    std::size_t word = 0;
+    uint64_t bits = 0;
+  };
+
+  // Set bits of `words` below `size`, or clear ones when `invert`.
+  BitIndices(std::span<const uint64_t> bitmap, std::size_t count,
+             bool inverted)
+      : words(bitmap), size(count), invert(inverted) {}
+
+  iterator begin() const { return {words, size, invert, 0}; }
+  iterator end() const { return {words, size, invert, words.size()}; }
+
+private:
+  std::span<const uint64_t> words;
+  std::size_t size;
+  bool invert;
+};
+
+// Decoded reply of a create_accounts or create_transfers request, which
+// lists only the failed events as {index, result} pairs. Holds a bitmap of
+// failed events, their result codes in index order, and a count per code,
+// so callers routing outcomes back to many waiters can walk the successes
+// and failures directly. Reused across batches without reallocating.
+class CreateResults {
+public:
+  template <typename Result>
+    requires std::same_as<Result, tb_create_accounts_result_t> ||
+             std::same_as<Result, tb_create_transfers_result_t>
+  void decode(std::size_t events, std::span<const Result> results) {
+    event_count = events;
+    bits.assign((events + 63) / 64, 0);
+    codes.clear();
+    counts.clear();
+    uint32_t last = 0;
+    bool sorted = true;
+    for (const auto &r : results) {
+      if (r.index >= events) {
+        continue; // Not a reply to these events
+      }
+      const auto mask = uint64_t{1} << (r.index % 64);
+      sorted = sorted && (codes.empty() || r.index > last);
+      if ((bits[r.index / 64] & mask) != 0) {
+        continue;
+      }
+      bits[r.index / 64] |= mask;
+      codes.push_back(r.result);
+      last = r.index;
+      if (r.result >= counts.size()) {
+        counts.resize(r.result + 1);
+      }
+      ++counts[r.result];
+    }
+    if (!sorted) {
+      reorder(results);
+    }
+    ranks.resize(bits.size());
+    uint32_t rank = 0;
+    for (std::size_t w = 0; w < bits.size(); ++w) {
+      ranks[w] = rank;
+      rank += static_cast<uint32_t>(std::popcount(bits[w]));
+    }
+  }
+
+  // `reply` as returned for a create_* request of `events` events.
+  void decode(TB_OPERATION operation, std::size_t events,
+              const uint8_t *reply, std::size_t size) {
+    if (operation == TB_OPERATION_CREATE_ACCOUNTS) {
+      decode(events, view<tb_create_accounts_result_t>(reply, size));
+    } else {
+      decode(events, view<tb_create_transfers_result_t>(reply, size));
+    }
+  }
+
+  std::size_t size() const { return event_count; }
+  std::size_t failed_count() const { return codes.size(); }
+  std::size_t succeeded_count() const { return event_count - codes.size(); }
+  bool all_succeeded() const { return codes.empty(); }
+
+  bool failed(std::size_t index) const {
+    return (bits[index / 64] >> (index % 64) & 1) != 0;
+  }
+
+  // Result code of an event, 0 (ok) when it succeeded.
+  uint32_t result(std::size_t index) const {
+    if (!failed(index)) {
+      return 0;
+    }
+    const auto below = bits[index / 64] & ((uint64_t{1} << (index % 64)) - 1);
+    return codes[ranks[index / 64] + std::popcount(below)];
+  }
+
+  // Events that failed with `code`.
+  std::size_t count(uint32_t code) const {
+    return code < counts.size() ? counts[code] : 0;
+  }
+
+  BitIndices succeeded_indices() const { return {bits, event_count, true}; }
+  BitIndices failed_indices() const { return {bits, event_count, false}; }
+
+  // Calls fn(index, result) for every failed event, in index order.
+  template <typename Fn> void for_each_failed(Fn &&fn) const {
+    std::size_t next = 0;
+    for (auto index : failed_indices()) {
+      fn(index, codes[next++]);
+    }
+  }
+
+  // Bit i is set when event i failed.
+  std::span<const uint64_t> bitmap() const { return bits; }
+
+private:
+  template <typename Result>
+  static std::span<const Result> view(const uint8_t *reply, std::size_t size) {
+    return {reinterpret_cast<const Result *>(reply), size / sizeof(Result)};
+  }
+
+  // Replies list failures by increasing index; codes are put back in that
+  // order for anything else.
+  template <typename Result> void reorder(std::span<const Result> results) {
+    std::vector<std::pair<uint32_t, uint32_t>> failures;
+    for (const auto &r : results) {
+      if (r.index < event_count) {
+        failures.emplace_back(r.index, r.result);
+      }
+    }
+    std::stable_sort(failures.begin(), failures.end(),
+                     [](const auto &a, const auto &b) {
+                       return a.first < b.first;
+                     });
+    codes.clear();
+    for (std::size_t i = 0; i < failures.size(); ++i) {
+      if (i == 0 || failures[i].first != failures[i - 1].first) {
+        codes.push_back(failures[i].second);
+      }
+    }
+  }
+
+  std::size_t event_count = 0;
+  std::vector<uint64_t> bits;
+  std::vector<uint32_t> ranks; // Failed events before each word
+  std::vector<uint32_t> codes;
+  std::vector<uint32_t> counts;
+};
+
+} // namespace tigerbeetle
+#endif // TB_RESULTS_HPP
@@ -0,0 +1,349 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+#ifndef TB_ROUTER_HPP
+#define TB_ROUTER_HPP
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "tb_batch.hpp"
+
+namespace tigerbeetle {
+
+// One cluster of a sharded deployment.
+struct ClusterConfig {
+  std::string addresses;
+  std::array<uint8_t, 16> cluster_id = {};
+  std::size_t clients = 1; // Clients kept for it, used round-robin
+};
+
+// Outcome of a create_* spread over several clusters. Result indices refer
+// to the caller's events.
+template <tb_event T> struct RoutedCreate {
+  using result_type = typename batch_traits<T>::result_type;
+
+  std::vector<result_type> failures; // Sorted by index
+  std::vector<std::size_t> unsent;   // Events of requests that failed
+  uint8_t packet_status = TB_PACKET_OK; // First failed request, if any
+
+  bool ok() const { return failures.empty() && unsent.empty(); }
+};
+
+// Records of a lookup spread over several clusters, in the caller's order.
+template <typename T> struct RoutedLookup {
+  std::vector<std::optional<T>> records; // Empty when not found
+  uint8_t packet_status = TB_PACKET_OK;  // First failed request, if any
+
+  bool ok() const { return packet_status == TB_PACKET_OK; }
+};
+
+template <typename T>
+concept tb_lookup_record =
+    std::same_as<T, tb_account_t> || std::same_as<T, tb_transfer_t>;
+
+// Clients for several independent clusters that partition the data by
+// ledger. Creates go to the cluster that owns each event's ledger; lookups
+// go to the cluster an id route names, or to every cluster when it cannot
+// tell. The requests of one call are all in flight together, so clusters
+// work in parallel, and the call returns once every reply is in.
+//
+// Linked chains must stay within one ledger's cluster. Calls may come from
+// several threads.
+class Router {
+public:
+  // Cluster index of a ledger. The default spreads ledgers modulo the
+  // number of clusters.
+  using LedgerRoute = std::function<std::size_t(uint32_t ledger)>;
+  // Cluster index of an id, or nothing to ask every cluster.
+  using IdRoute = std::function<std::optional<std::size_t>(tb_uint128_t id)>;
+
+  explicit Router(const std::vector<ClusterConfig> &configs,
+                  LedgerRoute route = {})
+      : ledger_route(std::move(route)) {
+    for (const auto &config : configs) {
+      add_cluster(config, [&config] {
+        return std::make_unique<Client>(config.addresses, config.cluster_id);
+      });
+    }
+  }
+
+  Router(echo_t, const std::vector<ClusterConfig> &configs,
+         LedgerRoute route = {})
+      : ledger_route(std::move(route)) {
+    for (const auto &config : configs) {
+      add_cluster(config, [&config] {
+        return std::make_unique<Client>(echo_client, config.addresses,
+                                        config.cluster_id);
+      });
+    }
+  }
+
+  Router(const Router &) = delete;
+  Router &operator=(const Router &) = delete;
+
+  std::size_t size() const { return clusters.size(); }
+
+  // Whether every client connected.
+  bool ok() const {
+    for (const auto &cluster : clusters) {
+      for (const auto &client : cluster.clients) {
+        if (client->initStatus() != TB_INIT_SUCCESS) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Set before issuing lookups.
+  void set_id_route(IdRoute route) { id_route = std::move(route); }
+
+  std::size_t cluster_of(uint32_t ledger) const {
+    const auto cluster =
+        ledger_route ? ledger_route(ledger) : ledger % clusters.size();
+    if (cluster >= clusters.size()) {
+      throw std::out_of_range("Router ledger route names an unknown cluster");
+    }
+    return cluster;
+  }
+
+  // The next client of a cluster's pool.
+  Client &client(std::size_t cluster) {
+    auto &c = clusters.at(cluster);
+    const auto turn = c.next.fetch_add(1, std::memory_order_relaxed);
+    return *c.clients[turn % c.clients.size()];
+  }
+
+  template <tb_event T> RoutedCreate<T> create(std::span<const T> events) {
+    constexpr auto max_events = MAX_MESSAGE_SIZE / sizeof(T);
+    std::vector<std::vector<std::size_t>> owned(clusters.size());
+    for (std::size_t i = 0; i < events.size(); ++i) {
+      owned[cluster_of(events[i].ledger)].push_back(i);
+    }
+
+    std::vector<std::unique_ptr<Part>> parts;
+    for (std::size_t cluster = 0; cluster < clusters.size(); ++cluster) {
+      const auto &positions = owned[cluster];
+      std::size_t begin = 0;
+      while (begin < positions.size()) {
+        auto end = std::min(positions.size(), begin + max_events);
+        // Cut after the end of a chain when there is one in reach.
+        auto cut = end;
+        while (end < positions.size() && cut > begin &&
+               (events[positions[cut - 1]].flags & batch_traits<T>::linked)) {
+          --cut;
+        }
+        if (cut > begin) {
+          end = cut;
+        }
+        auto &part = *parts.emplace_back(std::make_unique<Part>());
+        part.cluster = cluster;
+        part.positions.assign(positions.begin() + begin,
+                              positions.begin() + end);
+        part.payload.resize(part.positions.size() * sizeof(T));
+        for (std::size_t i = 0; i < part.positions.size(); ++i) {
+          std::memcpy(part.payload.data() + i * sizeof(T),
+                      &events[part.positions[i]], sizeof(T));
+        }
+        part.packet.operation = batch_traits<T>::operation;
+        begin = end;
+      }
+    }
+    exchange(parts);
+
+    RoutedCreate<T> routed;
+    using Result = typename batch_traits<T>::result_type;
+    for (const auto &part : parts) {
+      if (part->status != TB_PACKET_OK) {
+        if (routed.packet_status == TB_PACKET_OK) {
+          routed.packet_status = part->status;
+        }
+        routed.unsent.insert(routed.unsent.end(), part->positions.begin(),
+                             part->positions.end());
+        continue;
+      }
+      const auto *results =
+          reinterpret_cast<const Result *>(part->reply.data());
+      for (std::size_t i = 0; i < part->reply.size() / sizeof(Result); ++i) {
+        if (results[i].index < part->positions.size()) {
+          routed.failures.push_back(
+              {static_cast<uint32_t>(part->positions[results[i].index]),
+               results[i].result});
+        }
+      }
+    }
+    std::sort(routed.failures.begin(), routed.failures.end(),
+              [](const auto &a, const auto &b) { return a.index < b.index; });
+    std::sort(routed.unsent.begin(), routed.unsent.end());
+    return routed;
+  }
+
+  template <tb_lookup_record T>
+  RoutedLookup<T> lookup(std::span<const tb_uint128_t> ids) {
+    constexpr auto max_ids = MAX_MESSAGE_SIZE / sizeof(T);
+    std::vector<std::vector<std::size_t>> asked(clusters.size());
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+      const auto cluster = id_route ? id_route(ids[i]) : std::nullopt;
+      if (cluster.has_value()) {
+        asked.at(*cluster).push_back(i);
+      } else {
+        for (auto &positions : asked) {
+          positions.push_back(i);
+        }
+      }
+    }
+
+    std::vector<std::unique_ptr<Part>> parts;
+    for (std::size_t cluster = 0; cluster < clusters.size(); ++cluster) {
+      const auto &positions = asked[cluster];
+      for (std::size_t begin = 0; begin < positions.size();
+           begin += max_ids) {
+        const auto end = std::min(positions.size(), begin + max_ids);
+        auto &part = *parts.emplace_back(std::make_unique<Part>());
+        part.cluster = cluster;
+        part.positions.assign(positions.begin() + begin,
+                              positions.begin() + end);
+        part.payload.resize(part.positions.size() * sizeof(tb_uint128_t));
+        for (std::size_t i = 0; i < part.positions.size(); ++i) {
+          std::memcpy(part.payload.data() + i * sizeof(tb_uint128_t),
+                      &ids[part.positions[i]], sizeof(tb_uint128_t));
+        }
+        part.packet.operation = std::same_as<T, tb_account_t>
+                                    ? TB_OPERATION_LOOKUP_ACCOUNTS
+                                    : TB_OPERATION_LOOKUP_TRANSFERS;
+      }
+    }
+    exchange(parts);
+
+    // Replies hold the records that exist, in request order. Parts are in
+    // cluster order, so the lowest cluster wins if an id is found twice.
+    RoutedLookup<T> routed;
+    routed.records.resize(ids.size());
+    for (const auto &part : parts) {
+      if (part->status != TB_PACKET_OK) {
+        if (routed.packet_status == TB_PACKET_OK) {
+          routed.packet_status = part->status;
+        }
+        continue;
+      }
+      const std::span<const T> found(
+          reinterpret_cast<const T *>(part->reply.data()),
+          part->reply.size() / sizeof(T));
+      std::size_t next = 0;
+      for (auto position : part->positions) {
+        if (next < found.size() && found[next].id == ids[position]) {
+          auto &record = routed.records[position];
+          if (!record) {
+            record = found[next];
+          }
+          ++next;
+        }
+      }
+    }
+    return routed;
+  }
+
+private:
+  struct Exchange;
+
+  // One request to one cluster, with the caller's position of each event.
+  struct Part : Request {
+    std::size_t cluster = 0;
+    std::vector<std::size_t> positions;
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> reply;
+    uint8_t status = TB_PACKET_OK;
+    Exchange *exchange = nullptr;
+  };
+
+  // Parts of one call still waiting for their reply.
+  struct Exchange {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::size_t pending = 0;
+
+    void settle() {
+      // Notify under the lock: the caller may return as soon as it sees 0.
+      std::lock_guard lock(mutex);
+      if (--pending == 0) {
+        cv.notify_all();
+      }
+    }
+  };
+
+  struct Cluster {
+    std::vector<std::unique_ptr<Client>> clients;
+    std::atomic<std::size_t> next{0};
+  };
+
+  template <typename Make>
+  void add_cluster(const ClusterConfig &config, Make make) {
+    auto &cluster = clusters.emplace_back();
+    for (std::size_t i = 0; i < std::max<std::size_t>(config.clients, 1);
+         ++i) {
+      cluster.clients.push_back(make());
+    }
+  }
+
+  static void on_part_reply(Request *request, [[maybe_unused]] uint64_t ts,
+                            const uint8_t *data, uint32_t size) {
+    auto *part = static_cast<Part *>(request);
+    part->status = request->packet.status;
+    part->reply.assign(data, data + size);
+    part->exchange->settle();
+  }
+
+  // Submits every part at once and waits for all of them.
+  void exchange(std::vector<std::unique_ptr<Part>> &parts) {
+    Exchange pending;
+    pending.pending = parts.size();
+    for (auto &part : parts) {
+      part->exchange = &pending;
+      part->packet.data = part->payload.data();
+      part->packet.data_size = static_cast<uint32_t>(part->payload.size());
+      part->on_reply = &Router::on_part_reply;
+      if (client(part->cluster).submit(*part) !=
+          TB_CLIENT_STATUS::TB_CLIENT_OK) {
+        part->status = part->packet.status != TB_PACKET_OK
+                           ? part->packet.status
+                           : uint8_t{TB_PACKET_CLIENT_SHUTDOWN};
+        pending.settle();
+      }
+    }
+    std::unique_lock lock(pending.mutex);
+    pending.cv.wait(lock, [&pending] { return pending.pending == 0; });
+  }
+
+  std::deque<Cluster> clusters; // Stable addresses for the atomics
+  LedgerRoute ledger_route;
+  IdRoute id_route;
+};
+
+} // namespace tigerbeetle
+#endif // TB_ROUTER_HPP
@@ -0,0 +1,324 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+#ifndef TB_TRACE_HPP
+#define TB_TRACE_HPP
+#include <cstdint>
+#include <cstdio>
+
+// Packet lifecycle tracing, compiled in with -DTB_TRACING (CMake option
+// TB_TRACING). Without it TB_TRACE() expands to nothing and the exporters
+// write an empty trace.
+//
+// Every TB_TRACE(event, packet, arg) stores a timestamped record in a ring
+// buffer owned by the calling thread; the oldest records are overwritten.
+// save_chrome_trace() writes them as Chrome trace-event JSON, viewable in
+// Perfetto or chrome://tracing: one instant per record, plus per-packet
+// async slices between consecutive lifecycle stages.
+
+#if !defined(TB_TRACE_CAPACITY)
+#define TB_TRACE_CAPACITY 16384 // Records per thread, a power of two
+#endif
+
+#if defined(TB_TRACING)
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#endif
+
+namespace tigerbeetle {
+
+// Lifecycle stages, in order.
+enum class TraceEvent : uint8_t {
+  enqueue,  // Event queued by a batcher, before it has a packet
+  seal,     // Packet handed to Client::submit or send_request
+  submit,   // tb_client_submit, after admission control
+  complete, // Completion callback entered, on the IO thread
+  wake      // Blocking caller woken with the reply
+};
+
+inline const char *trace_event_name(TraceEvent event) {
+  switch (event) {
+  case TraceEvent::enqueue:
+    return "enqueue";
+  case TraceEvent::seal:
+    return "seal";
+  case TraceEvent::submit:
+    return "submit";
+  case TraceEvent::complete:
+    return "complete";
+  case TraceEvent::wake:
+    return "wake";
+  }
+  return "unknown";
+}
+
+// Name of the slice that starts at `event`.
+inline const char *trace_slice_name(TraceEvent event) {
+  switch (event) {
+  case TraceEvent::seal:
+    return "queued";
+  case TraceEvent::submit:
+    return "in flight";
+  case TraceEvent::complete:
+    return "dispatch";
+  default:
+    return trace_event_name(event);
+  }
+}
+
+#if defined(TB_TRACING)
+
+#define TB_TRACE(event, packet, arg)                                           \
+  ::tigerbeetle::trace::record(::tigerbeetle::TraceEvent::event,               \
+                               reinterpret_cast<uintptr_t>(packet),            \
+                               static_cast<uint32_t>(arg))
+
+namespace trace {
+
+static_assert((TB_TRACE_CAPACITY & (TB_TRACE_CAPACITY - 1)) == 0,
+              "TB_TRACE_CAPACITY must be a power of two");
+
+struct Record {
+  uint64_t ns;
+  uintptr_t packet;
+  uint32_t arg;
+  TraceEvent event;
+  uint32_t thread;
+};
+
+// Single writer ring. Slots are a seqlock so that export may run while the
+// owner keeps recording; torn slots are skipped.
+class Ring {
+public:
+  explicit Ring(uint32_t thread_index) : index(thread_index) {}
+
+  void push(TraceEvent event, uintptr_t packet, uint32_t arg, uint64_t ns) {
+    const auto n = head.load(std::memory_order_relaxed);
+    auto &slot = slots[n & (TB_TRACE_CAPACITY - 1)];
+    // Release stores keep the invalidation ahead of the new contents.
+    slot.seq.store(0, std::memory_order_relaxed);
+    slot.ns.store(ns, std::memory_order_release);
+    slot.packet.store(packet, std::memory_order_release);
+    slot.arg.store(static_cast<uint64_t>(arg) << 8 |
+                       static_cast<uint8_t>(event),
+                   std::memory_order_release);
+    slot.seq.store(n + 1, std::memory_order_release);
+    head.store(n + 1, std::memory_order_release);
+  }
+
+  void collect(std::vector<Record> &out) const {
+    const auto end = head.load(std::memory_order_acquire);
+    const uint64_t oldest =
+        end > TB_TRACE_CAPACITY ? end - TB_TRACE_CAPACITY : 0;
+    const auto begin =
+        std::max(oldest, floor.load(std::memory_order_relaxed));
+    for (auto n = begin; n < end; ++n) {
+      const auto &slot = slots[n & (TB_TRACE_CAPACITY - 1)];
+      if (slot.seq.load(std::memory_order_acquire) != n + 1) {
+        continue;
+      }
+      Record record{slot.ns.load(std::memory_order_acquire),
+                    slot.packet.load(std::memory_order_acquire), 0,
+                    TraceEvent::enqueue, index};
+      const auto packed = slot.arg.load(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) != n + 1) {
+        continue; // Overwritten while reading
+      }
+      record.arg = static_cast<uint32_t>(packed >> 8);
+      record.event = static_cast<TraceEvent>(packed & 0xFF);
+      out.push_back(record);
+    }
+  }
+
+  // Hides what was recorded so far, head stays with the owner.
+  void clear() {
+    floor.store(head.load(std::memory_order_acquire),
+                std::memory_order_relaxed);
+  }
+
+  const uint32_t index;
+  char name[32] = {}; // Under the registry mutex
+
+private:
+  struct Slot {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<uint64_t> ns{0};
+    std::atomic<uintptr_t> packet{0};
+    std::atomic<uint64_t> arg{0};
+  };
+  std::atomic<uint64_t> head{0};
+  std::atomic<uint64_t> floor{0};
+  Slot slots[TB_TRACE_CAPACITY];
+};
+
+// Rings outlive their threads so that their records can still be exported.
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<Ring>> rings;
+
+  static Registry &get() {
+    static Registry registry;
+    return registry;
+  }
+};
+
+inline Ring &local_ring() {
+  thread_local Ring *ring = [] {
+    auto &registry = Registry::get();
+    std::lock_guard lock(registry.mutex);
+    const auto index = static_cast<uint32_t>(registry.rings.size());
+    registry.rings.push_back(std::make_unique<Ring>(index));
+    return registry.rings.back().get();
+  }();
+  return *ring;
+}
+
+inline uint64_t now_ns() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+inline void record(TraceEvent event, uintptr_t packet, uint32_t arg) {
+  local_ring().push(event, packet, arg, now_ns());
+}
+
+// Labels the calling thread in exported traces.
+inline void name_thread(const char *name) {
+  auto &ring = local_ring();
+  std::lock_guard lock(Registry::get().mutex);
+  std::snprintf(ring.name, sizeof(ring.name), "%s", name);
+}
+
+// Every record still held by any ring, oldest first.
+inline std::vector<Record> snapshot() {
+  std::vector<Record> records;
+  auto &registry = Registry::get();
+  {
+    std::lock_guard lock(registry.mutex);
+    for (const auto &ring : registry.rings) {
+      ring->collect(records);
+    }
+  }
+  std::stable_sort(
+      records.begin(), records.end(),
+      [](const Record &a, const Record &b) { return a.ns < b.ns; });
+  return records;
+}
+
+// Drops recorded events. Threads that are recording concurrently may keep a
+// few of theirs.
+inline void clear() {
+  auto &registry = Registry::get();
+  std::lock_guard lock(registry.mutex);
+  for (auto &ring : registry.rings) {
+    ring->clear();
+  }
+}
+
+inline void write_chrome_trace(std::FILE *out) {
+  const auto records = snapshot();
+  const uint64_t origin = records.empty() ? 0 : records.front().ns;
+  auto us = [origin](uint64_t ns) { return double(ns - origin) / 1000.0; };
+
+  std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", out);
+  const char *sep = "\n";
+  {
+    auto &registry = Registry::get();
+    std::lock_guard lock(registry.mutex);
+    for (const auto &ring : registry.rings) {
+      std::fprintf(out,
+                   "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,"
+                   "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                   sep, ring->index,
+                   ring->name[0] != 0 ? ring->name : "thread");
+      sep = ",\n";
+    }
+  }
+  for (const auto &r : records) {
+    std::fprintf(out,
+                 "%s{\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s\",\"cat\":"
+                 "\"tb\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"args\":{"
+                 "\"packet\":\"0x%llx\",\"arg\":%u}}",
+                 sep, trace_event_name(r.event), r.thread, us(r.ns),
+                 static_cast<unsigned long long>(r.packet), r.arg);
+    sep = ",\n";
+  }
+
+  // Slices between consecutive stages of the same packet. Addresses are
+  // reused, so a stage that does not move forward starts a new lifecycle.
+  auto by_packet = records;
+  std::stable_sort(by_packet.begin(), by_packet.end(),
+                   [](const Record &a, const Record &b) {
+                     return a.packet < b.packet;
+                   });
+  for (std::size_t i = 0; i + 1 < by_packet.size(); ++i) {
+    const auto &from = by_packet[i];
+    const auto &to = by_packet[i + 1];
+    if (from.packet == 0 || from.packet != to.packet ||
+        to.event <= from.event) {
+      continue;
+    }
+    const std::pair<const char *, uint64_t> ends[] = {{"b", from.ns},
+                                                      {"e", to.ns}};
+    for (const auto &[ph, at] : ends) {
+      std::fprintf(out,
+                   "%s{\"ph\":\"%s\",\"name\":\"%s\",\"cat\":\"packet\","
+                   "\"id\":\"0x%llx\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+                   sep, ph, trace_slice_name(from.event),
+                   static_cast<unsigned long long>(from.packet), from.thread,
+                   us(at));
+      sep = ",\n";
+    }
+  }
+  std::fputs("\n]}\n", out);
+}
+
+#else
+
+#define TB_TRACE(event, packet, arg) ((void)0)
+
+namespace trace {
+
+inline void name_thread(const char *) {}
+inline void clear() {}
+inline void write_chrome_trace(std::FILE *out) {
+  std::fputs("{\"traceEvents\":[]}\n", out);
+}
+
+#endif // TB_TRACING
+
+inline bool save_chrome_trace(const char *path) {
+  std::FILE *out = std::fopen(path, "w");
+  if (out == nullptr) {
+    return false;
+  }
+  write_chrome_trace(out);
+  return std::fclose(out) == 0;
+}
+
+} // namespace trace
+} // namespace tigerbeetle
+#endif // TB_TRACE_HPP
@@ -0,0 +1,257 @@
+/*
+Copyright (c) 2023 Matheus Catarino França (matheus-catarino@hotmail.com)
+
+Boost Software License - Version 1.0 - August 17th, 2003
+
+Permission is hereby granted, free of charge, to any person or organization
+obtaining a copy of the software and accompanying documentation covered by
+this license (the "Software") to use, reproduce, display, distribute,
+execute, and transmit the Software, and to prepare derivative works of the
+Software, and to permit third-parties to whom the Software is furnished to
+do so, all subject to the following:
+
+The copyright notices in the Software and this entire statement, including
+the above license grant, this restriction and the following disclaimer,
+must be included in all copies of the Software, in whole or in part, and
+all derivative works of the Software, unless such copies or derivative
+works are solely in the form of machine-executable object code generated by
+a source language processor.
+*/
+// C++20 named module over the header-only client: `import tigerbeetle;`.
+// The headers, the C client header and the standard library are compiled
+// once here, in the global module fragment; importers only load the
+// compiled interface. Build it with -DTB_BUILD_MODULE=ON (CMake 3.28+);
+// experimental, importing it has not been tested yet.
+//
+// Formatter specializations (std::formatter, fmt::formatter) and the
+// TB_TRACE macro are not exported: include tb_format.hpp / tb_trace.hpp
+// where they are needed.
+module;
+
+#include "tb_aggregate.hpp"
+#include "tb_batch.hpp"
+#include "tb_capture.hpp"
+#include "tb_client.hpp"
+#include "tb_filter.hpp"
+#include "tb_format.hpp"
+#include "tb_memory.hpp"
+#include "tb_netting.hpp"
+#include "tb_numa.hpp"
+#include "tb_pending.hpp"
+#include "tb_percore.hpp"
+#include "tb_pipeline.hpp"
+#include "tb_query.hpp"
+#include "tb_reconcile.hpp"
+#include "tb_results.hpp"
+#include "tb_router.hpp"
+#include "tb_trace.hpp"
+
+export module tigerbeetle;
+
+export namespace tigerbeetle {
+// tb_client.h
+using tigerbeetle::tb_uint128_t;
+using tigerbeetle::tb_account_t;
+using tigerbeetle::tb_transfer_t;
+using tigerbeetle::tb_create_accounts_result_t;
+using tigerbeetle::tb_create_transfers_result_t;
+using tigerbeetle::tb_account_filter_t;
+using tigerbeetle::tb_account_balance_t;
+using tigerbeetle::tb_query_filter_t;
+using tigerbeetle::tb_client_t;
+using tigerbeetle::tb_packet_t;
+using tigerbeetle::TB_ACCOUNT_FLAGS;
+using tigerbeetle::TB_TRANSFER_FLAGS;
+using tigerbeetle::TB_CREATE_ACCOUNT_RESULT;
+using tigerbeetle::TB_CREATE_TRANSFER_RESULT;
+using tigerbeetle::TB_ACCOUNT_FILTER_FLAGS;
+using tigerbeetle::TB_QUERY_FILTER_FLAGS;
+using tigerbeetle::TB_OPERATION;
+using tigerbeetle::TB_PACKET_STATUS;
+using tigerbeetle::TB_INIT_STATUS;
+using tigerbeetle::TB_CLIENT_STATUS;
+// The enumerators of the C enums, whatever the tb_client.h version.
+using enum TB_ACCOUNT_FLAGS;
+using enum TB_TRANSFER_FLAGS;
+using enum TB_CREATE_ACCOUNT_RESULT;
+using enum TB_CREATE_TRANSFER_RESULT;
+using enum TB_ACCOUNT_FILTER_FLAGS;
+using enum TB_QUERY_FILTER_FLAGS;
+using enum TB_OPERATION;
+using enum TB_PACKET_STATUS;
+using enum TB_INIT_STATUS;
+using enum TB_CLIENT_STATUS;
+using tigerbeetle::tb_client_init;
+using tigerbeetle::tb_client_init_echo;
+using tigerbeetle::tb_client_submit;
+using tigerbeetle::tb_client_deinit;
+
+// tb_client.hpp
+using tigerbeetle::tb_uint32_t;
+using tigerbeetle::tb_uint64_t;
+using tigerbeetle::tb_same;
+using tigerbeetle::tb_integral;
+using tigerbeetle::uint128_hash;
+using tigerbeetle::MAX_MESSAGE_SIZE;
+using tigerbeetle::accountID;
+using tigerbeetle::transferID;
+using tigerbeetle::transfer;
+using tigerbeetle::account;
+using tigerbeetle::AccountID;
+using tigerbeetle::TransferID;
+using tigerbeetle::TransferArray;
+using tigerbeetle::AccountArray;
+using tigerbeetle::make_account;
+using tigerbeetle::make_transfer;
+using tigerbeetle::CLIENT_PACKET_STATUS;
+using enum CLIENT_PACKET_STATUS;
+using tigerbeetle::Deadline;
+using tigerbeetle::event_size;
+using tigerbeetle::OverloadPolicy;
+using tigerbeetle::RateUnit;
+using tigerbeetle::AdmissionOptions;
+using tigerbeetle::RequestTiming;
+using tigerbeetle::DrainReport;
+using tigerbeetle::StartupMetrics;
+using tigerbeetle::CompletionContext;
+using tigerbeetle::default_on_completion;
+using tigerbeetle::Request;
+using tigerbeetle::PacketSubmit;
+using tigerbeetle::PacketRecorder;
+using tigerbeetle::echo_t;
+using tigerbeetle::echo_client;
+using tigerbeetle::Client;
+
+// tb_pending.hpp
+using tigerbeetle::AMOUNT_MAX;
+using tigerbeetle::MAX_TRANSFERS_PER_BATCH;
+using tigerbeetle::TimerWheel;
+using tigerbeetle::DecisionResult;
+using tigerbeetle::PendingTransferOptions;
+using tigerbeetle::PendingTransferManager;
+
+// tb_batch.hpp
+using tigerbeetle::batch_traits;
+using tigerbeetle::tb_event;
+using tigerbeetle::ChainResult;
+using tigerbeetle::ChainPacker;
+
+// tb_pipeline.hpp
+using tigerbeetle::StageStatus;
+using tigerbeetle::Flow;
+
+// tb_memory.hpp
+using tigerbeetle::Batch;
+using tigerbeetle::ReplyBuffer;
+using tigerbeetle::message_pool_options;
+using tigerbeetle::PooledRequest;
+using tigerbeetle::PacketPool;
+
+// tb_numa.hpp
+using tigerbeetle::HUGE_PAGE_SIZE;
+using tigerbeetle::current_numa_node;
+using tigerbeetle::numa_node_cpus;
+using tigerbeetle::CpuAffinity;
+using tigerbeetle::NodeAffinity;
+using tigerbeetle::HugePageOptions;
+using tigerbeetle::HugePageResource;
+
+// tb_trace.hpp
+using tigerbeetle::TraceEvent;
+using tigerbeetle::trace_event_name;
+using tigerbeetle::trace_slice_name;
+
+// tb_format.hpp
+using tigerbeetle::MAX_DECIMAL_DIGITS;
+using tigerbeetle::MAX_HEX_DIGITS;
+using tigerbeetle::write_decimal;
+using tigerbeetle::write_hex;
+using tigerbeetle::to_chars;
+using tigerbeetle::from_chars;
+using tigerbeetle::parse_uint128;
+using tigerbeetle::for_each_field;
+using tigerbeetle::tb_record;
+using tigerbeetle::max_text_size;
+using tigerbeetle::write_fields;
+using tigerbeetle::write_csv_row;
+using tigerbeetle::csv_header;
+using tigerbeetle::append_csv;
+using tigerbeetle::append_decimal;
+using tigerbeetle::EnumName;
+using tigerbeetle::enum_name;
+
+// tb_aggregate.hpp
+using tigerbeetle::reply_records;
+using tigerbeetle::WideSum;
+using tigerbeetle::NetPosition;
+using tigerbeetle::net_of;
+using tigerbeetle::BalanceTotals;
+using tigerbeetle::LedgerTotals;
+using tigerbeetle::CodeTotals;
+using tigerbeetle::BalanceAggregator;
+
+// tb_reconcile.hpp
+using tigerbeetle::ExpectedBalance;
+using tigerbeetle::MismatchKind;
+using tigerbeetle::Mismatch;
+using tigerbeetle::ReconcileOptions;
+using tigerbeetle::ReconcileReport;
+using tigerbeetle::balances_equal;
+using tigerbeetle::compare_lookup;
+using tigerbeetle::Reconciler;
+
+// tb_filter.hpp
+using tigerbeetle::IdFilter;
+
+// tb_results.hpp
+using tigerbeetle::BitIndices;
+using tigerbeetle::CreateResults;
+
+// tb_router.hpp
+using tigerbeetle::ClusterConfig;
+using tigerbeetle::RoutedCreate;
+using tigerbeetle::RoutedLookup;
+using tigerbeetle::tb_lookup_record;
+using tigerbeetle::Router;
+
+// tb_capture.hpp
+using tigerbeetle::CaptureFileHeader;
+using tigerbeetle::CaptureRecord;
+using tigerbeetle::CaptureWriter;
+using tigerbeetle::CaptureEntry;
+using tigerbeetle::CaptureReader;
+
+// tb_query.hpp
+using tigerbeetle::tb_query_record;
+using tigerbeetle::ParallelQueryOptions;
+using tigerbeetle::split_by_timestamp;
+using tigerbeetle::ParallelQuery;
+
+// tb_percore.hpp
+using tigerbeetle::CACHE_LINE_SIZE;
+using tigerbeetle::SpscRing;
+using tigerbeetle::CoreOptions;
+using tigerbeetle::CoreCounters;
+using tigerbeetle::CoreRequest;
+using tigerbeetle::CoreExecutor;
+
+// tb_netting.hpp
+using tigerbeetle::NettedLeg;
+using tigerbeetle::NettingPlan;
+using tigerbeetle::LegNetter;
+using tigerbeetle::NettingReport;
+using tigerbeetle::NettingOptions;
+using tigerbeetle::NettingStats;
+using tigerbeetle::NettingStage;
+} // namespace tigerbeetle
+
+export namespace tigerbeetle::trace {
+using tigerbeetle::trace::name_thread;
+using tigerbeetle::trace::clear;
+using tigerbeetle::trace::write_chrome_trace;
+using tigerbeetle::trace::save_chrome_trace;
+#if defined(TB_TRACING)
+using tigerbeetle::trace::Record;
+using tigerbeetle::trace::snapshot;
+#endif
+} // namespace tigerbeetle::trace
@@ -0,0 +1,75 @@
+#!/usr/bin/env bash
+# Compile time of N translation units that use the client, built three ways:
+# plain #include, with tb_client.hpp precompiled, and with `import
+# tigerbeetle;` (Clang 16+ or GCC 14+).
+#
+#   scripts/compile_time.sh <dir of tb_client.h> [N]
+#
+# CXX picks the compiler (default c++). Only the compile step is timed.
+set -eEuo pipefail
+
+TB_INCLUDE=$1
+COUNT=${2:-50}
+CXX=${CXX:-c++}
+ROOT="$(cd "$(dirname "$0")/.." && pwd)"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+FLAGS=(-std=c++20 -O0 -I"$ROOT/include" -I"$TB_INCLUDE")
+
+# One TU per file, each with a little code of its own.
+for i in $(seq 1 "$COUNT"); do
+    cat > "$WORK/include_$i.cpp" <<CPP
+#include <tb_client.hpp>
+int use_$i(tigerbeetle::Client &client) {
+  tigerbeetle::tb_account_t account{};
+  account.id = $i;
+  return static_cast<int>(client.in_flight() + account.ledger);
+}
+CPP
+    sed -e 's/#include <tb_client.hpp>/import tigerbeetle;/' \
+        "$WORK/include_$i.cpp" > "$WORK/import_$i.cpp"
+done
+
+function now_ms {
+    echo $(($(date +%s%N) / 1000000))
+}
+
+# Milliseconds spent compiling every file matching $1, extra flags after it.
+function compile_all {
+    local pattern=$1
+    shift
+    local start
+    start=$(now_ms)
+    for file in "$WORK"/$pattern; do
+        "$CXX" "${FLAGS[@]}" "$@" -c "$file" -o "${file%.cpp}.o"
+    done
+    echo $(($(now_ms) - start))
+}
+
+# name, total milliseconds, translation units
+function report {
+    printf '%-10s %7d ms  %5d ms/TU\n' "$1" "$2" $(($2 / $3))
+}
+
+echo "$COUNT translation units, $($CXX --version | head -1)"
+
+report include "$(compile_all 'include_*.cpp')" "$COUNT"
+
+cp "$ROOT/include/tb_client.hpp" "$WORK/pch.hpp"
+start=$(now_ms)
+"$CXX" "${FLAGS[@]}" -x c++-header "$WORK/pch.hpp" -o "$WORK/pch.hpp.$(
+    "$CXX" --version | grep -qi clang && echo pch || echo gch)"
+report "pch build" $(($(now_ms) - start)) 1
+report pch "$(compile_all 'include_*.cpp' -include "$WORK/pch.hpp")" "$COUNT"
+
+if "$CXX" --version | grep -qi clang; then
+    start=$(now_ms)
+    "$CXX" "${FLAGS[@]}" --precompile -x c++-module \
+        "$ROOT/include/tigerbeetle.cppm" -o "$WORK/tigerbeetle.pcm"
+    report "bmi build" $(($(now_ms) - start)) 1
+    report import "$(compile_all 'import_*.cpp' \
+        -fmodule-file=tigerbeetle="$WORK/tigerbeetle.pcm")" "$COUNT"
+else
+    echo "import     skipped, needs Clang (GCC 14+ builds it through CMake)"
+fi
@@ -10,27 +10,37 @@ function onerror {
         cat running.log
     fi
 
-    kill %1
+    kill $(jobs -p)
 }
 trap onerror EXIT
 
 TB_ADDRESS=$2
 
-# Be careful to use a running-specific filename so that we don't erase a real data file:
-FILE="$PWD/0_0.tigerbeetle"
-if [ -f "$FILE" ]; then
-    rm "$FILE"
-fi
+# TB_CLUSTERS may list several space-separated addresses: one single-replica
+# cluster is started on each, with cluster ids 0, 1, ... in that order.
+CLUSTERS=(${TB_CLUSTERS:-$TB_ADDRESS})
 
-./tigerbeetle format --cluster=0 --replica=0 --replica-count=1  "$FILE" > running.log 2>&1
-echo "Starting replica 0"
-./tigerbeetle start --addresses=$TB_ADDRESS  "$FILE" > running.log 2>&1 &
+: > running.log
+for i in "${!CLUSTERS[@]}"; do
+    # Be careful to use a running-specific filename so that we don't erase a real data file:
+    FILE="$PWD/${i}_0.tigerbeetle"
+    if [ -f "$FILE" ]; then
+        rm "$FILE"
+    fi
+
+    ./tigerbeetle format --cluster=$i --replica=0 --replica-count=1  "$FILE" >> running.log 2>&1
+    echo "Starting replica 0 of cluster $i"
+    ./tigerbeetle start --addresses=${CLUSTERS[$i]}  "$FILE" >> running.log 2>&1 &
+done
 
 echo ""
 echo "running client..."
 $1
 echo ""
 
-if [ -f "$FILE" ]; then
-    rm "$FILE"
-fi
+for i in "${!CLUSTERS[@]}"; do
+    FILE="$PWD/${i}_0.tigerbeetle"
+    if [ -f "$FILE" ]; then
+        rm "$FILE"
+    fi
+done
@@ -0,0 +1,173 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <memory>
+#include <tb_client.hpp>
+#include <vector>
+
+namespace {
+struct Tracked : tigerbeetle::Request {
+  tigerbeetle::tb_uint128_t id = 0;
+  std::atomic<int> replies{0};
+  std::atomic<uint8_t> status{0};
+};
+
+std::atomic<int> completed{0};
+
+void on_reply(tigerbeetle::Request *request, uint64_t, const uint8_t *,
+              uint32_t) {
+  auto *tracked = static_cast<Tracked *>(request);
+  tracked->status = request->packet.status;
+  tracked->replies.fetch_add(1);
+  completed.fetch_add(1);
+  completed.notify_all();
+}
+
+void prepare(Tracked &request, tigerbeetle::tb_uint128_t id) {
+  request.id = id;
+  request.packet = {};
+  request.packet.operation = tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS;
+  request.packet.data = &request.id;
+  request.packet.data_size = sizeof(request.id);
+  request.on_reply = &on_reply;
+}
+
+void wait_for(int target) {
+  for (int seen = completed.load(); seen < target; seen = completed.load()) {
+    completed.wait(seen);
+  }
+}
+} // namespace
+
+TEST_CASE("Event sizes") {
+  using namespace tigerbeetle;
+  REQUIRE(event_size(TB_OPERATION_CREATE_TRANSFERS) == sizeof(tb_transfer_t));
+  REQUIRE(event_size(TB_OPERATION_LOOKUP_ACCOUNTS) == sizeof(tb_uint128_t));
+  REQUIRE(event_size(TB_OPERATION_QUERY_TRANSFERS) ==
+          sizeof(tb_query_filter_t));
+}
+
+TEST_CASE("In-flight limit") {
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+  client.set_admission({.max_in_flight = 2});
+
+  completed = 0;
+  std::vector<std::unique_ptr<Tracked>> requests;
+  std::size_t peak = 0;
+  for (int i = 0; i < 200; ++i) {
+    requests.push_back(std::make_unique<Tracked>());
+    prepare(*requests.back(), i + 1);
+    REQUIRE(client.submit(*requests.back()) == tigerbeetle::TB_CLIENT_OK);
+    peak = std::max(peak, client.in_flight());
+  }
+  wait_for(200);
+  REQUIRE(peak <= 2);
+  REQUIRE(client.queued() == 0);
+  for (auto &request : requests) {
+    REQUIRE(request->replies == 1);
+    REQUIRE(request->status == tigerbeetle::TB_PACKET_OK);
+  }
+}
+
+TEST_CASE("Token bucket") {
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+
+  SUBCASE("Block paces requests") {
+    client.set_admission({.rate = 200, .burst = 1});
+    completed = 0;
+    std::vector<std::unique_ptr<Tracked>> requests;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 10; ++i) {
+      requests.push_back(std::make_unique<Tracked>());
+      prepare(*requests.back(), i + 1);
+      REQUIRE(client.submit(*requests.back()) == tigerbeetle::TB_CLIENT_OK);
+    }
+    wait_for(10);
+    // One token up front, nine refills at 5ms each.
+    REQUIRE(std::chrono::steady_clock::now() - start >=
+            std::chrono::milliseconds(40));
+    REQUIRE(requests.back()->timing.queue_wait >=
+            std::chrono::milliseconds(30));
+    REQUIRE(requests.front()->timing.queue_wait <
+            requests.back()->timing.queue_wait);
+  }
+
+  SUBCASE("Fail fast refuses without sending") {
+    client.set_admission({.rate = 0.001,
+                          .burst = 1,
+                          .policy = tigerbeetle::OverloadPolicy::fail_fast});
+    completed = 0;
+    Tracked first;
+    Tracked second;
+    prepare(first, 1);
+    prepare(second, 2);
+    REQUIRE(client.submit(first) == tigerbeetle::TB_CLIENT_OK);
+    REQUIRE(client.submit(second) == tigerbeetle::TB_CLIENT_INVALID);
+    REQUIRE(second.packet.status == tigerbeetle::CLIENT_PACKET_REJECTED);
+    wait_for(1);
+    REQUIRE(second.replies == 0);
+
+    // Blocking callers see the same outcome through packet.status.
+    auto ctx = std::make_unique<tigerbeetle::CompletionContext>();
+    tigerbeetle::tb_packet_t packet{};
+    tigerbeetle::tb_uint128_t id = 3;
+    packet.operation = tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS;
+    packet.data = &id;
+    packet.data_size = sizeof(id);
+    packet.user_data = ctx.get();
+    client.send_request(packet, ctx.get());
+    REQUIRE(packet.status == tigerbeetle::CLIENT_PACKET_REJECTED);
+    REQUIRE_FALSE(ctx->completed);
+  }
+}
+
+TEST_CASE("Shed oldest keeps the newest waiters") {
+  completed = 0;
+  Tracked first;
+  Tracked second;
+  Tracked third;
+  prepare(first, 1);
+  prepare(second, 2);
+  prepare(third, 3);
+  {
+    tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+    REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+    client.set_admission({.rate = 0.001,
+                          .burst = 1,
+                          .policy = tigerbeetle::OverloadPolicy::shed_oldest,
+                          .max_queued = 1});
+    REQUIRE(client.submit(first) == tigerbeetle::TB_CLIENT_OK);
+    REQUIRE(client.submit(second) == tigerbeetle::TB_CLIENT_OK);
+    REQUIRE(client.queued() == 1);
+    REQUIRE(client.submit(third) == tigerbeetle::TB_CLIENT_OK);
+    REQUIRE(client.queued() == 1);
+    REQUIRE(second.replies == 1); // Shed on this thread, synchronously
+    REQUIRE(second.status == tigerbeetle::CLIENT_PACKET_SHED);
+    wait_for(2);
+    REQUIRE(first.status == tigerbeetle::TB_PACKET_OK);
+    REQUIRE(third.replies == 0);
+  }
+  // Shutting down completes whatever is still queued.
+  REQUIRE(third.replies == 1);
+  REQUIRE(third.status == tigerbeetle::TB_PACKET_CLIENT_SHUTDOWN);
+}
+
+TEST_CASE("Timing") {
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+  auto ctx = std::make_unique<tigerbeetle::CompletionContext>();
+  tigerbeetle::tb_packet_t packet{};
+  tigerbeetle::tb_uint128_t id = 1;
+  packet.operation = tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS;
+  packet.data = &id;
+  packet.data_size = sizeof(id);
+  packet.user_data = ctx.get();
+  client.send_request(packet, ctx.get());
+  REQUIRE(packet.status == tigerbeetle::TB_PACKET_OK);
+  REQUIRE(ctx->completed);
+  REQUIRE(ctx->timing.service_time > std::chrono::nanoseconds(0));
+  REQUIRE(client.in_flight() == 0);
+}
@@ -0,0 +1,163 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <map>
+#include <memory>
+#include <random>
+#include <tb_aggregate.hpp>
+#include <utility>
+#include <vector>
+
+namespace {
+using tigerbeetle::tb_uint128_t;
+using tigerbeetle::WideSum;
+
+constexpr tb_uint128_t max_u128 = ~tb_uint128_t{0};
+
+WideSum wide(tb_uint128_t value) { return {value, 0}; }
+
+std::vector<tigerbeetle::tb_account_t> random_accounts(std::size_t count) {
+  std::mt19937_64 rng(11);
+  std::vector<tigerbeetle::tb_account_t> accounts(count);
+  for (auto &a : accounts) {
+    a.ledger = static_cast<uint32_t>(rng() % 3 + 1);
+    a.code = static_cast<uint16_t>(rng() % 4 + 1);
+    a.debits_pending = tb_uint128_t{rng()} << (rng() % 64) | rng();
+    a.debits_posted = tb_uint128_t{rng()} << 64 | rng();
+    a.credits_pending = rng() % 1000;
+    a.credits_posted = tb_uint128_t{rng()} << 64 | rng();
+  }
+  return accounts;
+}
+
+// Straightforward per-(ledger, code) sums to compare against.
+std::map<std::pair<uint32_t, uint16_t>, tigerbeetle::BalanceTotals>
+reference(const std::vector<tigerbeetle::tb_account_t> &accounts) {
+  std::map<std::pair<uint32_t, uint16_t>, tigerbeetle::BalanceTotals> sums;
+  for (const auto &a : accounts) {
+    auto &t = sums[{a.ledger, a.code}];
+    t.debits_pending += wide(a.debits_pending);
+    t.debits_posted += wide(a.debits_posted);
+    t.credits_pending += wide(a.credits_pending);
+    t.credits_posted += wide(a.credits_posted);
+    ++t.accounts;
+  }
+  return sums;
+}
+
+void require_equal(const tigerbeetle::BalanceTotals &a,
+                   const tigerbeetle::BalanceTotals &b) {
+  REQUIRE(a.debits_pending == b.debits_pending);
+  REQUIRE(a.debits_posted == b.debits_posted);
+  REQUIRE(a.credits_pending == b.credits_pending);
+  REQUIRE(a.credits_posted == b.credits_posted);
+  REQUIRE(a.accounts == b.accounts);
+}
+
+void require_expected(const tigerbeetle::BalanceAggregator &aggregator,
+                      const std::vector<tigerbeetle::tb_account_t> &accounts) {
+  const auto expected = reference(accounts);
+  const auto by_code = aggregator.by_code();
+  REQUIRE(by_code.size() == expected.size());
+  auto it = expected.begin();
+  for (const auto &c : by_code) {
+    REQUIRE(std::pair(c.ledger, c.code) == it->first);
+    require_equal(c.totals, it->second);
+    ++it;
+  }
+
+  const auto by_ledger = aggregator.by_ledger();
+  REQUIRE(by_ledger.size() == 3);
+  tigerbeetle::BalanceTotals ledger_sum;
+  for (const auto &l : by_ledger) {
+    ledger_sum += l.totals;
+  }
+  require_equal(ledger_sum, aggregator.total());
+  REQUIRE(aggregator.total().accounts == accounts.size());
+  REQUIRE_FALSE(aggregator.total().debits_posted.fits());
+}
+} // namespace
+
+TEST_CASE("Balance aggregation") {
+  const auto accounts = random_accounts(50000);
+  tigerbeetle::BalanceAggregator aggregator;
+
+  SUBCASE("Serial") {
+    aggregator.add(accounts);
+    require_expected(aggregator, accounts);
+  }
+
+  SUBCASE("Threads") {
+    aggregator.add(accounts, 4);
+    require_expected(aggregator, accounts);
+  }
+
+  SUBCASE("In pieces") {
+    std::span<const tigerbeetle::tb_account_t> all(accounts);
+    tigerbeetle::BalanceAggregator other;
+    aggregator.add(all.first(1000));
+    other.add(all.subspan(1000));
+    aggregator.merge(other);
+    require_expected(aggregator, accounts);
+  }
+}
+
+TEST_CASE("Wide sums and net positions") {
+  tigerbeetle::tb_account_t a{};
+  a.ledger = 1;
+  a.credits_posted = max_u128;
+  a.debits_posted = 5;
+  std::vector<tigerbeetle::tb_account_t> accounts(2, a);
+  accounts[1].debits_posted = max_u128;
+
+  tigerbeetle::BalanceAggregator aggregator;
+  aggregator.add(accounts);
+  const auto total = aggregator.total();
+  REQUIRE(total.credits_posted == WideSum{max_u128 - 1, 1});
+  REQUIRE(total.debits_posted == WideSum{4, 1});
+
+  auto net = total.net_posted();
+  REQUIRE_FALSE(net.debit);
+  REQUIRE(net.amount == WideSum{max_u128 - 5, 0});
+
+  net = tigerbeetle::net_of(wide(3), WideSum{1, 1});
+  REQUIRE(net.debit);
+  REQUIRE(net.amount == WideSum{max_u128 - 1, 0});
+}
+
+TEST_CASE("Reply buffers") {
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+  const auto accounts = random_accounts(100);
+
+  auto ctx = std::make_unique<tigerbeetle::CompletionContext>();
+  tigerbeetle::tb_packet_t packet{};
+  packet.operation = tigerbeetle::TB_OPERATION_CREATE_ACCOUNTS;
+  packet.data = const_cast<tigerbeetle::tb_account_t *>(accounts.data());
+  packet.data_size = static_cast<uint32_t>(accounts.size() *
+                                           sizeof(tigerbeetle::tb_account_t));
+  packet.user_data = ctx.get();
+  client.send_request(packet, ctx.get());
+  REQUIRE(packet.status == tigerbeetle::TB_PACKET_OK);
+
+  // The echo reply holds the same accounts.
+  tigerbeetle::BalanceAggregator aggregator;
+  aggregator.add(tigerbeetle::reply_records<tigerbeetle::tb_account_t>(
+      ctx->reply.data(), ctx->size));
+  tigerbeetle::BalanceAggregator expected;
+  expected.add(accounts);
+  require_equal(aggregator.total(), expected.total());
+
+  // Balances are grouped under the caller's ledger and code.
+  std::vector<tigerbeetle::tb_account_balance_t> balances(3);
+  for (auto &b : balances) {
+    b.credits_posted = 7;
+  }
+  aggregator.clear();
+  aggregator.add(9, 2, balances);
+  const auto by_code = aggregator.by_code();
+  REQUIRE(by_code.size() == 1);
+  REQUIRE(by_code[0].ledger == 9);
+  REQUIRE(by_code[0].code == 2);
+  REQUIRE(by_code[0].totals.credits_posted == wide(21));
+  REQUIRE(by_code[0].totals.accounts == 3);
+}
@@ -0,0 +1,105 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <atomic>
+#include <cstdlib>
+#include <doctest/doctest.h>
+#include <new>
+#include <tb_memory.hpp>
+
+namespace {
+std::atomic<std::size_t> allocations{0};
+}
+
+void *operator new(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace {
+struct Round {
+  std::atomic<uint32_t> completed{0};
+};
+
+void on_reply(tigerbeetle::Request *request, uint64_t, const uint8_t *data,
+              uint32_t size) {
+  auto *pooled = static_cast<tigerbeetle::PooledRequest *>(request);
+  pooled->store_reply(data, size);
+  auto *round = static_cast<Round *>(pooled->user_data);
+  // Hand the request back before signalling, the owner may reuse it.
+  tigerbeetle::PacketPool::release(pooled);
+  round->completed.fetch_add(1, std::memory_order_release);
+  round->completed.notify_all();
+}
+
+void run(tigerbeetle::Client &client, tigerbeetle::PacketPool &pool,
+         const tigerbeetle::Batch<tigerbeetle::tb_transfer_t> &batch,
+         Round &round, uint32_t requests) {
+  const auto target = round.completed.load() + requests;
+  for (uint32_t i = 0; i < requests; ++i) {
+    auto *request = pool.acquire();
+    request->assign(tigerbeetle::TB_OPERATION_CREATE_TRANSFERS, batch);
+    request->on_reply = &on_reply;
+    request->user_data = &round;
+    client.submit(*request);
+  }
+  for (auto seen = round.completed.load(std::memory_order_acquire);
+       seen < target; seen = round.completed.load(std::memory_order_acquire)) {
+    round.completed.wait(seen, std::memory_order_acquire);
+  }
+}
+} // namespace
+
+TEST_CASE("Allocation-free submission") {
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+  REQUIRE(client.native_handle() != nullptr);
+
+  std::pmr::unsynchronized_pool_resource resource(
+      tigerbeetle::message_pool_options());
+  tigerbeetle::PacketPool pool(32, &resource);
+  tigerbeetle::Batch<tigerbeetle::tb_transfer_t> batch(128, &resource);
+  for (std::size_t i = 0; i < batch.size(); ++i) {
+    batch[i] = {};
+    batch[i].id = i + 1;
+  }
+  // The resource is unsynchronized: size every reply here, before the IO
+  // thread stores one, so that completions never allocate from it.
+  pool.prefault(batch.size() * sizeof(tigerbeetle::tb_transfer_t));
+
+  Round round;
+  run(client, pool, batch, round, 32); // Warm-up
+
+  const auto before = allocations.load();
+  for (int i = 0; i < 100; ++i) {
+    run(client, pool, batch, round, 32);
+  }
+  const auto after = allocations.load();
+
+  REQUIRE(after == before);
+  REQUIRE(pool.misses() == 0);
+  REQUIRE(round.completed.load() == 32 * 101);
+}
+
+TEST_CASE("Packet Pool") {
+  tigerbeetle::PacketPool pool;
+  auto *first = pool.acquire();
+  REQUIRE(pool.misses() == 1);
+  tigerbeetle::PacketPool::release(first);
+  auto *second = pool.acquire();
+  REQUIRE(second == first); // Recycled, not reallocated
+  REQUIRE(pool.misses() == 1);
+  tigerbeetle::PacketPool::release(second);
+
+  tigerbeetle::PacketPool warm(2);
+  warm.prefault(4096);
+  auto *request = warm.acquire();
+  REQUIRE(request->payload.empty());
+  REQUIRE(request->payload.capacity() >= 4096);
+  REQUIRE(request->reply.capacity() >= 4096);
+  REQUIRE(warm.misses() == 0);
+  tigerbeetle::PacketPool::release(request);
+}
@@ -0,0 +1,230 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <doctest/doctest.h>
+#include <string>
+#include <tb_capture.hpp>
+#include <thread>
+#include <vector>
+
+namespace {
+using tigerbeetle::tb_uint128_t;
+
+std::string capture_path(const char *name) {
+  return std::string("captureTest_") + name + ".tbcap";
+}
+
+// Looks up `count` ids starting at `first` and waits for the reply.
+void lookup(tigerbeetle::Client &client, tb_uint128_t first,
+            std::size_t count) {
+  std::vector<tb_uint128_t> ids(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    ids[i] = first + i;
+  }
+  tigerbeetle::tb_packet_t packet{};
+  packet.operation = tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS;
+  packet.data = ids.data();
+  packet.data_size = static_cast<uint32_t>(count * sizeof(tb_uint128_t));
+  tigerbeetle::CompletionContext ctx;
+  packet.user_data = &ctx;
+  client.send_request(packet, &ctx);
+}
+} // namespace
+
+TEST_CASE("Capture and read back") {
+  const auto path = capture_path("roundtrip");
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.clientStatus() == tigerbeetle::TB_CLIENT_STATUS::TB_CLIENT_OK);
+
+  SUBCASE("Every packet") {
+    {
+      tigerbeetle::CaptureWriter writer(path);
+      writer.attach(client);
+      for (std::size_t i = 0; i < 20; ++i) {
+        lookup(client, 100 * i, i + 1);
+      }
+      writer.flush();
+      REQUIRE(writer.records() == 20);
+      REQUIRE(writer.dropped() == 0);
+      client.set_recorder(nullptr);
+    }
+
+    tigerbeetle::CaptureReader reader(path);
+    tigerbeetle::CaptureEntry entry;
+    std::vector<bool> seen(20);
+    std::size_t count = 0;
+    while (reader.next(entry)) {
+      ++count;
+      const auto &record = entry.record;
+      REQUIRE(record.operation == tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS);
+      REQUIRE(record.status == tigerbeetle::TB_PACKET_OK);
+      REQUIRE(record.submit_ns <= record.complete_ns);
+      REQUIRE(record.in_flight == 1); // One blocking caller
+      REQUIRE(entry.payload.size() % sizeof(tb_uint128_t) == 0);
+      const auto ids = entry.payload.size() / sizeof(tb_uint128_t);
+      REQUIRE(ids >= 1);
+      REQUIRE(ids <= 20);
+      tb_uint128_t first;
+      std::memcpy(&first, entry.payload.data(), sizeof(first));
+      REQUIRE(first == 100 * (ids - 1));
+      REQUIRE(entry.reply == entry.payload); // Echoed
+      seen[ids - 1] = true;
+    }
+    REQUIRE(count == 20);
+    REQUIRE(std::find(seen.begin(), seen.end(), false) == seen.end());
+  }
+
+  SUBCASE("Asynchronous requests") {
+    struct Counted : tigerbeetle::Request {
+      std::atomic<int> *done = nullptr;
+    };
+    std::vector<tb_uint128_t> ids(64, 7);
+    std::vector<Counted> requests(32);
+    std::atomic<int> done{0};
+    {
+      tigerbeetle::CaptureWriter writer(path);
+      writer.attach(client);
+      for (auto &request : requests) {
+        request.done = &done;
+        request.packet.operation = tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS;
+        request.packet.data = ids.data();
+        request.packet.data_size =
+            static_cast<uint32_t>(ids.size() * sizeof(tb_uint128_t));
+        request.on_reply = [](tigerbeetle::Request *r, uint64_t,
+                              const uint8_t *, uint32_t) {
+          static_cast<Counted *>(r)->done->fetch_add(1);
+        };
+        REQUIRE(client.submit(request) ==
+                tigerbeetle::TB_CLIENT_STATUS::TB_CLIENT_OK);
+      }
+      while (done.load() < static_cast<int>(requests.size())) {
+        std::this_thread::yield();
+      }
+      writer.flush();
+      REQUIRE(writer.records() == requests.size());
+      client.set_recorder(nullptr);
+    }
+
+    tigerbeetle::CaptureReader reader(path);
+    tigerbeetle::CaptureEntry entry;
+    std::size_t count = 0;
+    uint32_t deepest = 0;
+    while (reader.next(entry)) {
+      ++count;
+      REQUIRE(entry.record.in_flight >= 1);
+      REQUIRE(entry.record.in_flight <= requests.size());
+      deepest = std::max(deepest, entry.record.in_flight);
+      REQUIRE(entry.reply.size() == ids.size() * sizeof(tb_uint128_t));
+    }
+    REQUIRE(count == requests.size());
+    REQUIRE(deepest > 1);
+  }
+
+  SUBCASE("Reused and refused requests") {
+    // One request resubmitted after each reply, with a refusal in between:
+    // every record has its own submit time, and refusals leave none.
+    struct Flag : tigerbeetle::Request {
+      std::atomic<bool> done{false};
+    };
+    tb_uint128_t id = 9;
+    Flag request;
+    auto send = [&] {
+      request.done = false;
+      request.packet = {};
+      request.packet.operation = tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS;
+      request.packet.data = &id;
+      request.packet.data_size = sizeof(id);
+      request.on_reply = [](tigerbeetle::Request *r, uint64_t,
+                            const uint8_t *, uint32_t) {
+        static_cast<Flag *>(r)->done = true;
+        static_cast<Flag *>(r)->done.notify_one();
+      };
+      return client.submit(request);
+    };
+    {
+      tigerbeetle::CaptureWriter writer(path);
+      writer.attach(client);
+      for (int i = 0; i < 5; ++i) {
+        REQUIRE(send() == tigerbeetle::TB_CLIENT_STATUS::TB_CLIENT_OK);
+        request.done.wait(false);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      client.set_admission({.max_in_flight = 1,
+                            .policy = tigerbeetle::OverloadPolicy::fail_fast});
+      Flag blocker;
+      blocker.packet.operation = tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS;
+      blocker.packet.data = &id;
+      blocker.packet.data_size = sizeof(id);
+      blocker.on_reply = request.on_reply;
+      REQUIRE(client.submit(blocker) ==
+              tigerbeetle::TB_CLIENT_STATUS::TB_CLIENT_OK);
+      if (send() != tigerbeetle::TB_CLIENT_STATUS::TB_CLIENT_OK) {
+        REQUIRE(request.packet.status ==
+                tigerbeetle::CLIENT_PACKET_REJECTED);
+      } else {
+        request.done.wait(false); // The blocker was already back
+      }
+      blocker.done.wait(false);
+      client.set_admission({});
+      writer.flush();
+      client.set_recorder(nullptr);
+    }
+
+    tigerbeetle::CaptureReader reader(path);
+    tigerbeetle::CaptureEntry entry;
+    std::size_t count = 0;
+    uint64_t previous = 0;
+    while (reader.next(entry)) {
+      ++count;
+      REQUIRE(entry.record.submit_ns <= entry.record.complete_ns);
+      if (count <= 5) {
+        REQUIRE(entry.record.in_flight == 1);
+        REQUIRE(entry.record.submit_ns >= previous); // Not a stale time
+        previous = entry.record.complete_ns;
+      }
+    }
+    REQUIRE(count >= 6);
+    REQUIRE(count <= 7);
+  }
+
+  SUBCASE("Over budget") {
+    // Room for a couple of records: the rest are dropped, not waited for.
+    constexpr std::size_t packets = 200;
+    std::size_t records = 0;
+    {
+      tigerbeetle::CaptureWriter writer(path, 3 * 1024);
+      writer.attach(client);
+      for (std::size_t i = 0; i < packets; ++i) {
+        lookup(client, i, 32);
+      }
+      writer.flush();
+      records = writer.records();
+      REQUIRE(records + writer.dropped() == packets);
+      client.set_recorder(nullptr);
+    }
+    tigerbeetle::CaptureReader reader(path);
+    tigerbeetle::CaptureEntry entry;
+    std::size_t count = 0;
+    while (reader.next(entry)) {
+      ++count;
+    }
+    REQUIRE(count == records);
+  }
+
+  std::remove(path.c_str());
+}
+
+TEST_CASE("Not a capture file") {
+  const auto path = capture_path("garbage");
+  if (auto *file = std::fopen(path.c_str(), "wb"); file != nullptr) {
+    std::fputs("not a capture", file);
+    std::fclose(file);
+  }
+  REQUIRE_THROWS_AS(tigerbeetle::CaptureReader{path}, std::runtime_error);
+  REQUIRE_THROWS_AS(tigerbeetle::CaptureReader{capture_path("missing")},
+                    std::runtime_error);
+  std::remove(path.c_str());
+}
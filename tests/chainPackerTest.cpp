@@ -0,0 +1,136 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <tb_batch.hpp>
+#include <vector>
+
+namespace {
+std::vector<tigerbeetle::tb_transfer_t> make_chain(std::size_t length,
+                                                   std::size_t first_id) {
+  std::vector<tigerbeetle::tb_transfer_t> chain(length);
+  for (std::size_t i = 0; i < length; ++i) {
+    chain[i] = {};
+    chain[i].id = first_id + i;
+  }
+  return chain;
+}
+} // namespace
+
+TEST_CASE("Chain Packer") {
+  using Packer = tigerbeetle::ChainPacker<tigerbeetle::tb_transfer_t>;
+
+  SUBCASE("Linked flags are managed per chain") {
+    Packer packer(16);
+    auto chain = make_chain(3, 1);
+    chain[2].flags = tigerbeetle::TB_TRANSFER_LINKED; // Would leave it open
+    REQUIRE(packer.add(chain) == 0);
+    auto packets = packer.pack();
+    REQUIRE(packets.size() == 1);
+    const auto &events = packets[0].events;
+    REQUIRE(events.size() == 3);
+    REQUIRE((events[0].flags & tigerbeetle::TB_TRANSFER_LINKED) != 0);
+    REQUIRE((events[1].flags & tigerbeetle::TB_TRANSFER_LINKED) != 0);
+    REQUIRE((events[2].flags & tigerbeetle::TB_TRANSFER_LINKED) == 0);
+  }
+
+  SUBCASE("Rejects empty and oversized chains") {
+    Packer packer(4);
+    REQUIRE_FALSE(packer.add({}).has_value());
+    REQUIRE_FALSE(packer.add(make_chain(5, 1)).has_value());
+    REQUIRE(packer.add(make_chain(4, 1)).has_value());
+    REQUIRE(packer.size() == 1);
+  }
+
+  SUBCASE("Chains are never split and packets are filled") {
+    Packer packer(10);
+    const std::vector<std::size_t> lengths = {6, 4, 5, 5, 3, 3, 2, 1, 1};
+    std::size_t id = 1;
+    for (auto length : lengths) {
+      REQUIRE(packer.add(make_chain(length, id)).has_value());
+      id += length;
+    }
+    REQUIRE(packer.event_count() == 30);
+
+    auto packets = packer.pack();
+    REQUIRE(packets.size() == 3); // 30 events, 10 per packet
+    REQUIRE(packer.empty());
+
+    std::vector<bool> seen(lengths.size(), false);
+    for (const auto &packet : packets) {
+      REQUIRE(packet.events.size() <= 10);
+      for (const auto &slot : packet.slots) {
+        REQUIRE(slot.length == lengths[slot.chain]);
+        REQUIRE_FALSE(seen[slot.chain]);
+        seen[slot.chain] = true;
+        // Events of a chain stay contiguous and in order.
+        for (std::size_t i = 1; i < slot.length; ++i) {
+          REQUIRE(packet.events[slot.offset + i].id ==
+                  packet.events[slot.offset + i - 1].id + 1);
+        }
+        const auto &last = packet.events[slot.offset + slot.length - 1];
+        REQUIRE((last.flags & tigerbeetle::TB_TRANSFER_LINKED) == 0);
+      }
+    }
+    for (auto s : seen) {
+      REQUIRE(s);
+    }
+  }
+
+  SUBCASE("Accounts use the account linked flag") {
+    tigerbeetle::ChainPacker<tigerbeetle::tb_account_t> packer;
+    tigerbeetle::account<2> accounts = tigerbeetle::make_account<2>();
+    REQUIRE(packer.add(accounts).has_value());
+    auto packets = packer.pack();
+    REQUIRE(packets[0].events[0].flags == tigerbeetle::TB_ACCOUNT_LINKED);
+    REQUIRE(packets[0].events[1].flags == 0);
+  }
+
+  SUBCASE("Failures are routed to their chain and event") {
+    Packer packer(4);
+    REQUIRE(packer.add(make_chain(3, 1)) == 0);
+    REQUIRE(packer.add(make_chain(2, 4)) == 1);
+    REQUIRE(packer.add(make_chain(1, 6)) == 2);
+    auto packets = packer.pack();
+    // Best fit: chains 0 and 2 share the first packet, chain 1 is alone.
+    REQUIRE(packets.size() == 2);
+    REQUIRE(packets[0].slots.size() == 2);
+    REQUIRE(packets[0].slots[0].chain == 0);
+    REQUIRE(packets[0].slots[1].chain == 2);
+    REQUIRE(packets[0].slots[1].offset == 3);
+    REQUIRE(packets[1].slots[0].chain == 1);
+
+    // Chain 0 broke on its second event, chain 2's event already exists;
+    // indexes are relative to the packet, as in a create_transfers reply.
+    const std::vector<tigerbeetle::tb_create_transfers_result_t> reply = {
+        {0, tigerbeetle::TB_CREATE_TRANSFER_LINKED_EVENT_FAILED},
+        {1, tigerbeetle::TB_CREATE_TRANSFER_DEBIT_ACCOUNT_NOT_FOUND},
+        {2, tigerbeetle::TB_CREATE_TRANSFER_LINKED_EVENT_FAILED},
+        {3, tigerbeetle::TB_CREATE_TRANSFER_EXISTS},
+        {9, tigerbeetle::TB_CREATE_TRANSFER_EXISTS}, // Out of range
+    };
+    std::vector<tigerbeetle::ChainResult<tigerbeetle::tb_transfer_t>> results(
+        3);
+    Packer::distribute(packets[0], tigerbeetle::TB_PACKET_OK, reply, results);
+    Packer::distribute(packets[1], tigerbeetle::TB_PACKET_TOO_MUCH_DATA, {},
+                       results);
+
+    const auto &broken = results[0];
+    REQUIRE(broken.packet_status == tigerbeetle::TB_PACKET_OK);
+    REQUIRE(broken.failures.size() == 3);
+    for (uint32_t i = 0; i < 3; ++i) {
+      REQUIRE(broken.failures[i].index == i);
+    }
+    REQUIRE(broken.cause() ==
+            tigerbeetle::TB_CREATE_TRANSFER_DEBIT_ACCOUNT_NOT_FOUND);
+    REQUIRE_FALSE(broken.ok());
+
+    const auto &existing = results[2];
+    REQUIRE(existing.failures.size() == 1);
+    REQUIRE(existing.failures[0].index == 0); // Relative to its chain
+    REQUIRE(existing.cause() == tigerbeetle::TB_CREATE_TRANSFER_EXISTS);
+
+    const auto &unsent = results[1];
+    REQUIRE(unsent.failures.empty());
+    REQUIRE(unsent.packet_status == tigerbeetle::TB_PACKET_TOO_MUCH_DATA);
+    REQUIRE_FALSE(unsent.ok());
+  }
+}
@@ -0,0 +1,249 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <doctest/doctest.h>
+#include <memory>
+#include <stop_token>
+#include <tb_client.hpp>
+#include <thread>
+
+namespace {
+using namespace std::chrono_literals;
+
+struct Tracked : tigerbeetle::Request {
+  tigerbeetle::tb_uint128_t id = 0;
+  std::atomic<int> replies{0};
+  std::atomic<uint8_t> status{0};
+  std::atomic<uint32_t> size{0};
+};
+
+void on_reply(tigerbeetle::Request *request, uint64_t, const uint8_t *,
+              uint32_t size) {
+  auto *tracked = static_cast<Tracked *>(request);
+  tracked->status = request->packet.status;
+  tracked->size = size;
+  tracked->replies.fetch_add(1);
+  tracked->replies.notify_all();
+}
+
+void prepare(Tracked &request, tigerbeetle::tb_uint128_t id) {
+  request.id = id;
+  request.packet = {};
+  request.packet.operation = tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS;
+  request.packet.data = &request.id;
+  request.packet.data_size = sizeof(request.id);
+  request.on_reply = &on_reply;
+}
+
+void wait_reply(Tracked &request) {
+  for (int seen = request.replies.load(); seen == 0;
+       seen = request.replies.load()) {
+    request.replies.wait(seen);
+  }
+}
+
+tigerbeetle::tb_packet_t lookup(tigerbeetle::tb_uint128_t &id,
+                                tigerbeetle::CompletionContext *ctx) {
+  tigerbeetle::tb_packet_t packet{};
+  packet.operation = tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS;
+  packet.data = &id;
+  packet.data_size = sizeof(id);
+  packet.user_data = ctx;
+  return packet;
+}
+
+// Keeps every request after the first one waiting for a token, standing in
+// for a cluster that does not answer.
+void stall(tigerbeetle::Client &client, Tracked &first) {
+  client.set_admission({.rate = 0.001, .burst = 1});
+  prepare(first, 1);
+  REQUIRE(client.submit(first) == tigerbeetle::TB_CLIENT_OK);
+  wait_reply(first);
+}
+} // namespace
+
+TEST_CASE("Replies within the deadline") {
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+  const auto deadline = std::chrono::steady_clock::now() + 10s;
+
+  Tracked request;
+  prepare(request, 42);
+  REQUIRE(client.submit(request, deadline) == tigerbeetle::TB_CLIENT_OK);
+  wait_reply(request);
+  REQUIRE(request.status == tigerbeetle::TB_PACKET_OK);
+  REQUIRE(request.size == sizeof(tigerbeetle::tb_uint128_t));
+
+  auto ctx = std::make_unique<tigerbeetle::CompletionContext>();
+  tigerbeetle::tb_uint128_t id = 7;
+  auto packet = lookup(id, ctx.get());
+  client.send_request(packet, ctx.get(), deadline);
+  REQUIRE(packet.status == tigerbeetle::TB_PACKET_OK);
+  REQUIRE(ctx->completed);
+  REQUIRE(ctx->size == sizeof(id));
+  tigerbeetle::tb_uint128_t echoed = 0;
+  std::memcpy(&echoed, ctx->reply.data(), sizeof(echoed));
+  REQUIRE(echoed == 7);
+  REQUIRE(client.in_flight() == 0);
+}
+
+TEST_CASE("Refusals leave the client usable") {
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+  client.set_admission({.rate = 0.001,
+                        .burst = 1,
+                        .policy = tigerbeetle::OverloadPolicy::fail_fast});
+  Tracked first;
+  prepare(first, 1);
+  REQUIRE(client.submit(first) == tigerbeetle::TB_CLIENT_OK);
+  wait_reply(first);
+
+  const auto deadline = std::chrono::steady_clock::now() + 10s;
+  auto ctx = std::make_unique<tigerbeetle::CompletionContext>();
+  tigerbeetle::tb_uint128_t id = 2;
+  auto packet = lookup(id, ctx.get());
+  client.send_request(packet, ctx.get(), deadline);
+  REQUIRE(packet.status == tigerbeetle::CLIENT_PACKET_REJECTED);
+  REQUIRE(client.clientStatus() == tigerbeetle::TB_CLIENT_OK);
+
+  client.set_admission({});
+  packet = lookup(id, ctx.get());
+  client.send_request(packet, ctx.get(), deadline);
+  REQUIRE(packet.status == tigerbeetle::TB_PACKET_OK);
+  REQUIRE(ctx->completed);
+}
+
+TEST_CASE("Deadlines free the caller") {
+  Tracked first;
+  Tracked late;
+  {
+    tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+    REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+    stall(client, first);
+
+    SUBCASE("Async") {
+      prepare(late, 2);
+      const auto start = std::chrono::steady_clock::now();
+      REQUIRE(client.submit(late, start + 20ms) == tigerbeetle::TB_CLIENT_OK);
+      wait_reply(late);
+      REQUIRE(std::chrono::steady_clock::now() - start >= 20ms);
+      REQUIRE(late.status == tigerbeetle::CLIENT_PACKET_TIMEOUT);
+      REQUIRE(client.queued() == 0); // Taken out of the queue
+    }
+
+    SUBCASE("Blocking") {
+      auto ctx = std::make_unique<tigerbeetle::CompletionContext>();
+      tigerbeetle::tb_uint128_t id = 2;
+      auto packet = lookup(id, ctx.get());
+      const auto start = std::chrono::steady_clock::now();
+      client.send_request(packet, ctx.get(), start + 20ms);
+      REQUIRE(std::chrono::steady_clock::now() - start >= 20ms);
+      REQUIRE(packet.status == tigerbeetle::CLIENT_PACKET_TIMEOUT);
+      REQUIRE_FALSE(ctx->completed);
+      ctx.reset(); // Nothing writes to it any more
+      REQUIRE(client.queued() == 0);
+    }
+  }
+  REQUIRE(late.replies <= 1);
+}
+
+TEST_CASE("Requests that time out in the queue are never sent") {
+  Tracked first;
+  Tracked late;
+  Tracked after;
+  std::atomic<int> late_sent{0};
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+  client.set_reply_observer([&late_sent](const tigerbeetle::tb_packet_t &packet,
+                                         const uint8_t *, uint32_t) {
+    tigerbeetle::tb_uint128_t id = 0;
+    std::memcpy(&id, packet.data, sizeof(id));
+    if (id == 3) {
+      late_sent.fetch_add(1);
+    }
+  });
+  stall(client, first);
+
+  SUBCASE("Async") {
+    prepare(late, 3);
+    const auto deadline = std::chrono::steady_clock::now() + 10ms;
+    REQUIRE(client.submit(late, deadline) == tigerbeetle::TB_CLIENT_OK);
+    wait_reply(late);
+    REQUIRE(late.status == tigerbeetle::CLIENT_PACKET_TIMEOUT);
+  }
+
+  SUBCASE("Blocking") {
+    auto ctx = std::make_unique<tigerbeetle::CompletionContext>();
+    tigerbeetle::tb_uint128_t id = 3;
+    auto packet = lookup(id, ctx.get());
+    client.send_request(packet, ctx.get(),
+                        std::chrono::steady_clock::now() + 10ms);
+    REQUIRE(packet.status == tigerbeetle::CLIENT_PACKET_TIMEOUT);
+  }
+
+  SUBCASE("Cancelled") {
+    std::stop_source source;
+    prepare(late, 3);
+    REQUIRE(client.submit(late, tigerbeetle::Deadline::max(),
+                          source.get_token()) == tigerbeetle::TB_CLIENT_OK);
+    source.request_stop();
+    REQUIRE(late.status == tigerbeetle::CLIENT_PACKET_CANCELLED);
+  }
+
+  REQUIRE(client.queued() == 0);
+  // Room again: the queue is FIFO, so had it stayed queued it would go out
+  // before `after`.
+  client.set_admission({.rate = 1000, .burst = 10});
+  prepare(after, 4);
+  REQUIRE(client.submit(after) == tigerbeetle::TB_CLIENT_OK);
+  wait_reply(after);
+  REQUIRE(after.status == tigerbeetle::TB_PACKET_OK);
+  REQUIRE(late_sent == 0);
+  REQUIRE(late.replies <= 1);
+}
+
+TEST_CASE("Cancellation") {
+  Tracked first;
+  Tracked request;
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+  stall(client, first);
+
+  SUBCASE("Async, on the cancelling thread") {
+    std::stop_source source;
+    prepare(request, 2);
+    REQUIRE(client.submit(request, tigerbeetle::Deadline::max(),
+                          source.get_token()) == tigerbeetle::TB_CLIENT_OK);
+    REQUIRE(request.replies == 0);
+    source.request_stop();
+    REQUIRE(request.replies == 1);
+    REQUIRE(request.status == tigerbeetle::CLIENT_PACKET_CANCELLED);
+  }
+
+  SUBCASE("Async, already cancelled") {
+    std::stop_source source;
+    source.request_stop();
+    prepare(request, 2);
+    REQUIRE(client.submit(request, tigerbeetle::Deadline::max(),
+                          source.get_token()) ==
+            tigerbeetle::TB_CLIENT_INVALID);
+    REQUIRE(request.packet.status == tigerbeetle::CLIENT_PACKET_CANCELLED);
+    REQUIRE(request.replies == 0);
+  }
+
+  SUBCASE("Blocking") {
+    std::stop_source source;
+    auto ctx = std::make_unique<tigerbeetle::CompletionContext>();
+    tigerbeetle::tb_uint128_t id = 2;
+    auto packet = lookup(id, ctx.get());
+    std::jthread canceller([&source] {
+      std::this_thread::sleep_for(10ms);
+      source.request_stop();
+    });
+    client.send_request(packet, ctx.get(), tigerbeetle::Deadline::max(),
+                        source.get_token());
+    REQUIRE(packet.status == tigerbeetle::CLIENT_PACKET_CANCELLED);
+    REQUIRE_FALSE(ctx->completed);
+  }
+}
@@ -0,0 +1,124 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <atomic>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <memory>
+#include <tb_pending.hpp>
+#include <vector>
+
+namespace {
+using namespace std::chrono_literals;
+
+struct Tracked : tigerbeetle::Request {
+  tigerbeetle::tb_uint128_t id = 0;
+  std::atomic<int> replies{0};
+  std::atomic<uint8_t> status{0};
+};
+
+void on_reply(tigerbeetle::Request *request, uint64_t, const uint8_t *,
+              uint32_t) {
+  auto *tracked = static_cast<Tracked *>(request);
+  tracked->status = request->packet.status;
+  tracked->replies.fetch_add(1);
+}
+
+void prepare(Tracked &request, tigerbeetle::tb_uint128_t id) {
+  request.id = id;
+  request.packet = {};
+  request.packet.operation = tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS;
+  request.packet.data = &request.id;
+  request.packet.data_size = sizeof(request.id);
+  request.on_reply = &on_reply;
+}
+} // namespace
+
+TEST_CASE("Drain waits for in-flight work") {
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+
+  std::vector<std::unique_ptr<Tracked>> requests;
+  for (int i = 0; i < 100; ++i) {
+    requests.push_back(std::make_unique<Tracked>());
+    prepare(*requests.back(), i + 1);
+    REQUIRE(client.submit(*requests.back()) == tigerbeetle::TB_CLIENT_OK);
+  }
+  auto report = client.drain(std::chrono::steady_clock::now() + 10s);
+  REQUIRE(report.drained);
+  REQUIRE(report.in_flight == 0);
+  REQUIRE(report.unsent == 0);
+  REQUIRE(report.elapsed < 10s);
+  for (auto &request : requests) {
+    REQUIRE(request->replies == 1);
+    REQUIRE(request->status == tigerbeetle::TB_PACKET_OK);
+  }
+  REQUIRE(client.native_handle() == nullptr);
+
+  // Closed for good.
+  Tracked late;
+  prepare(late, 1);
+  REQUIRE(client.submit(late) == tigerbeetle::TB_CLIENT_INVALID);
+  REQUIRE(late.packet.status == tigerbeetle::TB_PACKET_CLIENT_SHUTDOWN);
+  auto ctx = std::make_unique<tigerbeetle::CompletionContext>();
+  tigerbeetle::tb_packet_t packet{};
+  packet.operation = tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS;
+  packet.data = &late.id;
+  packet.data_size = sizeof(late.id);
+  packet.user_data = ctx.get();
+  client.send_request(packet, ctx.get());
+  REQUIRE(packet.status == tigerbeetle::TB_PACKET_CLIENT_SHUTDOWN);
+  REQUIRE_FALSE(ctx->completed);
+}
+
+TEST_CASE("Drain flushes batches first") {
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+
+  SUBCASE("Callbacks may still submit") {
+    Tracked buffered;
+    prepare(buffered, 1);
+    auto hook = client.on_drain([&] { client.submit(buffered); });
+    auto report = client.drain(std::chrono::steady_clock::now() + 10s);
+    REQUIRE(report.drained);
+    REQUIRE(buffered.replies == 1);
+    REQUIRE(buffered.status == tigerbeetle::TB_PACKET_OK);
+    client.remove_on_drain(hook);
+  }
+
+  SUBCASE("Removed callbacks do not run") {
+    bool ran = false;
+    client.remove_on_drain(client.on_drain([&] { ran = true; }));
+    client.drain(std::chrono::steady_clock::now() + 10s);
+    REQUIRE_FALSE(ran);
+  }
+
+  SUBCASE("Pending decisions") {
+    tigerbeetle::PendingTransferManager manager(client);
+    auto decision = manager.void_pending(2, 1);
+    REQUIRE(manager.queued() == 1);
+    client.drain(std::chrono::steady_clock::now() + 10s);
+    REQUIRE(manager.queued() == 0);
+    REQUIRE(decision.wait_for(0s) == std::future_status::ready);
+  }
+}
+
+TEST_CASE("Drain gives up at the deadline") {
+  Tracked first;
+  Tracked stuck;
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+  // Only the first request gets a token, the next one stays queued.
+  client.set_admission({.rate = 0.001, .burst = 1});
+  prepare(first, 1);
+  prepare(stuck, 2);
+  REQUIRE(client.submit(first) == tigerbeetle::TB_CLIENT_OK);
+  REQUIRE(client.submit(stuck) == tigerbeetle::TB_CLIENT_OK);
+
+  const auto start = std::chrono::steady_clock::now();
+  auto report = client.drain(start + 20ms);
+  REQUIRE(std::chrono::steady_clock::now() - start >= 20ms);
+  REQUIRE_FALSE(report.drained);
+  REQUIRE(report.unsent == 1);
+  REQUIRE(first.replies == 1);
+  REQUIRE(stuck.replies == 1);
+  REQUIRE(stuck.status == tigerbeetle::TB_PACKET_CLIENT_SHUTDOWN);
+}
@@ -0,0 +1,125 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <memory>
+#include <ranges>
+#include <tb_filter.hpp>
+#include <thread>
+#include <vector>
+
+namespace {
+using tigerbeetle::tb_uint128_t;
+
+tb_uint128_t id_of(uint64_t i) { return tb_uint128_t{i} << 64 | (i * 7); }
+} // namespace
+
+TEST_CASE("Id filter") {
+  constexpr uint64_t count = 100000;
+  const auto bytes = tigerbeetle::IdFilter::bytes_for(count, 0.01);
+  REQUIRE(bytes < count * 2);
+  tigerbeetle::IdFilter filter(bytes);
+  REQUIRE(filter.memory() <= bytes);
+
+  SUBCASE("No false negatives") {
+    filter.insert(std::views::iota(uint64_t{0}, count) |
+                  std::views::transform(id_of));
+    for (uint64_t i = 0; i < count; ++i) {
+      REQUIRE(filter.may_contain(id_of(i)));
+    }
+    std::size_t false_positives = 0;
+    for (uint64_t i = count; i < 11 * count; ++i) {
+      false_positives += filter.may_contain(id_of(i));
+    }
+    REQUIRE(false_positives < count / 10 * 2); // Under 2%
+
+    filter.clear();
+    REQUIRE_FALSE(filter.may_contain(id_of(1)));
+  }
+
+  SUBCASE("Concurrent inserts") {
+    std::vector<std::jthread> threads;
+    for (uint64_t t = 0; t < 4; ++t) {
+      threads.emplace_back([&filter, t] {
+        for (uint64_t i = t; i < count; i += 4) {
+          filter.insert(id_of(i));
+          REQUIRE(filter.may_contain(id_of(i)));
+        }
+      });
+    }
+    threads.clear();
+    for (uint64_t i = 0; i < count; ++i) {
+      REQUIRE(filter.may_contain(id_of(i)));
+    }
+  }
+}
+
+TEST_CASE("Create replies") {
+  tigerbeetle::IdFilter filter(1 << 16);
+  std::vector<tigerbeetle::tb_transfer_t> transfers(6);
+  for (uint64_t i = 0; i < transfers.size(); ++i) {
+    transfers[i].id = id_of(1000 + i);
+  }
+  // 1 failed, 3 was already there, 4 failed with its chain.
+  const std::vector<tigerbeetle::tb_create_transfers_result_t> results = {
+      {1, tigerbeetle::TB_CREATE_TRANSFER_DEBIT_ACCOUNT_NOT_FOUND},
+      {3, tigerbeetle::TB_CREATE_TRANSFER_EXISTS},
+      {4, tigerbeetle::TB_CREATE_TRANSFER_LINKED_EVENT_FAILED}};
+
+  tigerbeetle::tb_packet_t packet{};
+  packet.operation = tigerbeetle::TB_OPERATION_CREATE_TRANSFERS;
+  packet.data = transfers.data();
+  packet.data_size = static_cast<uint32_t>(
+      transfers.size() * sizeof(tigerbeetle::tb_transfer_t));
+  const auto *reply = reinterpret_cast<const uint8_t *>(results.data());
+  const auto reply_size = static_cast<uint32_t>(
+      results.size() * sizeof(tigerbeetle::tb_create_transfers_result_t));
+
+  SUBCASE("Committed") {
+    filter.record_reply(packet, reply, reply_size);
+    const bool committed[] = {true, false, true, true, false, true};
+    for (std::size_t i = 0; i < transfers.size(); ++i) {
+      REQUIRE(filter.may_contain(transfers[i].id) == committed[i]);
+    }
+  }
+
+  SUBCASE("Failed packets") {
+    packet.status = tigerbeetle::TB_PACKET_CLIENT_SHUTDOWN;
+    filter.record_reply(packet, reply, reply_size);
+    for (const auto &t : transfers) {
+      REQUIRE_FALSE(filter.may_contain(t.id));
+    }
+  }
+
+  SUBCASE("Attached") {
+    // Lookups go through the observer untouched.
+    tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+    REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+    filter.attach(client);
+    auto ctx = std::make_unique<tigerbeetle::CompletionContext>();
+    tb_uint128_t id = transfers[0].id;
+    tigerbeetle::tb_packet_t lookup{};
+    lookup.operation = tigerbeetle::TB_OPERATION_LOOKUP_TRANSFERS;
+    lookup.data = &id;
+    lookup.data_size = sizeof(id);
+    lookup.user_data = ctx.get();
+    client.send_request(lookup, ctx.get());
+    REQUIRE(lookup.status == tigerbeetle::TB_PACKET_OK);
+    REQUIRE_FALSE(filter.may_contain(id));
+
+    // Echoed accounts read as create results: the zero id of the first one
+    // fails it with index 0, the ids of the others are out of range.
+    std::vector<tigerbeetle::tb_account_t> accounts(3);
+    accounts[1].id = 5;
+    accounts[2].id = 6;
+    tigerbeetle::tb_packet_t create{};
+    create.operation = tigerbeetle::TB_OPERATION_CREATE_ACCOUNTS;
+    create.data = accounts.data();
+    create.data_size =
+        static_cast<uint32_t>(accounts.size() * sizeof(accounts[0]));
+    create.user_data = ctx.get();
+    client.send_request(create, ctx.get());
+    REQUIRE(create.status == tigerbeetle::TB_PACKET_OK);
+    REQUIRE_FALSE(filter.may_contain(0));
+    REQUIRE(filter.may_contain(5));
+    REQUIRE(filter.may_contain(6));
+  }
+}
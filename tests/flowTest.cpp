@@ -0,0 +1,119 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <chrono>
+#include <stdexcept>
+#include <tb_pipeline.hpp>
+
+TEST_CASE("Flow") {
+  SUBCASE("Stages start waiting") {
+    tigerbeetle::Flow flow;
+    tigerbeetle::account<2> accounts = tigerbeetle::make_account<2>();
+    auto create = flow.add(tigerbeetle::TB_OPERATION_CREATE_ACCOUNTS, accounts);
+    tigerbeetle::accountID<2> ids = {1, 2};
+    auto lookup =
+        flow.add(tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS, ids, {create});
+    REQUIRE(flow.size() == 2);
+    REQUIRE(flow.status(create) == tigerbeetle::StageStatus::waiting);
+    REQUIRE(flow.status(lookup) == tigerbeetle::StageStatus::waiting);
+    REQUIRE(flow.reply<tigerbeetle::tb_account_t>(lookup).empty());
+    REQUIRE_FALSE(flow.done());
+  }
+
+  SUBCASE("Prerequisites must already exist") {
+    tigerbeetle::Flow flow;
+    tigerbeetle::accountID<1> ids = {1};
+    bool thrown = false;
+    try {
+      flow.add(tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS, ids, {0});
+    } catch (const std::out_of_range &) {
+      thrown = true;
+    }
+    REQUIRE(thrown);
+    REQUIRE(flow.size() == 0);
+  }
+
+  SUBCASE("Payload can be prepared late") {
+    tigerbeetle::Flow flow;
+    auto stage = flow.add(tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS,
+                          tigerbeetle::Flow::Prepare{});
+    tigerbeetle::accountID<3> ids = {1, 2, 3};
+    flow.set_payload(stage, ids);
+    REQUIRE(flow.status(stage) == tigerbeetle::StageStatus::waiting);
+  }
+
+  SUBCASE("Empty flows do not start") {
+    tigerbeetle::Flow flow;
+    tigerbeetle::Client client("3001");
+    REQUIRE_FALSE(flow.start(client));
+  }
+}
+
+TEST_CASE("Flow execution") {
+  using namespace std::chrono_literals;
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+  tigerbeetle::Flow flow;
+
+  SUBCASE("Dependents start after their prerequisite") {
+    tigerbeetle::accountID<2> ids = {7, 8};
+    auto first = flow.add(tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS, ids);
+    tigerbeetle::StageStatus seen = tigerbeetle::StageStatus::waiting;
+    std::size_t seen_reply = 0;
+    auto second = flow.add(
+        tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS,
+        [&](tigerbeetle::Flow &f, tigerbeetle::Flow::StageId stage) {
+          seen = f.status(first);
+          auto echoed = f.reply<tigerbeetle::tb_uint128_t>(first);
+          seen_reply = echoed.size();
+          f.set_payload(stage, echoed);
+        },
+        {first});
+    REQUIRE(flow.start(client));
+    REQUIRE(flow.wait_for(10s));
+    CHECK(seen == tigerbeetle::StageStatus::succeeded);
+    CHECK(seen_reply == 2);
+    CHECK(flow.succeeded());
+    auto echoed = flow.reply<tigerbeetle::tb_uint128_t>(second);
+    REQUIRE(echoed.size() == 2);
+    CHECK(echoed[0] == 7);
+    CHECK(echoed[1] == 8);
+  }
+
+  SUBCASE("A failed stage skips its dependents") {
+    // The echo reply of a create_* lists every event, as if all failed.
+    auto accounts = tigerbeetle::make_account<1>();
+    auto create = flow.add(tigerbeetle::TB_OPERATION_CREATE_ACCOUNTS, accounts);
+    bool prepared = false;
+    auto lookup = flow.add(
+        tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS,
+        [&](tigerbeetle::Flow &, tigerbeetle::Flow::StageId) {
+          prepared = true;
+        },
+        {create});
+    tigerbeetle::accountID<1> ids = {1};
+    auto after = flow.add(tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS, ids,
+                          {lookup});
+    REQUIRE(flow.start(client));
+    REQUIRE(flow.wait_for(10s));
+    CHECK(flow.status(create) == tigerbeetle::StageStatus::failed);
+    CHECK(flow.status(lookup) == tigerbeetle::StageStatus::skipped);
+    CHECK(flow.status(after) == tigerbeetle::StageStatus::skipped);
+    CHECK_FALSE(prepared);
+    CHECK_FALSE(flow.succeeded());
+  }
+
+  SUBCASE("Refusals keep their status") {
+    client.set_admission({.rate = 0.001,
+                          .burst = 1,
+                          .policy = tigerbeetle::OverloadPolicy::fail_fast});
+    tigerbeetle::accountID<1> ids = {1};
+    auto admitted = flow.add(tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS, ids);
+    auto refused = flow.add(tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS, ids);
+    REQUIRE(flow.start(client));
+    REQUIRE(flow.wait_for(10s));
+    CHECK(flow.status(admitted) == tigerbeetle::StageStatus::succeeded);
+    CHECK(flow.status(refused) == tigerbeetle::StageStatus::failed);
+    CHECK(flow.packet_status(refused) ==
+          tigerbeetle::CLIENT_PACKET_REJECTED);
+  }
+}
@@ -0,0 +1,180 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <random>
+#include <string>
+#include <tb_format.hpp>
+#include <vector>
+
+namespace {
+using tigerbeetle::tb_uint128_t;
+
+constexpr tb_uint128_t max_u128 = ~tb_uint128_t{0};
+
+std::string reference_decimal(tb_uint128_t value) {
+  std::string digits;
+  do {
+    digits.insert(digits.begin(), static_cast<char>('0' + value % 10));
+    value /= 10;
+  } while (value != 0);
+  return digits;
+}
+
+std::string encode(tb_uint128_t value, int base = 10) {
+  char buffer[tigerbeetle::MAX_DECIMAL_DIGITS];
+  auto [end, error] = tigerbeetle::to_chars(
+      buffer, buffer + sizeof(buffer), value, base);
+  REQUIRE(error == std::errc{});
+  return std::string(buffer, end);
+}
+
+tigerbeetle::tb_transfer_t sample_transfer() {
+  tigerbeetle::tb_transfer_t transfer{};
+  transfer.id = max_u128;
+  transfer.debit_account_id = 1;
+  transfer.credit_account_id = 2;
+  transfer.amount = 100;
+  transfer.ledger = 700;
+  transfer.code = 10;
+  transfer.timestamp = 42;
+  return transfer;
+}
+} // namespace
+
+TEST_CASE("128-bit decimal and hex") {
+  const tb_uint128_t ten19 = 10000000000000000000ULL;
+  const tb_uint128_t edges[] = {0,
+                                9,
+                                10,
+                                ten19 - 1,
+                                ten19,
+                                ~uint64_t{0},
+                                tb_uint128_t{1} << 64,
+                                ten19 * ten19 - 1,
+                                ten19 * ten19,
+                                max_u128};
+  for (auto value : edges) {
+    REQUIRE(encode(value) == reference_decimal(value));
+  }
+  REQUIRE(encode(max_u128) == "340282366920938463463374607431768211455");
+  REQUIRE(encode(0, 16) == "0");
+  REQUIRE(encode(255, 16) == "ff");
+  REQUIRE(encode(max_u128, 16) == std::string(32, 'f'));
+
+  std::mt19937_64 rng(7);
+  for (int i = 0; i < 10000; ++i) {
+    const tb_uint128_t value = tb_uint128_t{rng()} << (rng() % 65) ^ rng();
+    const auto text = encode(value);
+    REQUIRE(text == reference_decimal(value));
+    REQUIRE(tigerbeetle::parse_uint128(text) == value);
+    REQUIRE(tigerbeetle::parse_uint128(encode(value, 16), 16) == value);
+  }
+
+  SUBCASE("Parse errors") {
+    tb_uint128_t value = 5;
+    const std::string overflow = "340282366920938463463374607431768211456;";
+    auto [end, error] = tigerbeetle::from_chars(
+        overflow.data(), overflow.data() + overflow.size(), value);
+    REQUIRE(error == std::errc::result_out_of_range);
+    REQUIRE(*end == ';');
+    REQUIRE(value == 5);
+
+    REQUIRE_FALSE(tigerbeetle::parse_uint128(""));
+    REQUIRE_FALSE(tigerbeetle::parse_uint128("-1"));
+    REQUIRE_FALSE(tigerbeetle::parse_uint128("12a"));
+    REQUIRE_FALSE(tigerbeetle::parse_uint128("1" + std::string(32, '0'), 16));
+    REQUIRE(tigerbeetle::parse_uint128("000" + encode(max_u128)) == max_u128);
+    REQUIRE(tigerbeetle::parse_uint128("DeadBeef", 16) == 0xdeadbeef);
+  }
+
+  SUBCASE("Short buffers") {
+    char buffer[3];
+    auto [end, error] =
+        tigerbeetle::to_chars(buffer, buffer + sizeof(buffer), 1000);
+    REQUIRE(error == std::errc::value_too_large);
+    REQUIRE(end == buffer + sizeof(buffer));
+  }
+}
+
+TEST_CASE("Records") {
+  const auto transfer = sample_transfer();
+  char buffer[tigerbeetle::max_text_size<tigerbeetle::tb_transfer_t>()];
+  std::string fields(buffer, tigerbeetle::write_fields(buffer, transfer));
+  REQUIRE(fields.rfind("id=" + encode(max_u128) +
+                           " debit_account_id=1 credit_account_id=2 amount=100",
+                       0) == 0);
+  REQUIRE(fields.find(" ledger=700 code=10 flags=0 timestamp=42") !=
+          std::string::npos);
+
+  using Result = tigerbeetle::tb_create_transfers_result_t;
+  REQUIRE(tigerbeetle::csv_header<Result>() == "index,result");
+  [[maybe_unused]] const auto exists =
+      std::to_string(tigerbeetle::TB_CREATE_TRANSFER_EXISTS);
+  // Not a code of the enum: printed as its number.
+  [[maybe_unused]] const auto unknown =
+      static_cast<tigerbeetle::TB_CREATE_TRANSFER_RESULT>(65000);
+
+  SUBCASE("Code names") {
+    REQUIRE(tigerbeetle::enum_name(tigerbeetle::TB_CREATE_TRANSFER_EXISTS) ==
+            "exists");
+    REQUIRE(tigerbeetle::enum_name(tigerbeetle::TB_CREATE_ACCOUNT_OK) == "ok");
+    REQUIRE(tigerbeetle::enum_name(tigerbeetle::TB_PACKET_TOO_MUCH_DATA) ==
+            "too_much_data");
+    REQUIRE(tigerbeetle::enum_name(
+                tigerbeetle::TB_OPERATION_CREATE_TRANSFERS) ==
+            "create_transfers");
+    REQUIRE(tigerbeetle::enum_name(static_cast<tigerbeetle::TB_PACKET_STATUS>(
+                tigerbeetle::CLIENT_PACKET_TIMEOUT)) == "timeout");
+    REQUIRE(tigerbeetle::enum_name(unknown).empty());
+  }
+
+  SUBCASE("Bulk encoders") {
+    std::vector<tigerbeetle::tb_transfer_t> transfers(3, transfer);
+    std::string csv = tigerbeetle::csv_header<tigerbeetle::tb_transfer_t>();
+    csv += '\n';
+    tigerbeetle::append_csv(csv, transfers);
+    const std::string row =
+        encode(max_u128) + ",1,2,100,0,0,0,0,0,700,10,0,42\n";
+    REQUIRE(csv == "id,debit_account_id,credit_account_id,amount,pending_id,"
+                   "user_data_128,user_data_64,user_data_32,timeout,ledger,"
+                   "code,flags,timestamp\n" +
+                       row + row + row);
+
+    std::vector<tb_uint128_t> ids = {1, max_u128, 0};
+    std::string text = "ids:";
+    tigerbeetle::append_decimal(text, ids, ' ');
+    REQUIRE(text == "ids:1 " + encode(max_u128) + " 0 ");
+  }
+
+#if defined(__cpp_lib_format)
+  SUBCASE("std::format") {
+    REQUIRE(std::format("{}", transfer) == fields);
+    REQUIRE(std::format("{:c}", transfer) ==
+            encode(max_u128) + ",1,2,100,0,0,0,0,0,700,10,0,42");
+    const Result result{3, tigerbeetle::TB_CREATE_TRANSFER_EXISTS};
+    REQUIRE(std::format("{}", result) == "index=3 result=" + exists);
+    REQUIRE(std::format("{}", tigerbeetle::TB_CREATE_TRANSFER_EXISTS) ==
+            "exists");
+    REQUIRE(std::format("{:d}", tigerbeetle::TB_CREATE_TRANSFER_EXISTS) ==
+            exists);
+    REQUIRE(std::format("{}", unknown) == "65000");
+    REQUIRE(std::format("{}", tigerbeetle::CLIENT_PACKET_SHED) == "shed");
+  }
+#endif
+
+#if defined(USE_FMT)
+  SUBCASE("fmt") {
+    REQUIRE(fmt::format("{}", transfer) == fields);
+    REQUIRE(fmt::format("{:c}", transfer) ==
+            encode(max_u128) + ",1,2,100,0,0,0,0,0,700,10,0,42");
+    const Result result{3, tigerbeetle::TB_CREATE_TRANSFER_EXISTS};
+    REQUIRE(fmt::format("{}", result) == "index=3 result=" + exists);
+    REQUIRE(fmt::format("{}", tigerbeetle::TB_CREATE_TRANSFER_EXISTS) ==
+            "exists");
+    REQUIRE(fmt::format("{:d}", tigerbeetle::TB_CREATE_TRANSFER_EXISTS) ==
+            exists);
+    REQUIRE(fmt::format("{}", unknown) == "65000");
+    REQUIRE(fmt::format("{}", tigerbeetle::CLIENT_PACKET_SHED) == "shed");
+    REQUIRE(fmt::format("{}", max_u128) == encode(max_u128));
+  }
+#endif
+}
@@ -0,0 +1,59 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <tb_memory.hpp>
+#include <tb_numa.hpp>
+
+// NUMA node the page at addr is resident on, -1 when the kernel cannot tell
+// (no NUMA support, or not Linux).
+static int page_node([[maybe_unused]] void *addr) {
+#if defined(__linux__) && defined(SYS_get_mempolicy)
+  constexpr unsigned long MPOL_F_NODE_ADDR = 1 | 2; // MPOL_F_NODE|MPOL_F_ADDR
+  int node = -1;
+  if (syscall(SYS_get_mempolicy, &node, nullptr, 0UL, addr,
+              MPOL_F_NODE_ADDR) == 0) {
+    return node;
+  }
+#endif
+  return -1;
+}
+
+TEST_CASE("Huge Page Resource") {
+  SUBCASE("Allocations are huge page aligned and writable") {
+    tigerbeetle::HugePageResource huge;
+    void *ptr = huge.allocate(tigerbeetle::MAX_MESSAGE_SIZE);
+    REQUIRE(ptr != nullptr);
+#if defined(__linux__)
+    REQUIRE(reinterpret_cast<uintptr_t>(ptr) %
+                tigerbeetle::HUGE_PAGE_SIZE ==
+            0);
+    REQUIRE(huge.hugetlb_mappings() + huge.fallback_mappings() == 1);
+#endif
+    std::memset(ptr, 0xab, tigerbeetle::MAX_MESSAGE_SIZE);
+    huge.deallocate(ptr, tigerbeetle::MAX_MESSAGE_SIZE);
+  }
+
+  SUBCASE("Backs pooled reply buffers on the current node") {
+    tigerbeetle::HugePageResource huge(
+        {.node = tigerbeetle::current_numa_node()});
+    std::pmr::unsynchronized_pool_resource pool(
+        tigerbeetle::message_pool_options(), &huge);
+    tigerbeetle::ReplyBuffer reply(tigerbeetle::MAX_MESSAGE_SIZE, uint8_t{7},
+                                   &pool);
+    REQUIRE(reply.back() == 7);
+    // Ask the kernel where the buffer's pages were placed, rather than
+    // reading back the option set above.
+    const int node = page_node(reply.data());
+    if (node < 0) {
+      MESSAGE("NUMA placement unavailable, not checked");
+    } else {
+      REQUIRE(node == huge.node());
+      REQUIRE(page_node(reply.data() + reply.size() - 1) == huge.node());
+    }
+  }
+
+  SUBCASE("Node affinity can be restored") {
+    tigerbeetle::NodeAffinity pin(tigerbeetle::current_numa_node());
+    pin.restore();
+    REQUIRE_FALSE(pin.pinned());
+  }
+}
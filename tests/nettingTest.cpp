@@ -0,0 +1,270 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <cstring>
+#include <limits>
+#include <tb_netting.hpp>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace {
+tigerbeetle::tb_transfer_t leg(tigerbeetle::tb_uint128_t id,
+                               tigerbeetle::tb_uint128_t debit,
+                               tigerbeetle::tb_uint128_t credit,
+                               tigerbeetle::tb_uint128_t amount,
+                               uint32_t ledger = 1, uint16_t code = 1) {
+  tigerbeetle::tb_transfer_t transfer{};
+  transfer.id = id;
+  transfer.debit_account_id = debit;
+  transfer.credit_account_id = credit;
+  transfer.amount = amount;
+  transfer.ledger = ledger;
+  transfer.code = code;
+  return transfer;
+}
+
+std::vector<tigerbeetle::tb_uint128_t>
+carriers(const tigerbeetle::NettingPlan &plan) {
+  std::vector<tigerbeetle::tb_uint128_t> ids;
+  for (const auto &entry : plan.audit) {
+    ids.push_back(entry.net_id);
+  }
+  return ids;
+}
+} // namespace
+
+TEST_CASE("Leg netter") {
+  tigerbeetle::LegNetter netter;
+  tigerbeetle::NettingPlan plan;
+
+  SUBCASE("Opposing legs collapse") {
+    netter.add(leg(1, 10, 20, 100));
+    netter.add(leg(2, 20, 10, 30));
+    netter.add(leg(3, 20, 10, 50));
+    netter.add(leg(4, 10, 20, 5));
+    netter.take(plan);
+    REQUIRE(plan.transfers.size() == 1);
+    CHECK(plan.transfers[0].id == 1);
+    CHECK(plan.transfers[0].debit_account_id == 10);
+    CHECK(plan.transfers[0].credit_account_id == 20);
+    CHECK(plan.transfers[0].amount == 25);
+    CHECK(carriers(plan) ==
+          std::vector<tigerbeetle::tb_uint128_t>{1, 1, 1, 1});
+    CHECK(netter.empty());
+  }
+
+  SUBCASE("The winning direction names the net transfer") {
+    netter.add(leg(1, 10, 20, 10));
+    netter.add(leg(2, 20, 10, 40));
+    netter.take(plan);
+    REQUIRE(plan.transfers.size() == 1);
+    CHECK(plan.transfers[0].id == 2);
+    CHECK(plan.transfers[0].debit_account_id == 20);
+    CHECK(plan.transfers[0].amount == 30);
+  }
+
+  SUBCASE("Exact offset sends nothing") {
+    netter.add(leg(1, 10, 20, 70));
+    netter.add(leg(2, 20, 10, 70));
+    netter.take(plan);
+    CHECK(plan.transfers.empty());
+    REQUIRE(plan.audit.size() == 2);
+    CHECK(plan.audit[0].net_id == 0);
+    CHECK(plan.audit[1].transfer == tigerbeetle::NettedLeg::no_transfer);
+  }
+
+  SUBCASE("Ledger and code keep pairs apart") {
+    netter.add(leg(1, 10, 20, 5, 1, 1));
+    netter.add(leg(2, 20, 10, 5, 2, 1));
+    netter.add(leg(3, 20, 10, 5, 1, 2));
+    netter.take(plan);
+    CHECK(plan.transfers.size() == 3);
+    CHECK(carriers(plan) ==
+          std::vector<tigerbeetle::tb_uint128_t>{1, 2, 3});
+  }
+
+  SUBCASE("Ineligible legs pass through after the nets") {
+    auto pending = leg(1, 10, 20, 5);
+    pending.flags = tigerbeetle::TB_TRANSFER_PENDING;
+    auto linked = leg(2, 10, 20, 5);
+    linked.flags = tigerbeetle::TB_TRANSFER_LINKED;
+    netter.add(pending);
+    netter.add(linked);
+    netter.add(leg(3, 10, 20, 5));
+    netter.add(leg(4, 10, 10, 5));
+    netter.take(plan);
+    REQUIRE(plan.transfers.size() == 4);
+    CHECK(plan.transfers[0].id == 3);
+    CHECK(plan.transfers[1].id == 1);
+    CHECK(plan.transfers[1].flags == tigerbeetle::TB_TRANSFER_PENDING);
+    CHECK(plan.transfers[2].id == 2);
+    CHECK(plan.transfers[3].id == 4);
+    CHECK(carriers(plan) ==
+          std::vector<tigerbeetle::tb_uint128_t>{1, 2, 3, 4});
+    CHECK(plan.audit[0].transfer == 1);
+  }
+
+  SUBCASE("Overflowing legs pass through") {
+    const auto max = std::numeric_limits<tigerbeetle::tb_uint128_t>::max();
+    netter.add(leg(1, 10, 20, max));
+    netter.add(leg(2, 10, 20, 1));
+    netter.take(plan);
+    REQUIRE(plan.transfers.size() == 2);
+    CHECK(plan.transfers[0].amount == max);
+    CHECK(plan.transfers[1].id == 2);
+    CHECK(plan.audit[1].net_id == 2);
+  }
+
+  SUBCASE("Repeated ids pass through with their first leg") {
+    netter.add(leg(1, 10, 20, 100));
+    netter.add(leg(2, 10, 20, 7));
+    netter.add(leg(3, 20, 10, 30));
+    netter.add(leg(1, 10, 20, 100)); // Retry
+    netter.add(leg(3, 20, 10, 31));  // Same id, different amount
+    netter.take(plan);
+    REQUIRE(plan.transfers.size() == 5);
+    // Only leg 2 is left to net.
+    CHECK(plan.transfers[0].id == 2);
+    CHECK(plan.transfers[0].amount == 7);
+    CHECK(plan.transfers[1].id == 1);
+    CHECK(plan.transfers[2].id == 3);
+    CHECK(plan.transfers[2].amount == 30);
+    CHECK(plan.transfers[3].id == 1);
+    CHECK(plan.transfers[4].amount == 31);
+    CHECK(carriers(plan) ==
+          std::vector<tigerbeetle::tb_uint128_t>{1, 2, 3, 1, 3});
+    CHECK(plan.audit[0].transfer == 1);
+    CHECK(plan.audit[3].transfer == 3);
+  }
+
+  SUBCASE("Many pairs") {
+    constexpr uint64_t pairs = 5000;
+    for (uint64_t round = 0; round < 3; ++round) {
+      for (uint64_t p = 0; p < pairs; ++p) {
+        const auto id = round * pairs + p + 1;
+        netter.add(round == 1 ? leg(id, 2 * p + 2, 2 * p + 1, 1)
+                              : leg(id, 2 * p + 1, 2 * p + 2, 2));
+      }
+    }
+    REQUIRE(netter.size() == 3 * pairs);
+    netter.take(plan);
+    REQUIRE(plan.transfers.size() == pairs);
+    bool netted = true;
+    for (uint64_t p = 0; p < pairs; ++p) {
+      const auto &net = plan.transfers[p];
+      netted = netted && net.id == p + 1 && net.amount == 3 &&
+               net.debit_account_id == 2 * p + 1;
+    }
+    CHECK(netted);
+    // The table is reused by the next window.
+    netter.add(leg(1, 1, 2, 1));
+    netter.take(plan);
+    CHECK(plan.transfers.size() == 1);
+  }
+}
+
+TEST_CASE("Netting stage") {
+  using Clock = tigerbeetle::NettingStage::Clock;
+  tigerbeetle::Client client("3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+
+  std::vector<tigerbeetle::tb_account_t> accounts(2);
+  accounts[0].id = 9101;
+  accounts[1].id = 9102;
+  for (auto &account : accounts) {
+    account.ledger = 1;
+    account.code = 1;
+  }
+  auto ctx = std::make_unique<tigerbeetle::CompletionContext>();
+  tigerbeetle::tb_packet_t packet{};
+  packet.operation = tigerbeetle::TB_OPERATION_CREATE_ACCOUNTS;
+  packet.data = accounts.data();
+  packet.data_size =
+      static_cast<uint32_t>(accounts.size() * sizeof(accounts[0]));
+  packet.user_data = ctx.get();
+  client.send_request(packet, ctx.get());
+  REQUIRE(packet.status == tigerbeetle::TB_PACKET_OK);
+
+  std::vector<tigerbeetle::NettingReport> reports;
+  tigerbeetle::NettingStage stage(
+      client, {.linger = 10ms},
+      [&](const tigerbeetle::NettingReport &report) {
+        reports.push_back(report);
+      });
+  const auto start = Clock::now();
+
+  SUBCASE("Window closes after the linger time") {
+    stage.add(leg(9201, 9101, 9102, 100), start);
+    stage.add(leg(9202, 9102, 9101, 40), start + 5ms);
+    CHECK(stage.pending() == 2);
+    CHECK(stage.poll(start + 9ms) == 0);
+    CHECK(stage.poll(start + 10ms) == 2);
+    CHECK(stage.pending() == 0);
+
+    REQUIRE(reports.size() == 1);
+    const auto &report = reports[0];
+    CHECK(report.ok());
+    REQUIRE(report.transfers.size() == 1);
+    CHECK(report.transfers[0].amount == 60);
+    CHECK(report.result_of(1).ok());
+
+    const auto stats = stage.stats();
+    CHECK(stats.legs == 2);
+    CHECK(stats.transfers == 1);
+    CHECK(stats.windows == 1);
+
+    // The net transfer is what the cluster committed.
+    tigerbeetle::tb_uint128_t id = 9201;
+    packet = tigerbeetle::tb_packet_t{};
+    packet.operation = tigerbeetle::TB_OPERATION_LOOKUP_TRANSFERS;
+    packet.data = &id;
+    packet.data_size = sizeof(id);
+    packet.user_data = ctx.get();
+    client.send_request(packet, ctx.get());
+    REQUIRE(ctx->size == sizeof(tigerbeetle::tb_transfer_t));
+    tigerbeetle::tb_transfer_t committed;
+    std::memcpy(&committed, ctx->reply.data(), sizeof(committed));
+    CHECK(committed.amount == 60);
+  }
+
+  SUBCASE("A late leg closes the window") {
+    stage.add(leg(9211, 9101, 9102, 1), start);
+    CHECK(reports.empty());
+    stage.add(leg(9212, 9101, 9102, 1), start + 20ms);
+    REQUIRE(reports.size() == 1);
+    CHECK(reports[0].audit.size() == 2);
+    CHECK(reports[0].transfers.size() == 1);
+  }
+
+  SUBCASE("Failures map back to the legs") {
+    stage.add(leg(9221, 9101, 9999, 1), start);
+    stage.add(leg(9222, 9101, 9102, 1), start);
+    stage.flush();
+    REQUIRE(reports.size() == 1);
+    const auto &report = reports[0];
+    CHECK_FALSE(report.ok());
+    CHECK(report.result_of(0).result ==
+          tigerbeetle::TB_CREATE_TRANSFER_CREDIT_ACCOUNT_NOT_FOUND);
+    CHECK(report.result_of(1).ok());
+  }
+
+  SUBCASE("A retried leg is created once") {
+    stage.add(leg(9241, 9101, 9102, 5), start);
+    stage.add(leg(9242, 9102, 9101, 2), start);
+    stage.add(leg(9241, 9101, 9102, 5), start);
+    stage.flush();
+    REQUIRE(reports.size() == 1);
+    const auto &report = reports[0];
+    CHECK(report.result_of(0).ok());
+    CHECK(report.result_of(1).ok());
+    CHECK(report.result_of(2).result ==
+          tigerbeetle::TB_CREATE_TRANSFER_EXISTS);
+  }
+
+  SUBCASE("Drain flushes the open window") {
+    stage.add(leg(9231, 9101, 9102, 1), start);
+    client.drain(Clock::now() + 1s);
+    CHECK(reports.size() == 1);
+    CHECK(stage.pending() == 0);
+  }
+}
@@ -0,0 +1,217 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <memory>
+#include <mutex>
+#include <tb_pending.hpp>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Timer Wheel") {
+  using Wheel = tigerbeetle::TimerWheel<int>;
+  const auto start = Wheel::time_point{} + 1h;
+
+  SUBCASE("Fires in deadline order") {
+    Wheel wheel(10ms, 8, start);
+    wheel.schedule(3, start + 35ms);
+    wheel.schedule(1, start + 5ms);
+    wheel.schedule(2, start + 15ms);
+    REQUIRE(wheel.size() == 3);
+
+    std::vector<int> fired;
+    auto collect = [&](int key) { fired.push_back(key); };
+    REQUIRE(wheel.advance(start + 9ms, collect) == 0);
+    REQUIRE(wheel.advance(start + 10ms, collect) == 1);
+    REQUIRE(wheel.advance(start + 40ms, collect) == 2);
+    REQUIRE(fired == std::vector<int>{1, 2, 3});
+    REQUIRE(wheel.empty());
+  }
+
+  SUBCASE("Deadlines beyond one revolution") {
+    Wheel wheel(10ms, 4, start);
+    wheel.schedule(1, start + 10ms);
+    wheel.schedule(2, start + 50ms); // Same slot, next round
+
+    std::vector<int> fired;
+    auto collect = [&](int key) { fired.push_back(key); };
+    REQUIRE(wheel.advance(start + 20ms, collect) == 1);
+    REQUIRE(fired == std::vector<int>{1});
+    REQUIRE(wheel.advance(start + 49ms, collect) == 0);
+    REQUIRE(wheel.advance(start + 1s, collect) == 1);
+    REQUIRE(fired == std::vector<int>{1, 2});
+  }
+
+  SUBCASE("Past deadlines fire on the next advance") {
+    Wheel wheel(10ms, 8, start);
+    wheel.advance(start + 100ms, [](int) {});
+    wheel.schedule(7, start);
+    int fired = 0;
+    REQUIRE(wheel.advance(start + 100ms, [&](int) { ++fired; }) == 1);
+    REQUIRE(fired == 1);
+  }
+}
+
+TEST_CASE("Pending Transfer Manager") {
+  using Clock = tigerbeetle::PendingTransferManager::Clock;
+  tigerbeetle::Client client("3001");
+  tigerbeetle::PendingTransferManager manager(client,
+                                              {.tick = 100ms, .linger = 0ms});
+
+  auto pending = [](tigerbeetle::tb_uint128_t id, uint32_t timeout) {
+    tigerbeetle::tb_transfer_t transfer{};
+    transfer.id = id;
+    transfer.debit_account_id = 1;
+    transfer.credit_account_id = 2;
+    transfer.amount = 100;
+    transfer.ledger = 1;
+    transfer.code = 1;
+    transfer.flags = tigerbeetle::TB_TRANSFER_PENDING;
+    transfer.timeout = timeout;
+    return transfer;
+  };
+
+  SUBCASE("Tracks and expires pending transfers") {
+    const auto now = Clock::now();
+    manager.track(pending(1, 1), now);
+    manager.track(pending(2, 5), now);
+    manager.track(pending(3, 0), now); // Never expires
+    REQUIRE(manager.outstanding() == 3);
+
+    std::vector<tigerbeetle::tb_uint128_t> expired;
+    auto collect = [&](const tigerbeetle::tb_transfer_t &transfer) {
+      expired.push_back(transfer.id);
+    };
+    REQUIRE(manager.expire(now + 2s, collect) == 1);
+    REQUIRE(expired.front() == 1);
+    REQUIRE_FALSE(manager.is_tracked(1));
+    REQUIRE(manager.expire(now + 1h, collect) == 1);
+    REQUIRE(manager.outstanding() == 1);
+    REQUIRE(manager.is_tracked(3));
+  }
+
+  SUBCASE("Re-tracking moves the deadline") {
+    const auto now = Clock::now();
+    manager.track(pending(1, 1), now);
+    manager.track(pending(1, 10), now);
+    REQUIRE(manager.expire(now + 2s) == 0);
+    REQUIRE(manager.is_tracked(1));
+    REQUIRE(manager.expire(now + 11s) == 1);
+  }
+
+  SUBCASE("Decisions are queued until flushed") {
+    manager.track(pending(1, 0));
+    auto posted = manager.post(10, 1);
+    auto voided = manager.void_pending(11, 2);
+    REQUIRE(manager.queued() == 2);
+    REQUIRE(posted.valid());
+    REQUIRE(voided.valid());
+  }
+}
+
+TEST_CASE("Pending Transfer decisions") {
+  using Clock = tigerbeetle::PendingTransferManager::Clock;
+  tigerbeetle::Client client("3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+
+  auto ctx = std::make_unique<tigerbeetle::CompletionContext>();
+  auto send = [&](tigerbeetle::TB_OPERATION operation, auto &events) {
+    tigerbeetle::tb_packet_t packet{};
+    packet.operation = operation;
+    packet.data = events.data();
+    packet.data_size =
+        static_cast<uint32_t>(events.size() * sizeof(events[0]));
+    packet.user_data = ctx.get();
+    client.send_request(packet, ctx.get());
+    REQUIRE(packet.status == tigerbeetle::TB_PACKET_OK);
+  };
+  // Created once, EXISTS on later runs.
+  std::vector<tigerbeetle::tb_account_t> accounts(2);
+  for (std::size_t i = 0; i < accounts.size(); ++i) {
+    accounts[i].id = 9501 + i;
+    accounts[i].ledger = 1;
+    accounts[i].code = 1;
+  }
+  send(tigerbeetle::TB_OPERATION_CREATE_ACCOUNTS, accounts);
+  // Two pending transfers between them, ids base + 1 and base + 2.
+  auto create_pending = [&](tigerbeetle::tb_uint128_t base) {
+    std::vector<tigerbeetle::tb_transfer_t> pending(2);
+    for (std::size_t i = 0; i < pending.size(); ++i) {
+      pending[i].id = base + 1 + i;
+      pending[i].debit_account_id = 9501;
+      pending[i].credit_account_id = 9502;
+      pending[i].amount = 100 + i;
+      pending[i].ledger = 1;
+      pending[i].code = 1;
+      pending[i].flags = tigerbeetle::TB_TRANSFER_PENDING;
+    }
+    send(tigerbeetle::TB_OPERATION_CREATE_TRANSFERS, pending);
+    REQUIRE(ctx->size == 0);
+    return pending;
+  };
+
+  // Every create_transfers batch sent by the managers.
+  std::mutex mutex;
+  std::vector<std::vector<tigerbeetle::tb_transfer_t>> batches;
+  auto watch = [&] {
+    client.set_reply_observer([&](const tigerbeetle::tb_packet_t &packet,
+                                  const uint8_t *, uint32_t) {
+      const auto *events =
+          static_cast<const tigerbeetle::tb_transfer_t *>(packet.data);
+      const auto count = packet.data_size / sizeof(*events);
+      std::lock_guard lock(mutex);
+      batches.emplace_back(events, events + count);
+    });
+  };
+
+  SUBCASE("Coalesced into one batch, results routed back") {
+    const auto pending = create_pending(9600);
+    watch();
+    tigerbeetle::PendingTransferManager manager(client, {.linger = 0ms});
+    for (const auto &transfer : pending) {
+      manager.track(transfer);
+    }
+    auto posted = manager.post(9611, 9601);
+    auto voided = manager.void_pending(9612, 9602);
+    auto unknown = manager.post(9613, 9699, 5);
+    REQUIRE(manager.queued() == 3);
+    REQUIRE(manager.flush() == 3);
+
+    REQUIRE(batches.size() == 1);
+    const auto &batch = batches[0];
+    REQUIRE(batch.size() == 3);
+    CHECK(batch[0].flags ==
+          tigerbeetle::TB_TRANSFER_POST_PENDING_TRANSFER);
+    CHECK(batch[0].pending_id == 9601);
+    CHECK(batch[0].amount == 100); // The tracked amount
+    CHECK(batch[0].debit_account_id == 9501);
+    CHECK(batch[1].flags ==
+          tigerbeetle::TB_TRANSFER_VOID_PENDING_TRANSFER);
+    CHECK(batch[1].pending_id == 9602);
+    CHECK(batch[2].pending_id == 9699);
+    CHECK(batch[2].amount == 5);
+
+    CHECK(posted.get().ok());
+    CHECK(voided.get().ok());
+    const auto missing = unknown.get();
+    CHECK(missing.packet_status == tigerbeetle::TB_PACKET_OK);
+    CHECK(missing.result ==
+          tigerbeetle::TB_CREATE_TRANSFER_PENDING_TRANSFER_NOT_FOUND);
+    CHECK_FALSE(manager.is_tracked(9601));
+    CHECK_FALSE(manager.is_tracked(9602));
+  }
+
+  SUBCASE("A lone decision goes out after the linger time") {
+    const auto pending = create_pending(9620);
+    watch();
+    tigerbeetle::PendingTransferManager manager(client, {.linger = 20ms});
+    manager.track(pending[0]);
+    auto posted = manager.post(9631, 9621);
+    CHECK(manager.poll(Clock::now()) == 0);
+    CHECK(manager.queued() == 1);
+    CHECK(manager.poll(Clock::now() + 1s) == 1);
+    CHECK(manager.queued() == 0);
+    REQUIRE(batches.size() == 1);
+    CHECK(batches[0].size() == 1);
+    CHECK(posted.get().ok());
+  }
+}
@@ -0,0 +1,143 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <mutex>
+#include <set>
+#include <tb_percore.hpp>
+#include <thread>
+#include <vector>
+
+TEST_CASE("SPSC ring") {
+  SUBCASE("Capacity rounds up to a power of two") {
+    tigerbeetle::SpscRing<int> ring(5);
+    CHECK(ring.capacity() == 8);
+    for (int i = 0; i < 8; ++i) {
+      CHECK(ring.try_push(i));
+    }
+    CHECK_FALSE(ring.try_push(8));
+    int value = -1;
+    REQUIRE(ring.try_pop(value));
+    CHECK(value == 0);
+    CHECK(ring.try_push(8)); // The freed slot is reused
+  }
+
+  SUBCASE("Empty") {
+    tigerbeetle::SpscRing<int> ring(4);
+    int value = -1;
+    CHECK(ring.empty());
+    CHECK_FALSE(ring.try_pop(value));
+    CHECK(ring.try_push(1));
+    CHECK_FALSE(ring.empty());
+  }
+
+  SUBCASE("Items cross threads in order") {
+    constexpr uint64_t count = 200000;
+    tigerbeetle::SpscRing<uint64_t> ring(64);
+    std::thread producer([&] {
+      for (uint64_t i = 0; i < count;) {
+        if (ring.try_push(i)) {
+          ++i;
+        }
+      }
+    });
+    uint64_t expected = 0;
+    bool ordered = true;
+    for (uint64_t value; expected < count;) {
+      if (ring.try_pop(value)) {
+        ordered = ordered && value == expected;
+        ++expected;
+      }
+    }
+    producer.join();
+    CHECK(ordered);
+    CHECK(ring.empty());
+  }
+}
+
+TEST_CASE("Core executor") {
+  using Executor = tigerbeetle::CoreExecutor<uint64_t>;
+
+  SUBCASE("Jobs and replies stay on their core") {
+    tigerbeetle::CoreOptions options;
+    options.cpus = {-1, -1}; // Unpinned: the sandbox may have one CPU
+    options.max_in_flight = 4;
+
+    std::mutex mutex;
+    std::vector<std::set<std::thread::id>> threads(2);
+    std::vector<uint64_t> echoed;
+    auto note = [&](std::size_t core) {
+      std::lock_guard lock(mutex);
+      threads[core].insert(std::this_thread::get_id());
+    };
+
+    Executor executor(
+        tigerbeetle::echo_client, "3000",
+        [&](Executor::Core &core, uint64_t &job) {
+          note(core.index());
+          auto *request = core.acquire();
+          CHECK(request != nullptr); // A job only runs with one free
+          if (request == nullptr) {
+            return;
+          }
+          tigerbeetle::tb_uint128_t ids[2] = {job, job + 1};
+          request->assign(tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS, ids);
+          request->user_tag = job;
+          CHECK(core.submit(*request));
+        },
+        [&](Executor::Core &core, tigerbeetle::CoreRequest &request) {
+          note(core.index());
+          CHECK(request.packet.status == tigerbeetle::TB_PACKET_OK);
+          tigerbeetle::tb_uint128_t first = 0;
+          CHECK(request.reply.size() == 2 * sizeof(first));
+          std::memcpy(&first, request.reply.data(), sizeof(first));
+          CHECK(first == request.user_tag);
+          std::lock_guard lock(mutex);
+          echoed.push_back(request.user_tag);
+        },
+        options);
+    REQUIRE(executor.ok());
+    REQUIRE(executor.size() == 2);
+
+    constexpr uint64_t jobs = 100;
+    for (uint64_t job = 0; job < jobs; ++job) {
+      while (!executor.post(job % 2, job)) {
+        std::this_thread::yield();
+      }
+    }
+    executor.stop();
+
+    CHECK(echoed.size() == jobs);
+    for (std::size_t core = 0; core < 2; ++core) {
+      const auto metrics = executor.metrics(core);
+      CHECK(metrics.jobs == jobs / 2);
+      CHECK(metrics.requests == jobs / 2);
+      CHECK(metrics.replies == jobs / 2);
+      CHECK(metrics.failed == 0);
+      CHECK(threads[core].size() == 1);
+    }
+    CHECK(*threads[0].begin() != *threads[1].begin());
+  }
+
+  SUBCASE("Inbox full") {
+    tigerbeetle::CoreOptions options;
+    options.cpus = {-1};
+    options.inbox_capacity = 2;
+    std::atomic<bool> hold{true};
+    Executor executor(
+        tigerbeetle::echo_client, "3000",
+        [&](Executor::Core &, uint64_t &) {
+          while (hold.load()) {
+            std::this_thread::yield();
+          }
+        },
+        [](Executor::Core &, tigerbeetle::CoreRequest &) {}, options);
+    // One job may already be running; the inbox then holds two more.
+    bool refused = false;
+    for (uint64_t job = 0; job < 4 && !refused; ++job) {
+      refused = !executor.post(0, job);
+    }
+    CHECK(refused);
+    hold = false;
+    executor.stop();
+    CHECK(executor.metrics(0).requests == 0);
+  }
+}
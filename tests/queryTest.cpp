@@ -0,0 +1,257 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <algorithm>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <memory>
+#include <mutex>
+#include <tb_query.hpp>
+#include <vector>
+
+namespace {
+tigerbeetle::tb_query_filter_t day_filter() {
+  tigerbeetle::tb_query_filter_t filter{};
+  filter.ledger = 7;
+  filter.timestamp_min = 1000;
+  filter.timestamp_max = 1999;
+  filter.limit = 0;
+  return filter;
+}
+
+// Filters sent through a client, in any order.
+struct Sent {
+  std::mutex mutex; // Clients complete on their own threads
+  std::vector<tigerbeetle::tb_query_filter_t> filters;
+  std::vector<uint8_t> operations;
+
+  void watch(tigerbeetle::Client &client) {
+    client.set_reply_observer([this](const tigerbeetle::tb_packet_t &packet,
+                                     const uint8_t *, uint32_t) {
+      std::lock_guard lock(mutex);
+      filters.push_back(
+          *static_cast<const tigerbeetle::tb_query_filter_t *>(packet.data));
+      operations.push_back(packet.operation);
+    });
+  }
+};
+} // namespace
+
+TEST_CASE("Timestamp split") {
+  SUBCASE("Contiguous sub-ranges") {
+    const auto parts = tigerbeetle::split_by_timestamp(day_filter(), 8);
+    REQUIRE(parts.size() == 8);
+    REQUIRE(parts.front().timestamp_min == 1000);
+    REQUIRE(parts.back().timestamp_max == 1999);
+    for (std::size_t i = 0; i < parts.size(); ++i) {
+      REQUIRE(parts[i].ledger == 7);
+      REQUIRE(parts[i].timestamp_min <= parts[i].timestamp_max);
+      if (i != 0) {
+        REQUIRE(parts[i].timestamp_min == parts[i - 1].timestamp_max + 1);
+      }
+    }
+  }
+
+  SUBCASE("Narrow ranges") {
+    auto filter = day_filter();
+    filter.timestamp_max = 1002;
+    const auto parts = tigerbeetle::split_by_timestamp(filter, 8);
+    REQUIRE(parts.size() == 3);
+    REQUIRE(parts[1].timestamp_min == 1001);
+    REQUIRE(parts[1].timestamp_max == 1001);
+
+    filter.timestamp_max = 1000;
+    REQUIRE(tigerbeetle::split_by_timestamp(filter, 8).size() == 1);
+    REQUIRE(tigerbeetle::split_by_timestamp(day_filter(), 1).size() == 1);
+  }
+
+  SUBCASE("Open bounds stay open") {
+    tigerbeetle::tb_query_filter_t filter{};
+    const auto parts = tigerbeetle::split_by_timestamp(filter, 4);
+    REQUIRE(parts.size() == 4);
+    REQUIRE(parts.front().timestamp_min == 0);
+    REQUIRE(parts.back().timestamp_max == 0);
+    REQUIRE(parts[1].timestamp_min > 0);
+  }
+}
+
+TEST_CASE("Parallel query") {
+  // An echoed filter is half a record: every sub-range reads as empty after
+  // its first request, which is all the echo client can show.
+  tigerbeetle::Client first(tigerbeetle::echo_client, "3001");
+  tigerbeetle::Client second(tigerbeetle::echo_client, "3001");
+  REQUIRE(first.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+  REQUIRE(second.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+  Sent by_first;
+  Sent by_second;
+  by_first.watch(first);
+  by_second.watch(second);
+
+  SUBCASE("One request per sub-range") {
+    tigerbeetle::Client *const clients[] = {&first, &second};
+    tigerbeetle::ParallelQuery<tigerbeetle::tb_transfer_t> query(
+        std::span<tigerbeetle::Client *const>(clients), day_filter(),
+        {.shards = 5, .page_limit = 100});
+    REQUIRE(query.shard_count() == 5);
+    REQUIRE(query.next().empty());
+    REQUIRE(query.ok());
+
+    REQUIRE(by_first.filters.size() == 3); // Round-robin
+    REQUIRE(by_second.filters.size() == 2);
+    auto sent = by_first.filters;
+    sent.insert(sent.end(), by_second.filters.begin(),
+                by_second.filters.end());
+    std::sort(sent.begin(), sent.end(), [](const auto &a, const auto &b) {
+      return a.timestamp_min < b.timestamp_min;
+    });
+    const auto parts = tigerbeetle::split_by_timestamp(day_filter(), 5);
+    for (std::size_t i = 0; i < parts.size(); ++i) {
+      REQUIRE(sent[i].timestamp_min == parts[i].timestamp_min);
+      REQUIRE(sent[i].timestamp_max == parts[i].timestamp_max);
+      REQUIRE(sent[i].limit == 100);
+    }
+    for (auto operation : by_first.operations) {
+      REQUIRE(operation == tigerbeetle::TB_OPERATION_QUERY_TRANSFERS);
+    }
+  }
+
+  SUBCASE("Limits") {
+    auto filter = day_filter();
+    filter.limit = 10;
+    tigerbeetle::ParallelQuery<tigerbeetle::tb_account_t> query(first, filter);
+    REQUIRE(query.for_each([](const auto &) {}) == 0);
+    REQUIRE(by_first.filters.size() == 8);
+    for (std::size_t i = 0; i < by_first.filters.size(); ++i) {
+      REQUIRE(by_first.filters[i].limit == 10); // Never more than the cap
+      REQUIRE(by_first.operations[i] ==
+              tigerbeetle::TB_OPERATION_QUERY_ACCOUNTS);
+    }
+  }
+
+  SUBCASE("Failed requests end the stream") {
+    second.drain(std::chrono::steady_clock::now());
+    tigerbeetle::Client *const clients[] = {&first, &second};
+    tigerbeetle::ParallelQuery<tigerbeetle::tb_transfer_t> query(
+        std::span<tigerbeetle::Client *const>(clients), day_filter(),
+        {.shards = 4});
+    REQUIRE(query.next().empty());
+    REQUIRE_FALSE(query.ok());
+    REQUIRE(query.packet_status() != tigerbeetle::TB_PACKET_OK);
+  }
+}
+
+TEST_CASE("Open bounds are narrowed to the data") {
+  tigerbeetle::Client client("3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+  auto ctx = std::make_unique<tigerbeetle::CompletionContext>();
+  auto send = [&](tigerbeetle::TB_OPERATION operation, auto &events) {
+    tigerbeetle::tb_packet_t packet{};
+    packet.operation = operation;
+    packet.data = events.data();
+    packet.data_size =
+        static_cast<uint32_t>(events.size() * sizeof(events[0]));
+    packet.user_data = ctx.get();
+    client.send_request(packet, ctx.get());
+    REQUIRE(packet.status == tigerbeetle::TB_PACKET_OK);
+    REQUIRE(ctx->size == 0);
+  };
+  std::vector<tigerbeetle::tb_account_t> accounts(2);
+  for (std::size_t i = 0; i < accounts.size(); ++i) {
+    accounts[i].id = 9301 + i;
+    accounts[i].ledger = 9;
+    accounts[i].code = 1;
+  }
+  send(tigerbeetle::TB_OPERATION_CREATE_ACCOUNTS, accounts);
+  std::vector<tigerbeetle::tb_transfer_t> transfers(40);
+  for (std::size_t i = 0; i < transfers.size(); ++i) {
+    transfers[i].id = 9401 + i;
+    transfers[i].debit_account_id = 9301;
+    transfers[i].credit_account_id = 9302;
+    transfers[i].amount = 1;
+    transfers[i].ledger = 9;
+    transfers[i].code = 1;
+  }
+  send(tigerbeetle::TB_OPERATION_CREATE_TRANSFERS, transfers);
+
+  Sent sent;
+  sent.watch(client);
+  tigerbeetle::tb_query_filter_t filter{};
+  filter.ledger = 9;
+  std::vector<tigerbeetle::tb_uint128_t> read;
+  std::vector<uint64_t> timestamps;
+  {
+    tigerbeetle::ParallelQuery<tigerbeetle::tb_transfer_t> query(
+        client, filter, {.shards = 4, .page_limit = 5});
+    query.for_each([&](const tigerbeetle::tb_transfer_t &transfer) {
+      read.push_back(transfer.id);
+      timestamps.push_back(transfer.timestamp);
+    });
+    REQUIRE(query.ok());
+    REQUIRE(query.shard_count() == 4);
+  }
+  REQUIRE(read.size() == transfers.size());
+  REQUIRE(std::is_sorted(timestamps.begin(), timestamps.end()));
+
+  // Two one-record probes, then pages within [first, last] only.
+  std::size_t probes = 0;
+  for (const auto &f : sent.filters) {
+    if (f.limit == 1) {
+      ++probes;
+      continue;
+    }
+    REQUIRE(f.timestamp_min >= timestamps.front());
+    REQUIRE(f.timestamp_max <= timestamps.back());
+    REQUIRE(f.timestamp_max != 0);
+  }
+  REQUIRE(probes == 2);
+}
+
+TEST_CASE("Oversized pages are clamped to one message") {
+  tigerbeetle::Client client("3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+  auto ctx = std::make_unique<tigerbeetle::CompletionContext>();
+  auto send = [&](tigerbeetle::TB_OPERATION operation, auto events) {
+    tigerbeetle::tb_packet_t packet{};
+    packet.operation = operation;
+    packet.data = events.data();
+    packet.data_size = static_cast<uint32_t>(events.size_bytes());
+    packet.user_data = ctx.get();
+    client.send_request(packet, ctx.get());
+    REQUIRE(packet.status == tigerbeetle::TB_PACKET_OK);
+    REQUIRE(ctx->size == 0);
+  };
+  std::vector<tigerbeetle::tb_account_t> accounts(2);
+  for (std::size_t i = 0; i < accounts.size(); ++i) {
+    accounts[i].id = 9501 + i;
+    accounts[i].ledger = 11;
+    accounts[i].code = 1;
+  }
+  send(tigerbeetle::TB_OPERATION_CREATE_ACCOUNTS, std::span(accounts));
+  // More than one reply holds, in two requests.
+  constexpr auto per_message =
+      tigerbeetle::MAX_MESSAGE_SIZE / sizeof(tigerbeetle::tb_transfer_t);
+  std::vector<tigerbeetle::tb_transfer_t> transfers(per_message + 100);
+  for (std::size_t i = 0; i < transfers.size(); ++i) {
+    transfers[i].id = 20001 + i;
+    transfers[i].debit_account_id = 9501;
+    transfers[i].credit_account_id = 9502;
+    transfers[i].amount = 1;
+    transfers[i].ledger = 11;
+    transfers[i].code = 1;
+  }
+  send(tigerbeetle::TB_OPERATION_CREATE_TRANSFERS,
+       std::span(transfers).first(per_message));
+  send(tigerbeetle::TB_OPERATION_CREATE_TRANSFERS,
+       std::span(transfers).subspan(per_message));
+
+  Sent sent;
+  sent.watch(client);
+  tigerbeetle::tb_query_filter_t filter{};
+  filter.ledger = 11;
+  tigerbeetle::ParallelQuery<tigerbeetle::tb_transfer_t> query(
+      client, filter, {.shards = 1, .page_limit = 10000});
+  REQUIRE(query.for_each([](const auto &) {}) == transfers.size());
+  REQUIRE(query.ok());
+  REQUIRE(sent.filters.size() == 2);
+  for (const auto &f : sent.filters) {
+    REQUIRE(f.limit == per_message);
+  }
+}
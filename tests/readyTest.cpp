@@ -0,0 +1,71 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <chrono>
+#include <doctest/doctest.h>
+#include <future>
+#include <tb_client.hpp>
+
+namespace {
+using namespace std::chrono_literals;
+
+bool is_ready(const std::shared_future<void> &future) {
+  return future.wait_for(0s) == std::future_status::ready;
+}
+} // namespace
+
+TEST_CASE("Warm-up") {
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+  const auto ready = client.ready();
+
+  SUBCASE("Probe") {
+    REQUIRE_FALSE(client.startup().ready);
+    REQUIRE(client.warm_up(std::chrono::steady_clock::now() + 10s));
+    REQUIRE(is_ready(ready));
+    ready.get();
+    auto metrics = client.startup();
+    REQUIRE(metrics.ready);
+    REQUIRE(metrics.probes == 1);
+    REQUIRE(metrics.init > 0ns);
+    REQUIRE(metrics.first_reply >= metrics.init);
+    REQUIRE(metrics.warm_up > 0ns);
+
+    // Already warm: no more probes.
+    REQUIRE(client.warm_up(std::chrono::steady_clock::now()));
+    REQUIRE(client.startup().probes == 1);
+    REQUIRE(client.in_flight() == 0);
+  }
+
+  SUBCASE("Real traffic") {
+    tigerbeetle::tb_uint128_t id = 5;
+    tigerbeetle::tb_packet_t packet{};
+    packet.operation = tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS;
+    packet.data = &id;
+    packet.data_size = sizeof(id);
+    auto ctx = std::make_unique<tigerbeetle::CompletionContext>();
+    packet.user_data = ctx.get();
+    client.send_request(packet, ctx.get());
+    REQUIRE(packet.status == tigerbeetle::TB_PACKET_OK);
+    REQUIRE(is_ready(ready));
+    REQUIRE(client.warm_up(std::chrono::steady_clock::now()));
+    REQUIRE(client.startup().probes == 0);
+  }
+
+  SUBCASE("Refused") {
+    client.drain(std::chrono::steady_clock::now());
+    REQUIRE_FALSE(client.warm_up(std::chrono::steady_clock::now() + 10s));
+    REQUIRE_FALSE(is_ready(ready));
+    const auto metrics = client.startup();
+    REQUIRE_FALSE(metrics.ready);
+    REQUIRE(metrics.probes == 1);
+    REQUIRE(metrics.first_reply == 0ns);
+  }
+}
+
+TEST_CASE("Broken promise") {
+  std::shared_future<void> ready;
+  {
+    tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+    ready = client.ready();
+  }
+  REQUIRE_THROWS_AS(ready.get(), std::future_error);
+}
@@ -0,0 +1,117 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <chrono>
+#include <doctest/doctest.h>
+#include <ranges>
+#include <tb_reconcile.hpp>
+#include <vector>
+
+namespace {
+using namespace std::chrono_literals;
+using tigerbeetle::ExpectedBalance;
+using tigerbeetle::Mismatch;
+using tigerbeetle::MismatchKind;
+
+tigerbeetle::tb_account_t account_of(const ExpectedBalance &e) {
+  tigerbeetle::tb_account_t a{};
+  a.id = e.id;
+  a.debits_pending = e.debits_pending;
+  a.debits_posted = e.debits_posted;
+  a.credits_pending = e.credits_pending;
+  a.credits_posted = e.credits_posted;
+  return a;
+}
+
+// The echo client answers a lookup with the ids it was sent, which read as
+// one tb_account_t per 8 ids: the account's id is the first of them and its
+// balances are the next four. Id i with i % 8 == 1 therefore "exists" with
+// balances i+1..i+4 and every other id is missing.
+ExpectedBalance echoed(uint64_t i) {
+  ExpectedBalance e{i};
+  if (i % 8 == 1) {
+    e = {i, i + 1, i + 2, i + 3, i + 4};
+  }
+  if (i % 80 == 1) {
+    e.credits_posted = 0;
+  }
+  return e;
+}
+} // namespace
+
+TEST_CASE("Lookup comparison") {
+  const std::vector<ExpectedBalance> expected = {
+      {1, 0, 10, 0, 0}, {2, 0, 0, 0, 5}, {3, 0, 7, 0, 0}, {4, 1, 0, 0, 0}};
+  // 2 does not exist, 3 has moved on.
+  std::vector<tigerbeetle::tb_account_t> reply = {account_of(expected[0]),
+                                                  account_of(expected[2]),
+                                                  account_of(expected[3])};
+  reply[1].debits_posted = 8;
+
+  std::vector<Mismatch> found;
+  const auto matched = tigerbeetle::compare_lookup(
+      expected, reply, [&found](const Mismatch &m) { found.push_back(m); });
+  REQUIRE(matched == 2);
+  REQUIRE(found.size() == 2);
+  REQUIRE(found[0].kind == MismatchKind::missing);
+  REQUIRE(found[0].expected.id == 2);
+  REQUIRE(found[1].kind == MismatchKind::balance);
+  REQUIRE(found[1].expected.id == 3);
+  REQUIRE(found[1].actual.debits_posted == 8);
+}
+
+TEST_CASE("Reconciler") {
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+  tigerbeetle::ReconcileOptions options;
+  options.batch = 64;
+  options.in_flight = 8;
+  options.threads = 3;
+  tigerbeetle::Reconciler reconciler(client, options);
+
+  // Generated on the fly, never held in memory.
+  constexpr uint64_t count = 10000;
+  auto snapshot = std::views::iota(uint64_t{1}, count + 1) |
+                  std::views::transform(echoed);
+
+  SUBCASE("Streaming") {
+    std::size_t missing = 0;
+    std::size_t balance = 0;
+    const auto report = reconciler.run(snapshot, [&](const Mismatch &m) {
+      if (m.kind == MismatchKind::missing) {
+        REQUIRE(m.expected.id % 8 != 1);
+        ++missing;
+      } else {
+        REQUIRE(m.kind == MismatchKind::balance);
+        REQUIRE(m.expected.id % 80 == 1);
+        REQUIRE(m.actual.credits_posted == m.expected.id + 4);
+        ++balance;
+      }
+    });
+    REQUIRE(report.checked == count);
+    REQUIRE(report.lookups == (count + 63) / 64);
+    REQUIRE(report.missing == count - count / 8);
+    REQUIRE(report.mismatched == count / 80);
+    REQUIRE(report.matched == count / 8 - count / 80);
+    REQUIRE(report.failed == 0);
+    REQUIRE_FALSE(report.ok());
+    REQUIRE(missing == report.missing);
+    REQUIRE(balance == report.mismatched);
+
+    // Reusable, and without a sink.
+    const auto again = reconciler.run(snapshot, nullptr);
+    REQUIRE(again.checked == count);
+    REQUIRE(again.matched == report.matched);
+  }
+
+  SUBCASE("Failed lookups") {
+    client.drain(std::chrono::steady_clock::now() + 10s);
+    std::size_t failed = 0;
+    const auto report = reconciler.run(snapshot, [&](const Mismatch &m) {
+      REQUIRE(m.kind == MismatchKind::failed);
+      REQUIRE(m.packet_status == tigerbeetle::TB_PACKET_CLIENT_SHUTDOWN);
+      ++failed;
+    });
+    REQUIRE(report.failed == count);
+    REQUIRE(failed == count);
+    REQUIRE(report.matched == 0);
+  }
+}
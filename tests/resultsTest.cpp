@@ -0,0 +1,100 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <map>
+#include <random>
+#include <tb_results.hpp>
+#include <vector>
+
+namespace {
+using Result = tigerbeetle::tb_create_transfers_result_t;
+
+std::vector<std::size_t> collect(tigerbeetle::BitIndices indices) {
+  return {indices.begin(), indices.end()};
+}
+} // namespace
+
+TEST_CASE("Create results") {
+  tigerbeetle::CreateResults results;
+
+  SUBCASE("All succeeded") {
+    results.decode(130, std::span<const Result>{});
+    REQUIRE(results.all_succeeded());
+    REQUIRE(results.succeeded_count() == 130);
+    REQUIRE(collect(results.failed_indices()).empty());
+    const auto succeeded = collect(results.succeeded_indices());
+    REQUIRE(succeeded.size() == 130);
+    REQUIRE(succeeded.front() == 0);
+    REQUIRE(succeeded.back() == 129);
+  }
+
+  SUBCASE("Random failures") {
+    constexpr std::size_t events = 8189;
+    std::mt19937 rng(5);
+    std::vector<Result> reply;
+    std::map<uint32_t, std::size_t> expected_counts;
+    for (uint32_t i = 0; i < events; ++i) {
+      if (rng() % 7 == 0) {
+        const auto code = static_cast<uint32_t>(rng() % 60 + 1);
+        reply.push_back({i, code});
+        ++expected_counts[code];
+      }
+    }
+    results.decode(events, std::span<const Result>(reply));
+    REQUIRE(results.size() == events);
+    REQUIRE(results.failed_count() == reply.size());
+    REQUIRE(results.failed_count() + results.succeeded_count() == events);
+    for (const auto &[code, count] : expected_counts) {
+      REQUIRE(results.count(code) == count);
+    }
+    REQUIRE(results.count(1000) == 0);
+
+    const auto failed = collect(results.failed_indices());
+    REQUIRE(failed.size() == reply.size());
+    std::size_t next = 0;
+    results.for_each_failed([&](std::size_t index, uint32_t code) {
+      REQUIRE(index == reply[next].index);
+      REQUIRE(code == reply[next].result);
+      REQUIRE(failed[next] == index);
+      ++next;
+    });
+    REQUIRE(next == reply.size());
+
+    std::vector<bool> seen(events);
+    for (auto i : results.failed_indices()) {
+      seen[i] = true;
+    }
+    for (auto i : results.succeeded_indices()) {
+      REQUIRE_FALSE(seen[i]);
+      seen[i] = true;
+    }
+    for (std::size_t i = 0; i < events; ++i) {
+      REQUIRE(seen[i]);
+    }
+    for (const auto &r : reply) {
+      REQUIRE(results.failed(r.index));
+      REQUIRE(results.result(r.index) == r.result);
+    }
+    REQUIRE(results.result(events - 1) == (results.failed(events - 1)
+                                               ? reply.back().result
+                                               : 0));
+  }
+
+  SUBCASE("Raw replies out of order") {
+    // Unsorted, with a duplicate and an index past the batch.
+    const std::vector<tigerbeetle::tb_create_accounts_result_t> reply = {
+        {70, tigerbeetle::TB_CREATE_ACCOUNT_EXISTS},
+        {3, tigerbeetle::TB_CREATE_ACCOUNT_LINKED_EVENT_FAILED},
+        {99, tigerbeetle::TB_CREATE_ACCOUNT_EXISTS},
+        {3, tigerbeetle::TB_CREATE_ACCOUNT_EXISTS}};
+    results.decode(tigerbeetle::TB_OPERATION_CREATE_ACCOUNTS, 71,
+                   reinterpret_cast<const uint8_t *>(reply.data()),
+                   reply.size() * sizeof(reply[0]));
+    REQUIRE(collect(results.failed_indices()) ==
+            std::vector<std::size_t>{3, 70});
+    REQUIRE(results.result(3) ==
+            tigerbeetle::TB_CREATE_ACCOUNT_LINKED_EVENT_FAILED);
+    REQUIRE(results.result(70) == tigerbeetle::TB_CREATE_ACCOUNT_EXISTS);
+    REQUIRE(results.count(tigerbeetle::TB_CREATE_ACCOUNT_EXISTS) == 1);
+    REQUIRE(results.succeeded_count() == 69);
+  }
+}
@@ -0,0 +1,143 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <algorithm>
+#include <doctest/doctest.h>
+#include <mutex>
+#include <tb_router.hpp>
+#include <vector>
+
+namespace {
+using tigerbeetle::tb_uint128_t;
+
+std::vector<tigerbeetle::ClusterConfig> three_clusters() {
+  std::vector<tigerbeetle::ClusterConfig> clusters(3);
+  for (std::size_t i = 0; i < clusters.size(); ++i) {
+    clusters[i].addresses = std::to_string(3001 + i);
+    clusters[i].cluster_id[0] = static_cast<uint8_t>(i);
+    clusters[i].clients = 2;
+  }
+  return clusters;
+}
+} // namespace
+
+TEST_CASE("Routing") {
+  tigerbeetle::Router router(tigerbeetle::echo_client, three_clusters(),
+                             [](uint32_t ledger) { return ledger / 10; });
+  REQUIRE(router.ok());
+  REQUIRE(router.size() == 3);
+  REQUIRE(router.cluster_of(5) == 0);
+  REQUIRE(router.cluster_of(27) == 2);
+  REQUIRE_THROWS_AS(router.cluster_of(30), std::out_of_range);
+  REQUIRE(&router.client(1) != &router.client(1));
+
+  tigerbeetle::Router modulo(tigerbeetle::echo_client, three_clusters());
+  REQUIRE(modulo.cluster_of(7) == 1);
+}
+
+TEST_CASE("Creates by ledger") {
+  tigerbeetle::Router router(tigerbeetle::echo_client, three_clusters());
+
+  std::vector<std::vector<uint32_t>> ledgers(router.size());
+  std::vector<std::size_t> sizes; // Requests sent to cluster 0
+  std::mutex mutex;                // Clients complete on their own threads
+  for (std::size_t cluster = 0; cluster < router.size(); ++cluster) {
+    for (int i = 0; i < 2; ++i) {
+      router.client(cluster).set_reply_observer(
+          [&, cluster](const tigerbeetle::tb_packet_t &packet,
+                       const uint8_t *, uint32_t) {
+            std::lock_guard lock(mutex);
+            const std::span<const tigerbeetle::tb_transfer_t> sent(
+                static_cast<const tigerbeetle::tb_transfer_t *>(packet.data),
+                packet.data_size / sizeof(tigerbeetle::tb_transfer_t));
+            for (const auto &t : sent) {
+              ledgers[cluster].push_back(t.ledger);
+            }
+            if (cluster == 0) {
+              sizes.push_back(sent.size());
+            }
+          });
+    }
+  }
+
+  // Ledgers 0 and 3 live in cluster 0, 1 and 4 in cluster 1, 2 in cluster
+  // 2. Clusters 0 and 1 get more than a request holds (8190 transfers).
+  // The k-th event of cluster 0 is at 5 * (k / 2) + 3 * (k % 2); a chain of
+  // its events 8185..8195 spans the limit, so its first request ends
+  // before the chain.
+  std::vector<tigerbeetle::tb_transfer_t> transfers(21000);
+  for (std::size_t i = 0; i < transfers.size(); ++i) {
+    transfers[i].ledger = static_cast<uint32_t>(i % 5);
+  }
+  const auto position = [](std::size_t k) { return 5 * (k / 2) + 3 * (k % 2); };
+  for (std::size_t k = 8185; k < 8195; ++k) {
+    transfers[position(k)].flags = tigerbeetle::TB_TRANSFER_LINKED;
+  }
+  const auto routed =
+      router.create(std::span<const tigerbeetle::tb_transfer_t>(transfers));
+  REQUIRE(routed.packet_status == tigerbeetle::TB_PACKET_OK);
+  REQUIRE(routed.unsent.empty());
+  for (std::size_t cluster = 0; cluster < router.size(); ++cluster) {
+    REQUIRE(ledgers[cluster].size() == (cluster == 2 ? 4200 : 8400));
+    for (auto ledger : ledgers[cluster]) {
+      REQUIRE(router.cluster_of(ledger) == cluster);
+    }
+  }
+  std::sort(sizes.begin(), sizes.end());
+  REQUIRE(sizes == std::vector<std::size_t>{215, 8185});
+
+  // Echoed transfers read as garbage results; they still map back to the
+  // caller's events, in order.
+  REQUIRE_FALSE(routed.failures.empty());
+  for (std::size_t i = 0; i < routed.failures.size(); ++i) {
+    REQUIRE(routed.failures[i].index < transfers.size());
+    REQUIRE((i == 0 ||
+             routed.failures[i - 1].index <= routed.failures[i].index));
+  }
+}
+
+TEST_CASE("Lookups fan out") {
+  tigerbeetle::Router router(tigerbeetle::echo_client, three_clusters());
+
+  // An echoed lookup reads as one account per 8 ids, made of the 1st id
+  // (its id) and the next 7: each cluster "finds" every 8th id it is asked.
+  // 96 ids split into 3 * 32, so every cluster's reply is whole accounts.
+  std::vector<tb_uint128_t> ids(96);
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    ids[i] = 1000 + i;
+  }
+
+  SUBCASE("Routed ids") {
+    router.set_id_route(
+        [](tb_uint128_t id) { return std::optional<std::size_t>(id % 3); });
+    const auto routed =
+        router.lookup<tigerbeetle::tb_account_t>(std::span(ids));
+    REQUIRE(routed.ok());
+    REQUIRE(routed.records.size() == ids.size());
+    std::size_t asked[3] = {};
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+      const auto cluster = static_cast<std::size_t>(ids[i] % 3);
+      const bool found = asked[cluster]++ % 8 == 0;
+      REQUIRE(routed.records[i].has_value() == found);
+      if (found) {
+        REQUIRE(routed.records[i]->id == ids[i]);
+      }
+    }
+  }
+
+  SUBCASE("Every cluster") {
+    const auto routed =
+        router.lookup<tigerbeetle::tb_transfer_t>(std::span(ids));
+    REQUIRE(routed.ok());
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+      REQUIRE(routed.records[i].has_value() == (i % 8 == 0));
+    }
+  }
+
+  SUBCASE("Failed clusters") {
+    router.client(2).drain(std::chrono::steady_clock::now());
+    router.client(2).drain(std::chrono::steady_clock::now());
+    const auto routed =
+        router.lookup<tigerbeetle::tb_account_t>(std::span(ids));
+    REQUIRE(routed.packet_status == tigerbeetle::TB_PACKET_CLIENT_SHUTDOWN);
+    REQUIRE(routed.records[0].has_value());
+  }
+}
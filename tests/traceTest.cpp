@@ -0,0 +1,116 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#if !defined(TB_TRACING)
+#error "traceTest needs TB_TRACING, as set by CMakeLists.txt"
+#endif
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <doctest/doctest.h>
+#include <memory>
+#include <string>
+#include <tb_client.hpp>
+#include <thread>
+#include <vector>
+
+namespace {
+std::atomic<int> replies{0};
+
+void on_reply(tigerbeetle::Request *, uint64_t, const uint8_t *, uint32_t) {
+  replies.fetch_add(1);
+  replies.notify_all();
+}
+
+std::vector<tigerbeetle::TraceEvent>
+stages(const std::vector<tigerbeetle::trace::Record> &records,
+       const void *packet) {
+  std::vector<tigerbeetle::TraceEvent> events;
+  for (const auto &record : records) {
+    if (record.packet == reinterpret_cast<uintptr_t>(packet)) {
+      events.push_back(record.event);
+    }
+  }
+  return events;
+}
+
+std::string read_all(std::FILE *file) {
+  std::string text;
+  std::rewind(file);
+  char buffer[4096];
+  for (std::size_t n; (n = std::fread(buffer, 1, sizeof(buffer), file)) > 0;) {
+    text.append(buffer, n);
+  }
+  return text;
+}
+} // namespace
+
+TEST_CASE("Packet lifecycle") {
+  using tigerbeetle::TraceEvent;
+  tigerbeetle::trace::clear();
+  replies = 0;
+  tigerbeetle::Client client(tigerbeetle::echo_client, "3001");
+  REQUIRE(client.initStatus() == tigerbeetle::TB_INIT_SUCCESS);
+
+  auto ctx = std::make_unique<tigerbeetle::CompletionContext>();
+  tigerbeetle::tb_uint128_t id = 1;
+  tigerbeetle::tb_packet_t packet{};
+  packet.operation = tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS;
+  packet.data = &id;
+  packet.data_size = sizeof(id);
+  packet.user_data = ctx.get();
+  client.send_request(packet, ctx.get());
+  REQUIRE(packet.status == tigerbeetle::TB_PACKET_OK);
+
+  tigerbeetle::Request request;
+  request.packet.operation = tigerbeetle::TB_OPERATION_LOOKUP_ACCOUNTS;
+  request.packet.data = &id;
+  request.packet.data_size = sizeof(id);
+  request.on_reply = &on_reply;
+  REQUIRE(client.submit(request) == tigerbeetle::TB_CLIENT_OK);
+  replies.wait(0);
+
+  auto records = tigerbeetle::trace::snapshot();
+  REQUIRE(std::is_sorted(records.begin(), records.end(),
+                         [](const auto &a, const auto &b) {
+                           return a.ns < b.ns;
+                         }));
+  REQUIRE(stages(records, &packet) ==
+          std::vector{TraceEvent::seal, TraceEvent::submit,
+                      TraceEvent::complete, TraceEvent::wake});
+  REQUIRE(stages(records, &request.packet) ==
+          std::vector{TraceEvent::seal, TraceEvent::submit,
+                      TraceEvent::complete});
+
+  SUBCASE("Chrome trace export") {
+    std::FILE *file = std::tmpfile();
+    REQUIRE(file != nullptr);
+    tigerbeetle::trace::write_chrome_trace(file);
+    const auto json = read_all(file);
+    std::fclose(file);
+    REQUIRE(json.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0) ==
+            0);
+    REQUIRE(json.find("\"name\":\"tb_client io\"") != std::string::npos);
+    REQUIRE(json.find("\"name\":\"in flight\"") != std::string::npos);
+    REQUIRE(json.find("\"name\":\"dispatch\"") != std::string::npos);
+    REQUIRE(std::count(json.begin(), json.end(), '{') ==
+            std::count(json.begin(), json.end(), '}'));
+  }
+
+  SUBCASE("Cleared records are not exported") {
+    tigerbeetle::trace::clear();
+    REQUIRE(tigerbeetle::trace::snapshot().empty());
+  }
+}
+
+TEST_CASE("Rings keep the newest records") {
+  tigerbeetle::trace::clear();
+  std::thread([] {
+    tigerbeetle::trace::name_thread("writer");
+    for (uint32_t i = 0; i < TB_TRACE_CAPACITY + 100; ++i) {
+      TB_TRACE(enqueue, nullptr, i);
+    }
+  }).join();
+  auto records = tigerbeetle::trace::snapshot();
+  REQUIRE(records.size() == TB_TRACE_CAPACITY);
+  REQUIRE(records.front().arg == 100);
+  REQUIRE(records.back().arg == TB_TRACE_CAPACITY + 99);
+}